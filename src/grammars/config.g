@@ -46,6 +46,7 @@ tokens {
     COPY = 'copy';
     INTERVAL = 'every';
     SECONDS = 'seconds';
+    MILLISECONDS = 'milliseconds';
 
     COLON=':';
     SEMICOLON=';' ;
@@ -77,7 +78,7 @@ object
     : CONNECTION connection_state -> ^(CONNECTION connection_state)
     | TABLE^ IDENTIFIER
     | COMMAND^ STRING
-    | INTERVAL^ INTEGER SECONDS
+    | INTERVAL^ INTEGER (SECONDS | MILLISECONDS)
     ;
 
 connection_state
@@ -104,7 +105,7 @@ iterate
     ;
 
 action
-    : HTTP^ http_method url=expr ('using'! IDENTIFIER ('for'! ('table' | ('each'! 'record' 'of'!)) IDENTIFIER)? | 'with'! 'value'! expr)? SEMICOLON!
+    : HTTP^ http_method url=expr ('using'! IDENTIFIER ('for'! ('table' | ('each'! 'record' 'of'!)) IDENTIFIER ('delta'! expr)?)? | 'with'! 'value'! expr)? SEMICOLON!
     | REQUEST req=IDENTIFIER ('for' 'each' 'record' 'in') tbl=IDENTIFIER SEMICOLON -> ^(FOREACH $req $tbl)
     | REQUEST^ IDENTIFIER SEMICOLON!
 	| UPDATE^ IDENTIFIER 'set'! 'field'! expr '='! expr SEMICOLON!
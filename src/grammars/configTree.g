@@ -8,29 +8,26 @@ options {
 
 @header {
 #include <stdbool.h>
+#include <limits.h>
 #include <event2/http.h>
 
 #include "oris_app_info.h"
 #include "oris_automation_types.h"
-#include "oris_automation.h"
-#include "oris_configuration.h"
 #include "oris_interpret_tools.h"
-#include "oris_kvpair.h"
 #include "oris_connection.h"
 #include "oris_socket_connection.h"
 #include "oris_log.h"
 #include "oris_util.h"
 }
 
+// automation operations, templates and requests are compiled into programs
+// (oris_program.c), the tree parser only handles the configuration part and
+// event objects
+
 @members {
-	bool in_event = false;
-	bool do_action = false;
-	bool in_action = false;
 	bool in_configuration = false;
 }
 
-// @synpredgate { BACKTRACKING == 0 && (in_configuration || (in_event && !in_action) || (in_action && do_action)) }
-
 configuration[oris_application_info_t* value]
 	@init {
 		in_configuration = true;
@@ -53,83 +50,25 @@ targets[oris_application_info_t* info]
 		} )*  )
 	;
 
-automation[oris_application_info_t* info, oris_automation_event_t* automation_event]
-	: ^(AUTOMATION event[info, automation_event]*)
-	;
-
-event[oris_application_info_t* info, oris_automation_event_t* event]
-	: ^(EVENT o=object{ do_action = oris_is_same_automation_event(event, &o); } ^(OPERATIONS operations[info]))
-	;
-
-
 object returns [oris_automation_event_t event]
+	@init { event.type = EVT_COMMAND; event.name = NULL; }
 	: ^(CONNECTION state=(ESTABLISHED|CLOSED)) { oris_init_automation_event(&event, EVT_CONNECTION, (const char*) $state.text->chars); }
 	| ^(TABLE name=IDENTIFIER) { oris_init_automation_event(&event, EVT_TABLE, (const char*) $name.text->chars); }
 	| ^(COMMAND cmd=STRING) { oris_init_automation_event(&event, EVT_COMMAND, (const char*) $cmd.text->chars); }
-	| ^(INTERVAL interval=INTEGER SECONDS)
+	| ^(INTERVAL interval=INTEGER unit=(SECONDS|MILLISECONDS))
 		{
-			unsigned int i = 0;
-			if (oris_strtoint((const char*) $interval.text->chars, &i) && i > 0) {
-				oris_init_automation_timer(&event, i);
+			/* timer intervals are kept in milliseconds */
+			unsigned int i = 0, scale = $unit.type == SECONDS ? 1000 : 1;
+			if (oris_strtoint((const char*) $interval.text->chars, (int*) &i) && i > 0 &&
+					i <= UINT_MAX / scale) {
+				oris_init_automation_timer(&event, i * scale);
 			} else {
-				oris_log_f(LOG_ERR, "invalid interval \%s", $interval.text->chars);
+				oris_log_f(LOG_ERR, "invalid interval \%s \%s", $interval.text->chars,
+					$unit.text->chars);
 			}
 		}
 	;
 
-operations [oris_application_info_t* info]
-	: (iterate[info] | conditional_action[info])*
-	;
-
-iterate [oris_application_info_t* info]
-	: ^(ITERATE tbl_name=IDENTIFIER ^(OPERATIONS operations[info]) expr?)
-	;
-
-conditional_action [oris_application_info_t* info]
-	@init { do_action = true; }
-	: action[info]
-	| ^(COND_ACTION cond=expr{ do_action = do_action && oris_expr_as_bool_and_free(cond); } action[info])
-	;
-
-action[oris_application_info_t* info]
-	@init {	value = NULL; it = false; tbl=NULL; }
-	: ^(FOREACH req=IDENTIFIER tbl=IDENTIFIER) { if (do_action) oris_automation_foreach_action(info, (const char*) $req.text->chars, (const char*) $tbl.text->chars); }
-	| ^(REQUEST name=IDENTIFIER) { if (do_action) oris_automation_request_action(info, (const char*) $name.text->chars); }
-	| ^(HTTP method=http_method url=exprTree ( tmpl_name=IDENTIFIER (it=is_record tbl=IDENTIFIER)? | value=expr )? ) { if (do_action) oris_automation_http_action(info, method, $url.start, $tmpl_name, value, $tbl != NULL ? (const char*) $tbl.text->chars : NULL, $it.value); }
-	| ^(UPDATE tbl=IDENTIFIER field=exprTree new_value=exprTree) { if (do_action) oris_automation_set_tbl_record(info, (const char*) $tbl.text->chars, $field.start, $new_value.start); }
-	| ^(COPY src_expr=expr dst_expr=expr) { if (do_action) oris_automation_copy_table(info, src_expr, dst_expr); }
-	;
-
-http_method returns [enum evhttp_cmd_type http_method]
-	@init { http_method = EVHTTP_REQ_GET; }
-	: 'get' { $http_method = EVHTTP_REQ_GET;  }
-	| 'put' { $http_method =  EVHTTP_REQ_PUT; }
-	| 'post' { $http_method = EVHTTP_REQ_POST; }
-	| 'delete' { $http_method = EVHTTP_REQ_DELETE; }
-	;
-
-is_record returns [bool value]
-	@init { value = false; }
-	: 'table' { $value = false; }
-	| 'record' { $value = true; }
-	;
-
-kv_list returns [pANTLR3_LIST list]
-	@init {	list = antlr3ListNew(sizeof(*list)); }
-	: (key=IDENTIFIER value=expr  {
-			$list->add($list, oris_create_kv_pair((const char*) $key.text->chars, $value.value, oris_free_expr_value_void), oris_free_kv_pair_void);
-		} )*
-	;
-
-exprTree
-	: ^((EQUAL | NOT_EQUAL | LTH | LE | GE | GT | PLUS | MINUS | OR | MUL | DIV | MOD | AND)  exprTree exprTree)
-	| ^(RECORD IDENTIFIER INTEGER)
-	| ^(RECORD IDENTIFIER IDENTIFIER)
-	| ^(FUNCTION IDENTIFIER ^(PARAMS exprTree*))
-	| INTEGER
-	| STRING
-	;
-
 expr returns [oris_parse_expr_t* value]
 	@init { value = NULL; }
 	: ^(op=(EQUAL | NOT_EQUAL | LTH | LE | GE | GT | PLUS | MINUS | OR | MUL | DIV | MOD | AND)  a=expr b=expr)
@@ -169,11 +108,3 @@ parameters returns [pANTLR3_LIST argv]
 	@init {	argv = antlr3ListNew(sizeof(*argv)); }
 	: ^(PARAMS ( param=expr { $argv->add($argv, $param.value, oris_free_expr_value_void); } )* )
 	;
-
-template_definition
-	: ^(TEMPLATE IDENTIFIER IDENTIFIER kv_list)
-	;
-
-requests_definition
-	: ^(REQUESTS kv_list)
-	;
@@ -0,0 +1,219 @@
+#include <stdlib.h>
+#include <string.h>
+
+/* important include order: antlrdefs includes socket stuff! */
+#include "oris_libevent.h"
+#include <antlr3defs.h>
+
+#include "oris_util.h"
+#include "oris_log.h"
+#include "oris_bytecode.h"
+#include "configParser.h"
+
+static bool oris_expr_emit(oris_expr_program_t* prog, oris_expr_opcode_t op,
+	int a, int b, pANTLR3_STRING s, pANTLR3_STRING t)
+{
+	oris_expr_instr_t* code;
+	size_t capacity;
+
+	if (prog->count == prog->capacity) {
+		capacity = prog->capacity > 0 ? prog->capacity * 2 : 8;
+		code = realloc(prog->code, capacity * sizeof(*code));
+		if (!code) {
+			return false;
+		}
+		prog->code = code;
+		prog->capacity = capacity;
+	}
+
+	code = &prog->code[prog->count++];
+	code->op = op;
+	code->a = a;
+	code->b = b;
+	code->s = s;
+	code->t = t;
+
+	return true;
+}
+
+static bool oris_is_binary_op(ANTLR3_UINT32 type)
+{
+	switch (type) {
+		case EQUAL: case NOT_EQUAL: case LTH: case LE: case GE: case GT:
+		case PLUS: case MINUS: case OR: case MUL: case DIV: case MOD: case AND:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/* depth is the stack height before the node is evaluated */
+static bool oris_expr_compile_node(oris_expr_program_t* prog,
+	pANTLR3_BASE_TREE node, size_t depth)
+{
+	pANTLR3_BASE_TREE a, b;
+	pANTLR3_STRING text;
+	ANTLR3_UINT32 type, i, count;
+	size_t num_args;
+	int v;
+
+	if (!node) {
+		return false;
+	}
+
+	if (depth >= ORIS_EXPR_STACK_SIZE) {
+		oris_logs(LOG_ERR, "expression nested too deeply");
+		return false;
+	}
+
+	type = node->getType(node);
+	text = node->getText(node);
+	count = node->getChildCount(node);
+
+	if ((type == PLUS || type == MINUS) && count == 1) {
+		return oris_expr_compile_node(prog, node->getChild(node, 0), depth) &&
+			(type == PLUS || oris_expr_emit(prog, ORIS_OP_NEGATE, 0, 0, NULL, NULL));
+	}
+
+	if (oris_is_binary_op(type) && count == 2) {
+		return oris_expr_compile_node(prog, node->getChild(node, 0), depth) &&
+			oris_expr_compile_node(prog, node->getChild(node, 1), depth + 1) &&
+			oris_expr_emit(prog, ORIS_OP_BINARY, (int) type, 0, NULL, NULL);
+	}
+
+	switch (type) {
+		case INTEGER:
+			if (!oris_strtoint((const char*) text->chars, &v)) {
+				oris_log_f(LOG_ERR, "invalid integer %s", text->chars);
+				return false;
+			}
+			return oris_expr_emit(prog, ORIS_OP_INT, v, 0, NULL, NULL);
+
+		case STRING:
+			return oris_expr_emit(prog, ORIS_OP_STRING, 0, 0, text, NULL);
+
+		case RECORD:
+			a = node->getChild(node, 0);
+			b = node->getChild(node, 1);
+			if (count != 2) {
+				break;
+			}
+			if (b->getType(b) == INTEGER) {
+				if (!oris_strtoint((const char*) b->getText(b)->chars, &v)) {
+					return false;
+				}
+				return oris_expr_emit(prog, ORIS_OP_FIELD_BY_NUMBER, v, 0,
+					a->getText(a), NULL);
+			}
+			return oris_expr_emit(prog, ORIS_OP_FIELD_BY_NAME, 0, 0,
+				a->getText(a), b->getText(b));
+
+		case FUNCTION:
+			a = node->getChild(node, 0);
+			b = node->getChild(node, 1);
+			if (count != 2) {
+				break;
+			}
+			text = a->getText(a);
+			v = oris_builtin_func_lookup((const char*) text->chars, &num_args);
+			if (v == -1) {
+				oris_log_f(LOG_ERR, "unknown function %s", text->chars);
+				return false;
+			}
+			count = b->getChildCount(b);
+			if (count < num_args) {
+				oris_log_f(LOG_ERR, "too few arguments (%d) to function %s",
+					(int) count, text->chars);
+				return false;
+			}
+			for (i = 0; i < count; i++) {
+				if (!oris_expr_compile_node(prog, b->getChild(b, i), depth + i)) {
+					return false;
+				}
+			}
+			return oris_expr_emit(prog, ORIS_OP_CALL, v, (int) count, NULL, NULL);
+
+		default:
+			break;
+	}
+
+	oris_log_f(LOG_ERR, "unexpected expression node %s", text ? (char*) text->chars : "");
+	return false;
+}
+
+bool oris_expr_compile(oris_expr_program_t* prog, pANTLR3_BASE_TREE tree)
+{
+	memset(prog, 0, sizeof(*prog));
+
+	if (!oris_expr_compile_node(prog, tree, 0)) {
+		oris_expr_program_free(prog);
+		return false;
+	}
+
+	return true;
+}
+
+void oris_expr_program_free(oris_expr_program_t* prog)
+{
+	oris_free_and_null(prog->code);
+	prog->count = 0;
+	prog->capacity = 0;
+}
+
+oris_parse_expr_t* oris_expr_eval(const oris_expr_program_t* prog)
+{
+	oris_parse_expr_t* stack[ORIS_EXPR_STACK_SIZE];
+	oris_parse_expr_t *a, *b;
+	const oris_expr_instr_t *ip, *end;
+	size_t sp = 0;
+	int i;
+
+	if (!prog || prog->count == 0) {
+		return NULL;
+	}
+
+	end = prog->code + prog->count;
+	for (ip = prog->code; ip < end; ip++) {
+		switch (ip->op) {
+			case ORIS_OP_INT:
+				stack[sp++] = oris_alloc_int_value(ip->a);
+				break;
+			case ORIS_OP_STRING:
+				stack[sp++] = oris_alloc_string_value(ip->s);
+				break;
+			case ORIS_OP_FIELD_BY_NUMBER:
+				stack[sp++] = oris_alloc_value_from_rec_i(ip->s, ip->a);
+				break;
+			case ORIS_OP_FIELD_BY_NAME:
+				stack[sp++] = oris_alloc_value_from_rec_s(ip->s, ip->t);
+				break;
+			case ORIS_OP_NEGATE:
+				if (stack[sp - 1]) {
+					stack[sp - 1] = oris_expr_eval_unary_op(stack[sp - 1], MINUS);
+				}
+				break;
+			case ORIS_OP_BINARY:
+				b = stack[--sp];
+				a = stack[sp - 1];
+				if (a && b) {
+					stack[sp - 1] = oris_expr_eval_binary_op(a, b, ip->a);
+				} else {
+					/* propagate errors (e.g. from builtins) */
+					oris_free_expr_value(a);
+					oris_free_expr_value(b);
+					stack[sp - 1] = NULL;
+				}
+				break;
+			case ORIS_OP_CALL:
+				sp -= (size_t) ip->b;
+				a = oris_builtin_func_call(ip->a, stack + sp);
+				for (i = 0; i < ip->b; i++) {
+					oris_free_expr_value(stack[sp + i]);
+				}
+				stack[sp++] = a;
+				break;
+		}
+	}
+
+	return stack[0];
+}
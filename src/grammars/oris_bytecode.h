@@ -0,0 +1,49 @@
+#ifndef __ORIS_BYTECODE_H
+#define __ORIS_BYTECODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <antlr3commontree.h>
+
+#include "oris_interpret_tools.h"
+
+/* maximum depth of the evaluation stack of a compiled expression */
+#define ORIS_EXPR_STACK_SIZE 32
+
+typedef enum {
+	ORIS_OP_INT,              /* push integer a */
+	ORIS_OP_STRING,           /* push string s */
+	ORIS_OP_FIELD_BY_NUMBER,  /* push field a of the current row in table s */
+	ORIS_OP_FIELD_BY_NAME,    /* push field t of the current row in table s */
+	ORIS_OP_NEGATE,           /* negate the top of the stack */
+	ORIS_OP_BINARY,           /* replace the two topmost values by (b1 a b0) */
+	ORIS_OP_CALL              /* replace the topmost b values by builtin a(...) */
+} oris_expr_opcode_t;
+
+typedef struct {
+	oris_expr_opcode_t op;
+	int a;
+	int b;
+	/* owned by the parse tree */
+	pANTLR3_STRING s;
+	pANTLR3_STRING t;
+} oris_expr_instr_t;
+
+/* an expression lowered into postfix order, evaluated on a value stack. An
+ * empty program (count == 0) evaluates to NULL. */
+typedef struct {
+	oris_expr_instr_t* code;
+	size_t count;
+	size_t capacity;
+} oris_expr_program_t;
+
+/* compile an expression tree, the tree must outlive the program */
+bool oris_expr_compile(oris_expr_program_t* prog, pANTLR3_BASE_TREE tree);
+void oris_expr_program_free(oris_expr_program_t* prog);
+
+/* evaluate against the current rows of the data tables (NULL on error) */
+oris_parse_expr_t* oris_expr_eval(const oris_expr_program_t* prog);
+
+#define oris_expr_program_is_empty(prog) ((prog)->count == 0)
+
+#endif /* __ORIS_BYTECODE_H */
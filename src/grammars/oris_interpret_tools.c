@@ -20,11 +20,10 @@
 #include "oris_log.h"
 #include "oris_interpret_tools.h"
 #include "configParser.h"
-#include "configTree.h"
 
 mem_pool_t* oris_expr_mem_pool = NULL;
 
-typedef oris_parse_expr_t*(*builtin_func_impl_t) (pANTLR3_LIST args);
+typedef oris_parse_expr_t*(*builtin_func_impl_t) (oris_parse_expr_t** argv);
 
 typedef struct {
 	char* name;
@@ -33,12 +32,12 @@ typedef struct {
 	size_t opt_args;
 } oris_builtin_func_t;
 
-static oris_parse_expr_t* oris_built_in_length(pANTLR3_LIST args);
-static oris_parse_expr_t* oris_built_in_quote(pANTLR3_LIST args);
-static oris_parse_expr_t* oris_built_in_token(pANTLR3_LIST args);
-static oris_parse_expr_t* oris_built_in_lpad(pANTLR3_LIST args);
-static oris_parse_expr_t* oris_built_in_rpad(pANTLR3_LIST args);
-static oris_parse_expr_t* oris_built_in_lookup(pANTLR3_LIST args);
+static oris_parse_expr_t* oris_built_in_length(oris_parse_expr_t** argv);
+static oris_parse_expr_t* oris_built_in_quote(oris_parse_expr_t** argv);
+static oris_parse_expr_t* oris_built_in_token(oris_parse_expr_t** argv);
+static oris_parse_expr_t* oris_built_in_lpad(oris_parse_expr_t** argv);
+static oris_parse_expr_t* oris_built_in_rpad(oris_parse_expr_t** argv);
+static oris_parse_expr_t* oris_built_in_lookup(oris_parse_expr_t** argv);
 
 static oris_builtin_func_t oris_builtin_funcs[] = {
 	{ "LENGTH", oris_built_in_length, 1, 0 },
@@ -149,12 +148,17 @@ oris_parse_expr_t* oris_alloc_value_from_rec_i(const pANTLR3_STRING tbl, const i
 
 oris_parse_expr_t* oris_alloc_value_from_rec_s(const pANTLR3_STRING tbl, const pANTLR3_STRING col)
 {
+	const char* str;
+
 	oris_parse_expr_t* retval = mem_pool_alloc(oris_expr_mem_pool);
 	if (retval) {
+		str = oris_tables_get_field(data_tbls, (const char*) (tbl->chars),
+			(const char*) col->chars);
+		if (str == NULL) {
+			str = "";
+		}
 		retval->type = ET_STRING;
-		retval->value.as_string = strFactory->newStr(strFactory,(pANTLR3_UINT8)
-				oris_tables_get_field(data_tbls, (const char*) (tbl->chars),
-				(const char*) col->chars));
+		retval->value.as_string = strFactory->newStr(strFactory, (pANTLR3_UINT8) str);
 	}
 
 	return retval;
@@ -336,34 +340,46 @@ oris_parse_expr_t* oris_expr_eval_binary_op(oris_parse_expr_t* a,
 	return retval;
 }
 
-static oris_builtin_func_t* get_builtin_fn_by_name(const char* name)
+int oris_builtin_func_lookup(const char* name, size_t* num_args)
 {
 	size_t i;
 
 	for (i = 0; i < sizeof(oris_builtin_funcs) / sizeof(*oris_builtin_funcs); i++) {
 		if (strcasecmp(oris_builtin_funcs[i].name, name) == 0) {
-			return &oris_builtin_funcs[i];
+			if (num_args) {
+				*num_args = oris_builtin_funcs[i].num_args;
+			}
+			return (int) i;
 		}
 	}
 
-	return NULL;
+	return -1;
+}
+
+oris_parse_expr_t* oris_builtin_func_call(int index, oris_parse_expr_t** argv)
+{
+	return oris_builtin_funcs[index].f(argv);
 }
 
 oris_parse_expr_t* oris_expr_eval_function(const pANTLR3_STRING fname,
 	pANTLR3_LIST args)
 {
-	oris_builtin_func_t* fn;
+	oris_parse_expr_t* argv[ORIS_BUILTIN_MAX_ARGS];
 	oris_parse_expr_t* retval = NULL;
-
-	fn = get_builtin_fn_by_name((char*) fname->chars);
-	if (fn) {
-		if (args->size(args) < fn->num_args) {
-			fprintf(stderr, "too few argument  (%d) to function %s", args->size(args), fname->chars);
-		}
-
-		retval = fn->f(args);
+	size_t i, num_args;
+	int fn;
+
+	fn = oris_builtin_func_lookup((char*) fname->chars, &num_args);
+	if (fn == -1) {
+		oris_log_f(LOG_ERR, "unknown function %s", fname->chars);
+	} else if (args->size(args) < num_args) {
+		oris_log_f(LOG_ERR, "too few arguments (%d) to function %s",
+			(int) args->size(args), fname->chars);
 	} else {
-		fprintf(stderr, "unknown function %s", fname->chars);
+		for (i = 0; i < num_args; i++) {
+			argv[i] = args->get(args, (ANTLR3_UINT32) i + 1);
+		}
+		retval = oris_builtin_func_call(fn, argv);
 	}
 
 	args->free(args);
@@ -445,17 +461,20 @@ void oris_expr_dump(const oris_parse_expr_t* v)
 
 /* builtin function implementation */
 
-static oris_parse_expr_t* oris_built_in_length(pANTLR3_LIST args)
+static oris_parse_expr_t* oris_built_in_length(oris_parse_expr_t** argv)
 {
-	oris_parse_expr_t* arg = args->get(args, 1);
+	oris_parse_expr_t* arg = argv[0];
 	oris_expr_cast_to_str(arg);
 
 	return oris_alloc_int_value((int) mbstowcs(NULL, (char*) arg->value.as_string->chars, 0));
 }
 
-static oris_parse_expr_t* oris_built_in_quote(pANTLR3_LIST args)
+static oris_parse_expr_t* oris_built_in_quote(oris_parse_expr_t** argv)
 {
-	oris_parse_expr_t* arg = oris_alloc_string_value(args->get(args, 1));
+	oris_parse_expr_t* arg;
+
+	oris_expr_cast_to_str(argv[0]);
+	arg = oris_alloc_string_value(argv[0]->value.as_string);
 
 	arg->value.as_string->insert(arg->value.as_string, 0, "\"");
 	arg->value.as_string->append(arg->value.as_string, "\"");
@@ -463,11 +482,11 @@ static oris_parse_expr_t* oris_built_in_quote(pANTLR3_LIST args)
 	return arg;
 }
 
-static oris_parse_expr_t* oris_built_in_token(pANTLR3_LIST args)
+static oris_parse_expr_t* oris_built_in_token(oris_parse_expr_t** argv)
 {
-	oris_parse_expr_t* str_arg = args->get(args, 1);
-	oris_parse_expr_t* nr_arg = args->get(args, 2);
-	oris_parse_expr_t* delim_str = args->get(args, 3);
+	oris_parse_expr_t* str_arg = argv[0];
+	oris_parse_expr_t* nr_arg = argv[1];
+	oris_parse_expr_t* delim_str = argv[2];
 	oris_parse_expr_t* retval = NULL;
 	int nr;
 	ANTLR3_UINT32 start, end;
@@ -505,11 +524,11 @@ static oris_parse_expr_t* oris_built_in_token(pANTLR3_LIST args)
 	return retval;
 }
 
-static oris_parse_expr_t* oris_built_in_lpad(pANTLR3_LIST args)
+static oris_parse_expr_t* oris_built_in_lpad(oris_parse_expr_t** argv)
 {
-	oris_parse_expr_t* str_arg = args->get(args, 1);
-	oris_parse_expr_t* minlen_arg = args->get(args, 2);
-	oris_parse_expr_t* fill_arg = args->get(args, 3);
+	oris_parse_expr_t* str_arg = argv[0];
+	oris_parse_expr_t* minlen_arg = argv[1];
+	oris_parse_expr_t* fill_arg = argv[2];
 	oris_parse_expr_t* str;
 	pANTLR3_STRING fill;
 	int minlen;
@@ -530,11 +549,11 @@ static oris_parse_expr_t* oris_built_in_lpad(pANTLR3_LIST args)
 }
 
 
-static oris_parse_expr_t* oris_built_in_rpad(pANTLR3_LIST args)
+static oris_parse_expr_t* oris_built_in_rpad(oris_parse_expr_t** argv)
 {
-	oris_parse_expr_t* str_arg = args->get(args, 1);
-	oris_parse_expr_t* minlen_arg = args->get(args, 2);
-	oris_parse_expr_t* fill_arg = args->get(args, 3);
+	oris_parse_expr_t* str_arg = argv[0];
+	oris_parse_expr_t* minlen_arg = argv[1];
+	oris_parse_expr_t* fill_arg = argv[2];
 	oris_parse_expr_t* str;
 	pANTLR3_STRING fill;
 	int minlen;
@@ -554,16 +573,15 @@ static oris_parse_expr_t* oris_built_in_rpad(pANTLR3_LIST args)
 	return str;
 }
 
-static oris_parse_expr_t* oris_built_in_lookup(pANTLR3_LIST args)
+static oris_parse_expr_t* oris_built_in_lookup(oris_parse_expr_t** argv)
 {
-	oris_parse_expr_t* value = args->get(args, 1);
-	oris_parse_expr_t* tbl_name_arg = args->get(args, 2);
-	oris_parse_expr_t* tbl_field_arg = args->get(args, 3);
-	oris_parse_expr_t* lookup_field_arg = args->get(args, 4);
+	oris_parse_expr_t* value = argv[0];
+	oris_parse_expr_t* tbl_name_arg = argv[1];
+	oris_parse_expr_t* tbl_field_arg = argv[2];
+	oris_parse_expr_t* lookup_field_arg = argv[3];
 	oris_parse_expr_t* retval = oris_alloc_string_value(NULL);
 	oris_table_t* tbl;
-	int row_backup, tbl_field, lookup_field;
-	const char* s;
+	int row, tbl_field, lookup_field;
 
 	oris_expr_cast_to_str(value);
 	oris_expr_cast_to_str(tbl_name_arg);
@@ -587,49 +605,12 @@ static oris_parse_expr_t* oris_built_in_lookup(pANTLR3_LIST args)
 		}
 	}
 
-	row_backup = tbl->current_row;
-	ORIS_FOR_EACH_TBL_ROW(tbl) {
-		s = oris_table_get_field_by_index(tbl, tbl_field);
-		if (s && strcasecmp((const char*) value->value.as_string->chars, s) == 0) {
-			s = oris_table_get_field_by_index(tbl, lookup_field);
-			if (s) {
-				retval->value.as_string->append(retval->value.as_string, s);
-			}
-			break;
-		}
+	row = oris_table_find_row(tbl, tbl_field, (const char*) value->value.as_string->chars);
+	if (row != -1 && lookup_field >= 1 && lookup_field <= tbl->rows[row].field_count) {
+		retval->value.as_string->append(retval->value.as_string,
+			oris_table_row_field(tbl, &tbl->rows[row], lookup_field - 1));
 	}
-	tbl->current_row = row_backup;
-
-	return retval;
 
 invalid_args:
-	return oris_alloc_string_value(NULL);
-}
-
-oris_parse_expr_t* oris_expr_parse_from_tree(const pANTLR3_BASE_TREE tree)
-{
-	pANTLR3_COMMON_TREE_NODE_STREAM node_stream;
-	pconfigTree walker;
-    oris_parse_expr_t* expr;
-
-	if (!tree) {
-		return NULL;
-	}
-
-    node_stream = antlr3CommonTreeNodeStreamNewTree(tree, ANTLR3_SIZE_HINT);
-	if (node_stream == NULL) {
-		return NULL;
-	}
-
-    walker = configTreeNew(node_stream);
-	if (walker == NULL) {
-		return NULL;
-	}
-
-    expr = walker->expr(walker);
-
-    node_stream->free(node_stream);
-    walker->free(walker);
-
-	return expr;
+	return retval;
 }
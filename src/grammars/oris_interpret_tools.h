@@ -23,6 +23,9 @@ typedef struct {
 	} value;
 } oris_parse_expr_t;
 
+/* upper bound of the argument count of builtin functions */
+#define ORIS_BUILTIN_MAX_ARGS 8
+
 /* globals */
 
 extern mem_pool_t* oris_expr_mem_pool;
@@ -48,6 +51,11 @@ oris_parse_expr_t* oris_expr_eval_binary_op(oris_parse_expr_t* a,
 oris_parse_expr_t* oris_expr_eval_function(const pANTLR3_STRING fname,
 	pANTLR3_LIST args);
 
+/* builtin functions by index (-1 if unknown). The arguments are not freed and
+ * may be converted in place. */
+int oris_builtin_func_lookup(const char* name, size_t* num_args);
+oris_parse_expr_t* oris_builtin_func_call(int index, oris_parse_expr_t** argv);
+
 char* oris_expr_as_string(const oris_parse_expr_t* expr);
 bool oris_expr_as_int(const oris_parse_expr_t* expr, int* v);
 bool oris_expr_as_bool(const oris_parse_expr_t* expr, bool* v);
@@ -55,6 +63,4 @@ bool oris_expr_as_bool_and_free(oris_parse_expr_t* e);
 
 void oris_expr_dump(const oris_parse_expr_t* v);
 
-oris_parse_expr_t* oris_expr_parse_from_tree(const pANTLR3_BASE_TREE tree);
-
 #endif /* __ORIS_INTERPRET_TOOLS_H  */
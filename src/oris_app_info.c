@@ -24,6 +24,7 @@
 #include "oris_util.h"
 #include "oris_app_info.h"
 #include "oris_socket_connection.h"
+#include "oris_snapshot.h"
 
 #ifndef _WIN32
 /* list from https://golang.org/src/crypto/x509/root_linux.go + FreeBSD location*/
@@ -179,8 +180,10 @@ bool oris_app_info_init(oris_application_info_t* info)
 {
 	info->targets.items = NULL;
 	info->targets.count = 0;
+	oris_histogram_set_init(&info->table_latency);
 
-	return oris_init_libevent(info) && oris_init_ssl(info);
+	return oris_init_libevent(info) && oris_init_ssl(info) &&
+		oris_snapshot_init(info->libevent_info.base, info->fsync_policy);
 }
 
 static void oris_finalize_ssl(oris_application_info_t* info)
@@ -202,11 +205,23 @@ static void oris_finalize_ssl(oris_application_info_t* info)
 
 void oris_app_info_finalize(oris_application_info_t* info)
 {
+	if (info->storage.fn) {
+		oris_storage_finalize(&info->storage);
+	}
+
+	/* hands the rest of the capture to the writer */
+	oris_capture_close(&info->capture);
+
+	/* waits for outstanding writes, must precede freeing tables and loop */
+	oris_snapshot_finalize();
+
 	oris_tables_finalize(&info->data_tables);
 	oris_targets_clear(info->targets.items, &info->targets.count);
 
 	free(info->targets.items);
 	info->targets.items = NULL;
+	oris_http_payload_finalize();
+	oris_histogram_set_finalize(&info->table_latency);
 
 	oris_free_connections(&info->connections);
 
@@ -215,6 +230,7 @@ void oris_app_info_finalize(oris_application_info_t* info)
 	event_base_free(info->libevent_info.base);
 
 	oris_free_and_null(info->cert_fn);
+	oris_free_and_null(info->capture_fn);
 
 	oris_finalize_ssl(info);
 }
@@ -269,41 +285,25 @@ void oris_config_add_target(oris_application_info_t* config, const char* name, c
 
 			config->targets.items = items;
 			target = config->targets.items + config->targets.count;
+			memset(target, 0, sizeof(*target));
 			target->name = strdup(name);
 			target->uri = evuri;
 			target->enabled = true;
-			target->compress = config->compress_http;
-			target->auth_header_value = NULL;
+			target->encoding = config->compress_http ?
+				ORIS_HTTP_ENCODING_DEFLATE : ORIS_HTTP_ENCODING_IDENTITY;
+			target->libevent_info = &config->libevent_info;
+			target->ssl_ctx = use_ssl ? config->ssl_ctx : NULL;
 
 			oris_set_http_target_auth_header(target);
 
-			/* TODO: plain http (no ssl) works fine, but when the https (!)
-			 * connection is closed by the server side we end up in "bad file descriptor"
-			 * messages.... so https is not working properbly ATM :-(
-			 * BUT: maybe http is also affected, as we close the buffereevent_Sockets when
-			 * a close comes in! */
-			if (!use_ssl) {
-				target->ssl = NULL;
-				target->bev = bufferevent_socket_new(config->libevent_info.base,
-					-1, BEV_OPT_CLOSE_ON_FREE);
-			} else {
-				target->ssl = SSL_new(config->ssl_ctx);
-				target->bev = bufferevent_openssl_socket_new(
-					config->libevent_info.base, -1, target->ssl,
-					BUFFEREVENT_SSL_CONNECTING, BEV_OPT_CLOSE_ON_FREE
-					| BEV_OPT_DEFER_CALLBACKS);
-				if (!target->bev) {
-					oris_log_f(LOG_ERR, "could not create SSL socket for %s", name);
-				}
-				bufferevent_openssl_set_allow_dirty_shutdown(target->bev, 1);
+			if (!oris_http_target_init(target)) {
+				oris_log_f(LOG_ERR, "could not create connections for %s", name);
+				oris_free_and_null(target->auth_header_value);
+				free(target->name);
+				evhttp_uri_free(evuri);
+				return;
 			}
 
-			target->libevent_info = &config->libevent_info;
-			target->connection = evhttp_connection_base_bufferevent_new(
-				config->libevent_info.base, config->libevent_info.dns_base,
-				target->bev, evhttp_uri_get_host(evuri),
-				(unsigned short) evhttp_uri_get_port(evuri));
-
 			config->targets.count++;
 		}
 		oris_log_f(LOG_DEBUG, "new target %s: %s", name, uri);
@@ -327,11 +327,7 @@ void oris_targets_clear(oris_http_target_t* targets, int *count)
 			targets[i].name = NULL;
 		}
 
-		if (targets[i].connection) {
-			evhttp_connection_free(targets[i].connection);
-			targets[i].connection = NULL;
-		}
-
+		oris_http_target_finalize(&targets[i]);
 		oris_free_and_null(targets[i].auth_header_value);
 	}
 
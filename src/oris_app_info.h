@@ -5,9 +5,13 @@
 
 #include "oris_libevent.h"
 
+#include "oris_histogram.h"
 #include "oris_http.h"
 #include "oris_table.h"
 #include "oris_connection.h"
+#include "oris_storage.h"
+#include "oris_snapshot.h"
+#include "oris_capture.h"
 #include "oris_interpret_tools.h"
 
 /* must be placed to avoid compilation issues with libeven/winsock (redefs) */
@@ -29,11 +33,20 @@ typedef struct oris_application_info {
 
 	struct event *sigint_event;
 
+	/* the feed line currently processed and the latency by table name */
+	oris_http_origin_t origin;
+	oris_histogram_set_t table_latency;
+
 	int (*main)(struct oris_application_info*);
 
 	bool paused;
 	int log_level;
 	char* storage_fn;
+	bool journal_storage;
+	oris_storage_t storage;
+	oris_fsync_policy_t fsync_policy;
+	char* capture_fn;
+	oris_capture_t capture;
 	char* cert_fn;
 
 	int argc;
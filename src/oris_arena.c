@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "oris_arena.h"
+#include "oris_util.h"
+
+#define ORIS_ARENA_MIN_CAPACITY 256
+
+void oris_arena_init(oris_arena_t* arena)
+{
+	arena->data = NULL;
+	arena->size = 0;
+	arena->capacity = 0;
+}
+
+void oris_arena_finalize(oris_arena_t* arena)
+{
+	oris_free_and_null(arena->data);
+	arena->size = 0;
+	arena->capacity = 0;
+}
+
+void oris_arena_reset(oris_arena_t* arena)
+{
+	arena->size = 0;
+}
+
+bool oris_arena_reserve(oris_arena_t* arena, size_t n)
+{
+	size_t capacity;
+
+	if (n > SIZE_MAX - arena->size) {
+		return false;
+	}
+
+	if (arena->size + n <= arena->capacity) {
+		return true;
+	}
+
+	capacity = arena->capacity ? arena->capacity : ORIS_ARENA_MIN_CAPACITY;
+	while (capacity < arena->size + n) {
+		if (capacity > SIZE_MAX / 2) {
+			capacity = arena->size + n;
+			break;
+		}
+		capacity *= 2;
+	}
+
+	if (!oris_safe_realloc((void**) &arena->data, capacity, 1)) {
+		return false;
+	}
+
+	arena->capacity = capacity;
+
+	return true;
+}
+
+size_t oris_arena_alloc(oris_arena_t* arena, size_t n)
+{
+	size_t retval;
+
+	if (!oris_arena_reserve(arena, n)) {
+		return ORIS_ARENA_INVALID;
+	}
+
+	retval = arena->size;
+	arena->size += n;
+
+	return retval;
+}
+
+size_t oris_arena_strdup(oris_arena_t* arena, const char* s)
+{
+	size_t n = strlen(s) + 1;
+	size_t retval = oris_arena_alloc(arena, n);
+
+	if (retval != ORIS_ARENA_INVALID) {
+		memcpy(oris_arena_at(arena, retval), s, n);
+	}
+
+	return retval;
+}
+
+bool oris_arena_copy(oris_arena_t* src, oris_arena_t* dst)
+{
+	oris_arena_reset(dst);
+
+	if (src->size == 0) {
+		return true;
+	}
+
+	if (!oris_arena_reserve(dst, src->size)) {
+		return false;
+	}
+
+	memcpy(dst->data, src->data, src->size);
+	dst->size = src->size;
+
+	return true;
+}
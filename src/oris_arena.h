@@ -0,0 +1,32 @@
+#ifndef __ORIS_ARENA_H
+#define __ORIS_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* growing block of memory that is released as a whole. Allocations are
+ * returned as offsets since the block may move when it grows. */
+typedef struct oris_arena {
+	char* data;
+	size_t size;
+	size_t capacity;
+} oris_arena_t;
+
+#define ORIS_ARENA_INVALID ((size_t) -1)
+
+#define oris_arena_at(arena, offset) ((arena)->data + (offset))
+
+void oris_arena_init(oris_arena_t* arena);
+void oris_arena_finalize(oris_arena_t* arena);
+
+/* drop all allocations but keep the memory */
+void oris_arena_reset(oris_arena_t* arena);
+
+bool oris_arena_reserve(oris_arena_t* arena, size_t n);
+size_t oris_arena_alloc(oris_arena_t* arena, size_t n);
+size_t oris_arena_strdup(oris_arena_t* arena, const char* s);
+
+/* replace the content with a copy of src */
+bool oris_arena_copy(oris_arena_t* src, oris_arena_t* dst);
+
+#endif /* __ORIS_ARENA_H */
@@ -8,32 +8,10 @@
 #include "oris_configuration.h"
 #include "oris_interpret_tools.h"
 
-#include "grammars/configTree.h"
-#include <antlr3basetree.h>
-
-static char* oris_parse_request_tree(const pANTLR3_BASE_TREE parse_tree);
-static char* oris_get_parsed_request(const char *name);
-
-static void timer_callback(evutil_socket_t fd, short what, void *arg);
-
-static void oris_perform_automation_actions(pANTLR3_BASE_TREE tree,
-	oris_application_info_t* info);
-static void oris_perform_automation_action(pANTLR3_BASE_TREE tree,
-	oris_application_info_t* info);
-static void oris_perform_automation_iterate(pANTLR3_BASE_TREE tree,
-	oris_application_info_t* info);
-
-static struct event *timer_event;
-
 bool oris_automation_init(oris_application_info_t* app_info)
 {
 	(void) app_info;
 
-	struct timeval timeout = { 1, 0 };
-
-	timer_event = event_new(app_info->libevent_info.base, -1, EV_PERSIST, timer_callback, app_info);
-	event_add(timer_event, &timeout);
-
 	return true;
 }
 
@@ -86,241 +64,232 @@ void oris_free_automation_event(oris_automation_event_t* event)
 
 void oris_automation_trigger(oris_automation_event_t* event, oris_application_info_t *info)
 {
+	const oris_automation_action_t* const* handlers;
+	size_t i, count;
+
 	if (!event || (event->type != EVT_TIMER && !event->name)) {
 		return;
 	}
 
-	for (size_t i = 0; i < oris_get_automation_event_count(); i++) {
-	    const oris_automation_action_t *e = oris_get_automation_event(i);
-		if (oris_is_same_automation_event(&(e->event), event)) {
-			oris_perform_automation_actions(e->tree, info);
+	if (event->type == EVT_TIMER) {
+		/* timers are not in the dispatch table */
+		for (i = 0; i < oris_get_automation_event_count(); i++) {
+			const oris_automation_action_t *e = oris_get_automation_event(i);
+			if (oris_is_same_automation_event(&(e->event), event)) {
+				oris_automation_run(&e->program, info);
+			}
 		}
+		return;
 	}
-}
-
-static void timer_callback(evutil_socket_t fd, short what, void *arg)
-{
-	static int seconds_elapsed = 0;
-	oris_application_info_t* info = (oris_application_info_t*) arg;
-
-	(void) fd;
-	(void) what;
-
-	seconds_elapsed++;
 
-	for (size_t i = 0; i < oris_get_automation_event_count(); i++) {
-	    const oris_automation_action_t *e = oris_get_automation_event(i);
-		if (e->event.type == EVT_TIMER && seconds_elapsed % e->event.interval == 0) {
-			oris_log_f(LOG_DEBUG, "triggering event with period %d at %d s after startup\n",
-				e->event.interval, seconds_elapsed);
-			oris_perform_automation_action(e->tree->getChild(e->tree, 0), info);
-		}
+	handlers = oris_get_automation_handlers(event, &count);
+	for (i = 0; i < count; i++) {
+		oris_automation_run(&handlers[i]->program, info);
 	}
 }
 
-static void oris_perform_automation_actions(pANTLR3_BASE_TREE tree,
-	oris_application_info_t* info)
+void oris_automation_run(const oris_program_t* prog, oris_application_info_t* info)
 {
-	ANTLR3_UINT32 i;
-	pANTLR3_BASE_TREE child;
+	/* rows of the iterated tables to restore when leaving the loop */
+	int rows[ORIS_PROGRAM_MAX_NESTING];
+	size_t pc = 0, depth = 0;
+	const oris_action_t* action;
+	oris_table_t* tbl;
 
-	for (i = 0; i < tree->getChildCount(tree); i++) {
-		child = tree->getChild(tree, i);
-		if (child->getType(child) == ITERATE) {
-			oris_perform_automation_iterate(child, info);
-		} else {
-			oris_perform_automation_action(child, info);
+	while (pc < prog->count) {
+		action = &prog->actions[pc++];
+
+		switch (action->type) {
+			case ORIS_ACTION_UNLESS:
+				if (!oris_expr_as_bool_and_free(oris_expr_eval(&action->a))) {
+					pc = action->target;
+				}
+				break;
+
+			case ORIS_ACTION_ITERATE:
+				tbl = oris_get_table(&info->data_tables, action->tbl_name);
+				if (!tbl || tbl->row_count == 0 || (!oris_expr_program_is_empty(&action->a) &&
+						!oris_expr_as_bool_and_free(oris_expr_eval(&action->a)))) {
+					pc = action->target;
+					break;
+				}
+				rows[depth++] = tbl->current_row;
+				tbl->current_row = 0;
+				break;
+
+			case ORIS_ACTION_NEXT_ROW:
+				/* look up again, the loop body may have created tables */
+				tbl = oris_get_table(&info->data_tables,
+					prog->actions[action->target - 1].tbl_name);
+				depth--;
+				if (tbl && ++tbl->current_row < tbl->row_count) {
+					pc = action->target;
+					depth++;
+				} else if (tbl) {
+					tbl->current_row = rows[depth];
+				}
+				break;
+
+			case ORIS_ACTION_REQUEST:
+				if (action->request) {
+					oris_automation_request_action(info, action->request);
+				}
+				break;
+
+			case ORIS_ACTION_FOREACH:
+				if (action->request) {
+					oris_automation_foreach_action(info, action->request, action->tbl_name);
+				}
+				break;
+
+			case ORIS_ACTION_HTTP:
+				/* unresolved template */
+				if (action->ref_name && !action->tmpl) {
+					break;
+				}
+				oris_automation_http_action(info, action->method, &action->a,
+					action->tmpl, &action->b, action->tbl_name, action->per_record,
+					&action->delta_url, action->delta);
+				break;
+
+			case ORIS_ACTION_UPDATE:
+				oris_automation_set_tbl_record(info, action->tbl_name, &action->a, &action->b);
+				break;
+
+			case ORIS_ACTION_COPY:
+				oris_automation_copy_table(info, oris_expr_eval(&action->a),
+					oris_expr_eval(&action->b));
+				break;
 		}
 	}
 }
 
-static void oris_perform_automation_iterate(pANTLR3_BASE_TREE tree,
-	oris_application_info_t* info)
+static char* oris_eval_request(const oris_request_def_t* request)
 {
-	pANTLR3_BASE_TREE name_node = tree->getChild(tree, 0);
-	pANTLR3_BASE_TREE action_tree = tree->getChild(tree, 1);
-	pANTLR3_BASE_TREE cond_expr_tree = tree->getChild(tree, 2);
-	oris_table_t* tbl = oris_get_table(&info->data_tables,
-		(const char*) name_node->getText(name_node)->chars);
-	int row;
-
-	if (!name_node || !action_tree || !(tbl)) {
-		return;
-	}
-
-	if (cond_expr_tree && !oris_expr_as_bool_and_free(
-			oris_expr_parse_from_tree(cond_expr_tree))) {
-		return;
-	}
+	oris_parse_expr_t* expr = oris_expr_eval(&request->expr);
+	char* retval = oris_expr_as_string(expr);
 
-	row = tbl->current_row;
-	ORIS_FOR_EACH_TBL_ROW(tbl) {
-		oris_perform_automation_actions(action_tree, info);
-	}
-	tbl->current_row = row;
+	oris_free_expr_value(expr);
 
-}
-
-static void oris_perform_automation_action(pANTLR3_BASE_TREE tree,
-	oris_application_info_t* info)
-{
-	pANTLR3_COMMON_TREE_NODE_STREAM stream;
-	pconfigTree walker;
-
-    stream = antlr3CommonTreeNodeStreamNewTree(tree, ANTLR3_SIZE_HINT);
-    walker = configTreeNew(stream);
-
-	walker->conditional_action(walker, info);
-
-    stream->free(stream);
-    walker->free(walker);
-
-	return;
+	return retval;
 }
 
 void oris_automation_foreach_action(oris_application_info_t* info,
-	const char* request_name, const char* tbl_name)
+	const oris_request_def_t* request, const char* tbl_name)
 {
 	oris_table_t* tbl = oris_get_table(&info->data_tables, tbl_name);
-	pANTLR3_BASE_TREE req_tree = oris_get_request_parse_tree(request_name);
 	int l;
 	char* r;
 
 	if (!tbl) {
 		oris_log_f(LOG_DEBUG, "table %s not found, not performing "
-				"foreach using %s",	tbl_name, request_name);
+				"foreach using %s",	tbl_name, request->name);
 		return;
 	}
 
 	l = tbl->current_row;
 	for (tbl->current_row = 0; tbl->current_row < tbl->row_count; tbl->current_row++) {
-		r = oris_parse_request_tree(req_tree);
-		oris_log_f(LOG_DEBUG, "requesting %s for row %d in %s", r, tbl->current_row, tbl->name);
-		oris_connections_send(&info->connections, "data", r, strlen(r));
-		free(r);
+		r = oris_eval_request(request);
+		if (r) {
+			oris_log_f(LOG_DEBUG, "requesting %s for row %d in %s", r, tbl->current_row, tbl->name);
+			oris_connections_send(&info->connections, "data", r, strlen(r));
+			free(r);
+		}
 	}
 	tbl->current_row = l;
 }
 
 void oris_automation_request_action(oris_application_info_t* info,
-	const char* request_name)
+	const oris_request_def_t* request)
 {
-	char* r = oris_get_parsed_request(request_name);
+	char* r = oris_eval_request(request);
 
 	if (!r) {
 		return;
 	}
 
 	oris_connections_send(&info->connections, "data", r, strlen(r));
+	free(r);
 }
 
-static char* oris_parse_request_tree(const pANTLR3_BASE_TREE parse_tree)
-{
-	pANTLR3_COMMON_TREE_NODE_STREAM node_stream;
-	pconfigTree walker;
-    oris_parse_expr_t* expr;
-    char* retval = NULL;
-
-    if (!parse_tree) {
-        return NULL;
-    }
-
-    node_stream = antlr3CommonTreeNodeStreamNewTree(parse_tree, ANTLR3_SIZE_HINT);
-    walker = configTreeNew(node_stream);
-
-    expr = walker->expr(walker);
-    retval = oris_expr_as_string(expr);
-    oris_free_expr_value(expr);
-
-    node_stream->free(node_stream);
-    walker->free(walker);
-
-    return retval;
-}
-
-static char* oris_get_parsed_request(const char *name)
-{
-    return oris_parse_request_tree(oris_get_request_parse_tree(name));
-}
-
+/* double quotes are replaced by single ones */
 static void oris_add_escaped_json_str_to_buffer(struct evbuffer* target,
 	oris_parse_expr_t* expr)
 {
-	char *s, *p;
-
-	p = s = strdup((char*) expr->value.as_string->chars);
-	while (s && *p) {
-		if (*p == '"') { *p = '\''; }
-		p++;
+	const char* s = (const char*) expr->value.as_string->chars;
+	const char* p;
+	size_t len = strlen(s);
+
+	evbuffer_add(target, "\"", 1);
+	while ((p = memchr(s, '"', len)) != NULL) {
+		evbuffer_add(target, s, (size_t) (p - s));
+		evbuffer_add(target, "'", 1);
+		len -= (size_t) (p - s) + 1;
+		s = p + 1;
 	}
-
-	evbuffer_add_printf(target, "\"%s\"", s);
-	free(s);
+	evbuffer_add(target, s, len);
+	evbuffer_add(target, "\"", 1);
 }
 
 static void oris_add_expr_to_buf(struct evbuffer* target, oris_parse_expr_t* expr)
 {
-	if (expr->type == ET_INT) {
-		evbuffer_add_printf(target, "%d", expr->value.as_int);
-	} else if (expr->type == ET_STRING) {
+	char num[16];
+
+	if (expr && expr->type == ET_INT) {
+		evbuffer_add(target, num, (size_t) snprintf(num, sizeof(num), "%d",
+			expr->value.as_int));
+	} else if (expr && expr->type == ET_STRING) {
 		oris_add_escaped_json_str_to_buffer(target, expr);
 	} else {
-		evbuffer_add_printf(target, "null");
+		evbuffer_add(target, "null", 4);
 	}
 }
 
-static void oris_parse_template(struct evbuffer* target, pANTLR3_BASE_TREE tmpl, bool with_v_prefix)
+#define V_PREFIX "{\"v\":{"
+#define V_SUFFIX "}}"
+
+void oris_parse_template(struct evbuffer* target, const oris_template_t* tmpl, bool with_v_prefix)
 {
-	ANTLR3_UINT32 i;
-	pANTLR3_BASE_TREE c;
-	pANTLR3_STRING s;
+	const oris_template_field_t *field, *end;
 	oris_parse_expr_t* v;
 
-	if (tmpl->getType(tmpl) != TEMPLATE) {
-		return;
-	}
-
 	if (with_v_prefix) {
-		evbuffer_add_printf(target, "{\"v\":{");
+		evbuffer_expand(target, tmpl->size_hint + sizeof(V_PREFIX V_SUFFIX));
+		evbuffer_add(target, V_PREFIX, sizeof(V_PREFIX) - 1);
 	}
 
-	for (i = 1; i < tmpl->getChildCount(tmpl); i += 2) {
-		c = tmpl->getChild(tmpl, i);
-		if (c->getType(c) == IDENTIFIER) {
-			if (i > 1) {
-				evbuffer_add_printf(target, ",");
-			}
-			s = c->getText(c);
-			evbuffer_add_printf(target, "\"%s\":", s->chars);
-
-			c = tmpl->getChild(tmpl, i + 1);
-			v = oris_expr_parse_from_tree(c);
-			oris_add_expr_to_buf(target, v);
+	end = tmpl->fields + tmpl->count;
+	for (field = tmpl->fields; field < end; field++) {
+		evbuffer_add(target, field->fragment, field->fragment_len);
 
-			oris_free_expr_value(v);
-		}
+		v = oris_expr_eval(&field->value);
+		oris_add_expr_to_buf(target, v);
+		oris_free_expr_value(v);
 	}
 
 	if (with_v_prefix) {
-		evbuffer_add_printf(target, "}}");
+		evbuffer_add(target, V_SUFFIX, sizeof(V_SUFFIX) - 1);
 	}
 }
 
-static void oris_parse_foreach_template(struct evbuffer* buf, oris_table_t* tbl,
-	pANTLR3_BASE_TREE template)
+void oris_parse_foreach_template(struct evbuffer* buf, oris_table_t* tbl,
+	const oris_template_t* template)
 {
-	char c;
 	int l;
 
+	/* one allocation for the whole table instead of growing per row */
+	evbuffer_expand(buf, (size_t) tbl->row_count * (template->size_hint + 3));
+
 	l = tbl->current_row;
 
 	for (tbl->current_row = 0; tbl->current_row < tbl->row_count; tbl->current_row++) {
 		if (tbl->current_row > 0) {
-			c = ','; evbuffer_add(buf, &c, sizeof(c));
+			evbuffer_add(buf, ",{", 2);
+		} else {
+			evbuffer_add(buf, "{", 1);
 		}
-		c = '{'; evbuffer_add(buf, &c, sizeof(c));
 		oris_parse_template(buf, template, false);
-		c = '}'; evbuffer_add(buf, &c, sizeof(c));
+		evbuffer_add(buf, "}", 1);
 	}
 
 	tbl->current_row = l;
@@ -328,9 +297,9 @@ static void oris_parse_foreach_template(struct evbuffer* buf, oris_table_t* tbl,
 
 static void oris_dump_expr_value_to_buffer(struct evbuffer* buf, oris_parse_expr_t* expr)
 {
-	if (expr->type == ET_INT) {
+	if (expr && expr->type == ET_INT) {
 		evbuffer_add_printf(buf, "{\"v\":\"%d\"}", expr->value.as_int);
-	} else if (expr->type == ET_STRING) {
+	} else if (expr && expr->type == ET_STRING) {
 		evbuffer_add_printf(buf, "{\"v\":");
 		oris_add_escaped_json_str_to_buffer(buf, expr);
 		evbuffer_add_printf(buf, "}");
@@ -341,7 +310,7 @@ static void oris_dump_expr_value_to_buffer(struct evbuffer* buf, oris_parse_expr
 
 
 static void oris_perform_http_with_buffer(oris_application_info_t* info,
-	enum evhttp_cmd_type method, const pANTLR3_BASE_TREE url, struct evbuffer* buf)
+	enum evhttp_cmd_type method, const oris_expr_program_t* url, struct evbuffer* buf)
 {
 	char* url_str;
     oris_parse_expr_t* url_expr;
@@ -350,19 +319,143 @@ static void oris_perform_http_with_buffer(oris_application_info_t* info,
 		return;
 	}
 
-	url_expr = oris_expr_parse_from_tree(url);
+	url_expr = oris_expr_eval(url);
 	url_str = oris_expr_as_string(url_expr);
 
 	oris_perform_http_on_targets(info->targets.items, info->targets.count,
-			method, url_str, buf);
+			method, url_str, buf, &info->origin);
 
 	oris_free_and_null(url_str);
 	oris_free_expr_value(url_expr);
 }
 
+/* send buf to url, reporting failures to ack. Once sent, the body last
+ * published to stale_url (the other one of full and delta URL) is outdated. */
+static void oris_perform_http_with_ack(oris_application_info_t* info,
+	enum evhttp_cmd_type method, const char* url, const char* stale_url,
+	struct evbuffer* buf, oris_http_ack_t* ack)
+{
+	oris_http_payload_t* payload = oris_http_payload_new(buf);
+
+	if (!payload || !url) {
+		oris_log_f(LOG_ERR, "could not allocate http payload");
+		oris_http_payload_unref(payload);
+		if (ack) {
+			ack->failed = true;
+		}
+		return;
+	}
+
+	payload->origin = info->origin;
+	payload->ack = ack ? oris_http_ack_ref(ack) : NULL;
+	payload->stale_url = stale_url ? strdup(stale_url) : NULL;
+
+	oris_perform_http_payload_on_targets(info->targets.items, info->targets.count,
+		method, url, payload);
+	oris_http_payload_unref(payload);
+}
+
+static char* oris_eval_url(const oris_expr_program_t* prog)
+{
+	oris_parse_expr_t* expr = oris_expr_eval(prog);
+	char* retval = oris_expr_as_string(expr);
+
+	oris_free_expr_value(expr);
+
+	return retval;
+}
+
+/* render the table row by row and compare the rows to the ones published
+ * last. Only the changed rows are sent to delta_url as
+ * {"count":rows,"rows":[index,...],"v":[{...},...]} unless too many changed.
+ * The rows are considered published unless a request fails, the next update
+ * sends the whole table then. */
+static void oris_perform_http_on_table_delta(oris_application_info_t* info,
+	enum evhttp_cmd_type method, const oris_expr_program_t* url,
+	const oris_expr_program_t* delta_url, struct evbuffer* buf,
+	const oris_template_t* tmpl, oris_table_t* tbl, oris_delta_state_t* delta)
+{
+	struct evbuffer *row, *changed, *indexes;
+	uint64_t* hashes;
+	int l, changes = 0;
+	size_t length;
+	oris_http_ack_t* ack = oris_delta_begin(delta);
+	char *url_str = NULL, *delta_url_str = NULL;
+
+	row = evbuffer_new();
+	changed = evbuffer_new();
+	indexes = evbuffer_new();
+	hashes = malloc((size_t) (tbl->row_count > 0 ? tbl->row_count : 1) * sizeof(*hashes));
+	if (!row || !changed || !indexes || !hashes) {
+		oris_log_f(LOG_ERR, "could not allocate delta of table %s", tbl->name);
+		goto cleanup;
+	}
+
+	evbuffer_expand(buf, (size_t) tbl->row_count * (tmpl->size_hint + 3) + 8);
+	evbuffer_add(buf, "{\"v\":[", 6);
+
+	l = tbl->current_row;
+	for (tbl->current_row = 0; tbl->current_row < tbl->row_count; tbl->current_row++) {
+		evbuffer_add(row, tbl->current_row > 0 ? ",{" : "{", tbl->current_row > 0 ? 2 : 1);
+		oris_parse_template(row, tmpl, false);
+		evbuffer_add(row, "}", 1);
+
+		/* without the leading comma */
+		length = evbuffer_get_length(row);
+		hashes[tbl->current_row] = oris_hash64(evbuffer_pullup(row, -1) +
+			(tbl->current_row > 0), length - (tbl->current_row > 0));
+
+		if (oris_delta_row_changed(delta, tbl->current_row, hashes[tbl->current_row])) {
+			evbuffer_add_printf(indexes, changes > 0 ? ",%d" : "%d", tbl->current_row);
+			evbuffer_add(changed, changes > 0 ? "," : "", changes > 0);
+			evbuffer_add(changed, evbuffer_pullup(row, -1) + (tbl->current_row > 0),
+				length - (tbl->current_row > 0));
+			changes++;
+		}
+
+		evbuffer_add_buffer(buf, row);
+	}
+	tbl->current_row = l;
+
+	evbuffer_add(buf, "]}", 2);
+
+	changes += oris_delta_removed(delta, tbl->row_count);
+	url_str = oris_eval_url(url);
+	delta_url_str = oris_eval_url(delta_url);
+	if (oris_delta_use_full(delta, tbl->row_count, changes)) {
+		oris_perform_http_with_ack(info, method, url_str, delta_url_str, buf, ack);
+	} else if (changes > 0) {
+		oris_log_f(LOG_DEBUG, "%d of %d rows of table %s changed", changes,
+			tbl->row_count, tbl->name);
+		evbuffer_drain(buf, evbuffer_get_length(buf));
+		evbuffer_add_printf(buf, "{\"count\":%d,\"rows\":[", tbl->row_count);
+		evbuffer_add_buffer(buf, indexes);
+		evbuffer_add(buf, "],\"v\":[", 7);
+		evbuffer_add_buffer(buf, changed);
+		evbuffer_add(buf, "]}", 2);
+		oris_perform_http_with_ack(info, method, delta_url_str, url_str, buf, ack);
+	}
+
+	oris_delta_update(delta, hashes, tbl->row_count);
+
+cleanup:
+	free(url_str);
+	free(delta_url_str);
+	free(hashes);
+	if (indexes) {
+		evbuffer_free(indexes);
+	}
+	if (changed) {
+		evbuffer_free(changed);
+	}
+	if (row) {
+		evbuffer_free(row);
+	}
+}
+
 static void oris_perform_http_on_table(oris_application_info_t* info,
-	enum evhttp_cmd_type method, pANTLR3_BASE_TREE url, struct evbuffer* buf,
-	pANTLR3_BASE_TREE tmpl, oris_table_t* tbl, bool perform_per_record)
+	enum evhttp_cmd_type method, const oris_expr_program_t* url, struct evbuffer* buf,
+	const oris_template_t* tmpl, oris_table_t* tbl, bool perform_per_record)
 {
 	int l;
 
@@ -377,30 +470,34 @@ static void oris_perform_http_on_table(oris_application_info_t* info,
 
 		tbl->current_row = l;
 	} else {
-		evbuffer_add_printf(buf, "{\"v\":[");
+		evbuffer_add(buf, "{\"v\":[", 6);
 		oris_parse_foreach_template(buf, tbl, tmpl);
-		evbuffer_add_printf(buf, "]}");
+		evbuffer_add(buf, "]}", 2);
 
 		oris_perform_http_with_buffer(info, method, url, buf);
 	}
 }
 
 void oris_automation_http_action(oris_application_info_t* info,
-    enum evhttp_cmd_type method, pANTLR3_BASE_TREE url,
-    pANTLR3_BASE_TREE tmpl_name, oris_parse_expr_t* value_expr,
-	const char* tbl_name, bool perform_per_record)
+	enum evhttp_cmd_type method, const oris_expr_program_t* url,
+	const oris_template_t* tmpl, const oris_expr_program_t* value,
+	const char* tbl_name, bool perform_per_record,
+	const oris_expr_program_t* delta_url, oris_delta_state_t* delta)
 {
 	struct evbuffer* buf;
 	oris_table_t* tbl;
-	pANTLR3_BASE_TREE tmpl;
+	oris_parse_expr_t* value_expr;
 
 	buf = evbuffer_new();
 
-    if (tmpl_name) {
+	if (tmpl) {
 		tbl = tbl_name ? oris_get_table(&info->data_tables, tbl_name) : NULL;
-		tmpl = oris_get_template_by_name(tmpl_name->getText(tmpl_name));
 
-		if (tbl) {
+		if (tbl && delta && !info->paused) {
+			/* only changes if possible */
+			oris_perform_http_on_table_delta(info, method, url, delta_url, buf,
+				tmpl, tbl, delta);
+		} else if (tbl) {
 			/* table given: now perform http record-wise or for the whole table */
 			oris_perform_http_on_table(info, method, url, buf, tmpl, tbl, perform_per_record);
 		} else {
@@ -408,11 +505,12 @@ void oris_automation_http_action(oris_application_info_t* info,
 			oris_parse_template(buf, tmpl, true);
 			oris_perform_http_with_buffer(info, method, url, buf);
 		}
-	} else if (value_expr) {
+	} else if (!oris_expr_program_is_empty(value)) {
+		value_expr = oris_expr_eval(value);
 		oris_dump_expr_value_to_buffer(buf, value_expr);
 		oris_perform_http_with_buffer(info, method, url, buf);
 		oris_free_expr_value(value_expr);
-    } else {
+	} else {
 		oris_perform_http_with_buffer(info, method, url, buf);
 	}
 
@@ -420,8 +518,8 @@ void oris_automation_http_action(oris_application_info_t* info,
 }
 
 void oris_automation_set_tbl_record(oris_application_info_t* info,
-	const char* tbl_name, pANTLR3_BASE_TREE field,
-	pANTLR3_BASE_TREE value_expr)
+	const char* tbl_name, const oris_expr_program_t* field,
+	const oris_expr_program_t* value_expr)
 {
 	oris_table_t* tbl = tbl_name ? oris_get_table(&info->data_tables, tbl_name) : NULL;
 	oris_parse_expr_t *field_name, *value;
@@ -429,8 +527,8 @@ void oris_automation_set_tbl_record(oris_application_info_t* info,
 	char *str;
 
 	if (tbl) {
-		field_name = oris_expr_parse_from_tree(field);
-		value = oris_expr_parse_from_tree(value_expr);
+		field_name = oris_expr_eval(field);
+		value = oris_expr_eval(value_expr);
 
 		if (!oris_expr_as_int(field_name, &field_index)) {
 			field_index = oris_table_get_field_index(tbl, (char*) field_name->value.as_string->chars);
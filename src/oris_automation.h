@@ -3,10 +3,10 @@
 
 #include <stdbool.h>
 #include <event2/http.h>
-#include <antlr3commontree.h>
 
 #include "oris_app_info.h"
 #include "oris_automation_types.h"
+#include "oris_program.h"
 
 /* life-cycle stuff */
 bool oris_automation_init(oris_application_info_t* app_info);
@@ -15,21 +15,32 @@ void oris_automation_finalize();
 /* functions */
 void oris_automation_trigger(oris_automation_event_t* event, oris_application_info_t* info);
 
+/* execute the compiled operations of an event */
+void oris_automation_run(const oris_program_t* prog, oris_application_info_t* info);
+
+/* render a template for the current table rows, wrapped into {"v":{...}}
+ * with with_v_prefix, or for every row of tbl as objects separated by commas */
+void oris_parse_template(struct evbuffer* target, const oris_template_t* tmpl,
+	bool with_v_prefix);
+void oris_parse_foreach_template(struct evbuffer* buf, oris_table_t* tbl,
+	const oris_template_t* template);
+
 /* implementation of the automation actions */
 void oris_automation_foreach_action(oris_application_info_t* info,
-	const char* request_name, const char* tbl_name);
+	const oris_request_def_t* request, const char* tbl_name);
 
 void oris_automation_request_action(oris_application_info_t* info,
-	const char* request_name);
+	const oris_request_def_t* request);
 
 void oris_automation_http_action(oris_application_info_t* info,
-    enum evhttp_cmd_type method, pANTLR3_BASE_TREE url,
-    pANTLR3_BASE_TREE tmpl_name, oris_parse_expr_t* value_expr,
-	const char* tbl_name, bool request_per_record);
+	enum evhttp_cmd_type method, const oris_expr_program_t* url,
+	const oris_template_t* tmpl, const oris_expr_program_t* value,
+	const char* tbl_name, bool request_per_record,
+	const oris_expr_program_t* delta_url, oris_delta_state_t* delta);
 
 void oris_automation_set_tbl_record(oris_application_info_t* info,
-	const char* tbl_name, pANTLR3_BASE_TREE field_expr,
-	pANTLR3_BASE_TREE value_expr);
+	const char* tbl_name, const oris_expr_program_t* field_expr,
+	const oris_expr_program_t* value_expr);
 
 void oris_automation_copy_table(oris_application_info_t* info,
 	oris_parse_expr_t* src, oris_parse_expr_t* dst);
@@ -7,7 +7,7 @@ typedef struct {
 	oris_event_type_t type;
 	union {
 		char* name;
-		unsigned int interval;
+		unsigned int interval; /* milliseconds */
 	};
 } oris_automation_event_t;
 
@@ -0,0 +1,417 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <event2/util.h>
+
+#include "oris_capture.h"
+#include "oris_snapshot.h"
+#include "oris_util.h"
+#include "oris_log.h"
+
+#ifdef _WIN32
+#define fseeko _fseeki64
+#define ftello _ftelli64
+typedef __int64 capture_off_t;
+#else
+typedef off_t capture_off_t;
+#endif
+
+#define RECORD_TYPE_DATA 0x01
+#define RECORD_TYPE_INDEX 0x02
+
+/* type byte and three varints of at most ten bytes each */
+#define RECORD_HEADER_MAX 31
+
+static void put_u64(unsigned char* p, uint64_t v)
+{
+	int i;
+
+	for (i = 7; i >= 0; i--) {
+		p[i] = (unsigned char) v;
+		v >>= 8;
+	}
+}
+
+static uint64_t get_u64(const unsigned char* p)
+{
+	uint64_t v = 0;
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		v = (v << 8) | p[i];
+	}
+
+	return v;
+}
+
+static size_t put_varint(unsigned char* p, uint64_t v)
+{
+	size_t n = 0;
+
+	while (v >= 0x80) {
+		p[n++] = (unsigned char) (v | 0x80);
+		v >>= 7;
+	}
+	p[n++] = (unsigned char) v;
+
+	return n;
+}
+
+static bool get_varint(FILE* f, uint64_t* v)
+{
+	int c, shift = 0;
+
+	*v = 0;
+	do {
+		c = getc(f);
+		if (c == EOF || shift > 63) {
+			return false;
+		}
+		*v |= (uint64_t) (c & 0x7f) << shift;
+		shift += 7;
+	} while (c & 0x80);
+
+	return true;
+}
+
+static bool oris_capture_reserve(oris_capture_t* capture, size_t size)
+{
+	size_t capacity = capture->chunk_capacity > 0 ? capture->chunk_capacity :
+		ORIS_CAPTURE_CHUNK_SIZE;
+
+	if (capture->chunk_size + size <= capture->chunk_capacity) {
+		return true;
+	}
+
+	while (capacity < capture->chunk_size + size) {
+		capacity *= 2;
+	}
+
+	if (!oris_safe_realloc((void**) &capture->chunk, capacity, 1)) {
+		return false;
+	}
+	capture->chunk_capacity = capacity;
+
+	return true;
+}
+
+/* hand the records collected so far to the writer */
+static void oris_capture_flush(oris_capture_t* capture, uint64_t now)
+{
+	capture->flushed = now;
+	if (capture->chunk_size == 0) {
+		return;
+	}
+
+	/* the writer owns the chunk now */
+	if (!oris_snapshot_append(capture->fn, capture->chunk, capture->chunk_size)) {
+		oris_log_f(LOG_ERR, "could not write %lu bytes to capture %s",
+			(unsigned long) capture->chunk_size, capture->fn);
+		free(capture->chunk);
+	}
+
+	capture->chunk = NULL;
+	capture->chunk_size = 0;
+	capture->chunk_capacity = 0;
+}
+
+static void oris_capture_add_index(oris_capture_t* capture)
+{
+	if (capture->index_count == capture->index_capacity) {
+		size_t capacity = capture->index_capacity > 0 ? capture->index_capacity * 2 : 64;
+
+		if (!oris_safe_realloc((void**) &capture->index, capacity,
+				sizeof(*capture->index))) {
+			return;
+		}
+		capture->index_capacity = capacity;
+	}
+
+	capture->index[capture->index_count].offset = capture->offset;
+	capture->index[capture->index_count].usec = capture->last;
+	capture->index_count++;
+}
+
+bool oris_capture_open(oris_capture_t* capture, const char* fn)
+{
+	unsigned char header[ORIS_CAPTURE_HEADER_SIZE];
+	struct timeval now;
+	FILE* f;
+	bool ok;
+
+	memset(capture, 0, sizeof(*capture));
+
+	evutil_gettimeofday(&now, NULL);
+	memcpy(header, ORIS_CAPTURE_MAGIC, 8);
+	put_u64(header + 8, (uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_usec);
+
+	/* written before the event loop runs, everything else goes to the writer */
+	f = fopen(fn, "wb");
+	if (!f) {
+		oris_log_f(LOG_ERR, "could not create capture %s: %s", fn, strerror(errno));
+		return false;
+	}
+	ok = fwrite(header, sizeof(header), 1, f) == 1;
+	ok = fclose(f) == 0 && ok;
+	if (!ok) {
+		oris_log_f(LOG_ERR, "could not write capture %s", fn);
+		return false;
+	}
+
+	capture->fn = strdup(fn);
+	capture->offset = ORIS_CAPTURE_HEADER_SIZE;
+	oris_log_f(LOG_INFO, "capturing data connections to %s", fn);
+
+	return capture->fn != NULL;
+}
+
+void oris_capture_close(oris_capture_t* capture)
+{
+	unsigned char* p;
+	uint64_t index_offset = capture->offset;
+	size_t i, size;
+
+	if (!capture->fn) {
+		return;
+	}
+
+	size = 1 + 8 + capture->index_count * 16 + ORIS_CAPTURE_FOOTER_SIZE;
+	if (oris_capture_reserve(capture, size)) {
+		p = (unsigned char*) capture->chunk + capture->chunk_size;
+		*p++ = RECORD_TYPE_INDEX;
+		put_u64(p, capture->index_count);
+		p += 8;
+		for (i = 0; i < capture->index_count; i++) {
+			put_u64(p, capture->index[i].offset);
+			put_u64(p + 8, capture->index[i].usec);
+			p += 16;
+		}
+		put_u64(p, index_offset);
+		memcpy(p + 8, ORIS_CAPTURE_INDEX_MAGIC, 8);
+		capture->chunk_size += size;
+	} else {
+		oris_log_f(LOG_WARNING, "could not write the index of capture %s", capture->fn);
+	}
+	oris_capture_flush(capture, 0);
+
+	oris_log_f(LOG_INFO, "captured %lu records (%lu bytes) to %s", capture->records,
+		(unsigned long) capture->bytes, capture->fn);
+
+	oris_free_and_null(capture->index);
+	oris_free_and_null(capture->fn);
+	capture->index_count = 0;
+	capture->index_capacity = 0;
+}
+
+unsigned oris_capture_stream(oris_capture_t* capture)
+{
+	return capture->streams++;
+}
+
+void oris_capture_write(oris_capture_t* capture, unsigned stream, uint64_t received,
+	struct evbuffer* buf, size_t offset)
+{
+	struct evbuffer_ptr pos;
+	unsigned char* p;
+	size_t size, header;
+	uint64_t usec;
+
+	if (!capture->fn || evbuffer_get_length(buf) <= offset) {
+		return;
+	}
+
+	size = evbuffer_get_length(buf) - offset;
+	if (!oris_capture_reserve(capture, RECORD_HEADER_MAX + size)) {
+		oris_log_f(LOG_ERR, "could not allocate capture buffer (out of memory?). Dropping data");
+		return;
+	}
+
+	if (capture->records == 0) {
+		capture->start = received;
+		capture->flushed = received;
+	}
+	usec = received > capture->start ? received - capture->start : 0;
+	usec = usec > capture->last ? usec : capture->last;
+
+	if (capture->records == 0 || capture->offset - (capture->index_count > 0 ?
+			capture->index[capture->index_count - 1].offset : 0) >=
+			ORIS_CAPTURE_INDEX_INTERVAL) {
+		oris_capture_add_index(capture);
+	}
+
+	p = (unsigned char*) capture->chunk + capture->chunk_size;
+	p[0] = RECORD_TYPE_DATA;
+	header = 1;
+	header += put_varint(p + header, usec - capture->last);
+	header += put_varint(p + header, stream);
+	header += put_varint(p + header, size);
+
+	evbuffer_ptr_set(buf, &pos, offset, EVBUFFER_PTR_SET);
+	evbuffer_copyout_from(buf, &pos, p + header, size);
+
+	capture->chunk_size += header + size;
+	capture->offset += header + size;
+	capture->last = usec;
+	capture->records++;
+	capture->bytes += size;
+
+	if (capture->chunk_size >= ORIS_CAPTURE_CHUNK_SIZE ||
+			received - capture->flushed >= 1000000) {
+		oris_capture_flush(capture, received);
+	}
+}
+
+static bool oris_capture_reader_load_index(oris_capture_reader_t* reader,
+	uint64_t size)
+{
+	unsigned char buf[16];
+	uint64_t offset, count, i;
+
+	if (size < ORIS_CAPTURE_HEADER_SIZE + ORIS_CAPTURE_FOOTER_SIZE ||
+			fseeko(reader->file, (capture_off_t) (size - ORIS_CAPTURE_FOOTER_SIZE), SEEK_SET) != 0 ||
+			fread(buf, sizeof(buf), 1, reader->file) != 1 ||
+			memcmp(buf + 8, ORIS_CAPTURE_INDEX_MAGIC, 8) != 0) {
+		return false;
+	}
+
+	offset = get_u64(buf);
+	if (offset < ORIS_CAPTURE_HEADER_SIZE || offset + 9 > size ||
+			fseeko(reader->file, (capture_off_t) offset, SEEK_SET) != 0 ||
+			getc(reader->file) != RECORD_TYPE_INDEX ||
+			fread(buf, 8, 1, reader->file) != 1) {
+		return false;
+	}
+
+	count = get_u64(buf);
+	if (count > (size - offset) / 16 || (count > 0 &&
+			!oris_safe_realloc((void**) &reader->index, (size_t) count,
+				sizeof(*reader->index)))) {
+		return false;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (fread(buf, sizeof(buf), 1, reader->file) != 1) {
+			return false;
+		}
+		reader->index[i].offset = get_u64(buf);
+		reader->index[i].usec = get_u64(buf + 8);
+	}
+
+	reader->index_count = (size_t) count;
+	reader->end = offset;
+
+	return true;
+}
+
+bool oris_capture_reader_open(oris_capture_reader_t* reader, const char* fn)
+{
+	unsigned char header[ORIS_CAPTURE_HEADER_SIZE];
+	uint64_t size;
+
+	memset(reader, 0, sizeof(*reader));
+
+	reader->file = fopen(fn, "rb");
+	if (!reader->file) {
+		oris_log_f(LOG_ERR, "could not open capture %s: %s", fn, strerror(errno));
+		return false;
+	}
+
+	if (fread(header, sizeof(header), 1, reader->file) != 1 ||
+			memcmp(header, ORIS_CAPTURE_MAGIC, 8) != 0) {
+		oris_log_f(LOG_ERR, "%s is not a capture", fn);
+		oris_capture_reader_close(reader);
+		return false;
+	}
+
+	fseeko(reader->file, 0, SEEK_END);
+	size = (uint64_t) ftello(reader->file);
+
+	if (!oris_capture_reader_load_index(reader, size)) {
+		oris_log_f(LOG_WARNING, "capture %s has no index, reading up to the last complete record", fn);
+		oris_free_and_null(reader->index);
+		reader->index_count = 0;
+		reader->end = size;
+	}
+
+	return oris_capture_reader_seek(reader, 0);
+}
+
+void oris_capture_reader_close(oris_capture_reader_t* reader)
+{
+	if (reader->file) {
+		fclose(reader->file);
+		reader->file = NULL;
+	}
+
+	oris_free_and_null(reader->index);
+	oris_free_and_null(reader->data);
+	reader->index_count = 0;
+	reader->capacity = 0;
+}
+
+bool oris_capture_reader_seek(oris_capture_reader_t* reader, uint64_t usec)
+{
+	size_t lo = 0, hi = reader->index_count, mid;
+
+	reader->offset = ORIS_CAPTURE_HEADER_SIZE;
+	reader->usec = 0;
+
+	/* the last entry not after usec */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (reader->index[mid].usec <= usec) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if (lo > 0) {
+		reader->offset = reader->index[lo - 1].offset;
+		reader->usec = reader->index[lo - 1].usec;
+	}
+
+	return fseeko(reader->file, (capture_off_t) reader->offset, SEEK_SET) == 0;
+}
+
+bool oris_capture_reader_next(oris_capture_reader_t* reader,
+	oris_capture_record_t* record)
+{
+	uint64_t delta, stream, size;
+
+	if (reader->offset >= reader->end || getc(reader->file) != RECORD_TYPE_DATA ||
+			!get_varint(reader->file, &delta) || !get_varint(reader->file, &stream) ||
+			!get_varint(reader->file, &size) || size > reader->end - reader->offset) {
+		return false;
+	}
+
+	if (size > reader->capacity) {
+		if (!oris_safe_realloc((void**) &reader->data, (size_t) size, 1)) {
+			oris_log_f(LOG_ERR, "could not allocate %lu bytes for capture record",
+				(unsigned long) size);
+			return false;
+		}
+		reader->capacity = (size_t) size;
+	}
+
+	if (fread(reader->data, 1, (size_t) size, reader->file) != size) {
+		return false;
+	}
+
+	reader->offset = (uint64_t) ftello(reader->file);
+	reader->usec += delta;
+
+	record->usec = reader->usec;
+	record->stream = (unsigned) stream;
+	record->data = reader->data;
+	record->size = (size_t) size;
+
+	return true;
+}
@@ -0,0 +1,110 @@
+#ifndef __ORIS_CAPTURE_H
+#define __ORIS_CAPTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <event2/buffer.h>
+
+/* capture of the bytes received from data connections
+ *
+ * The file starts with the magic and the wall clock time (usec) the capture
+ * was started. Each record is a type byte followed by the time since the
+ * previous record (usec), the stream (data connection) and the length as
+ * unsigned LEB128 varints and the bytes themselves. On close, an index of
+ * the file offsets every ORIS_CAPTURE_INDEX_INTERVAL bytes and a footer with
+ * its offset are appended. A capture without footer (e.g. after a crash) is
+ * read up to its last complete record. All writes are done by the
+ * background snapshot writer. */
+
+#define ORIS_CAPTURE_MAGIC "ORISCAP1"
+#define ORIS_CAPTURE_INDEX_MAGIC "ORISIDX1"
+#define ORIS_CAPTURE_HEADER_SIZE 16
+#define ORIS_CAPTURE_FOOTER_SIZE 16
+
+/* bytes of records between two index entries */
+#define ORIS_CAPTURE_INDEX_INTERVAL (64 * 1024)
+
+/* records are handed to the writer in chunks of this size or once a second */
+#define ORIS_CAPTURE_CHUNK_SIZE (64 * 1024)
+
+/* where reading may start: the offset of a record and the time of the
+ * record preceding it (usec since the start of the capture) */
+typedef struct {
+	uint64_t offset;
+	uint64_t usec;
+} oris_capture_index_entry_t;
+
+typedef struct oris_capture {
+	char* fn;
+	/* records not handed to the writer yet */
+	char* chunk;
+	size_t chunk_size;
+	size_t chunk_capacity;
+	/* file offset after the last record */
+	uint64_t offset;
+	/* monotonic usec of the first record, the last record relative to it and
+	 * when the chunk was last handed to the writer */
+	uint64_t start;
+	uint64_t last;
+	uint64_t flushed;
+	oris_capture_index_entry_t* index;
+	size_t index_count;
+	size_t index_capacity;
+	unsigned streams;
+	unsigned long records;
+	uint64_t bytes;
+} oris_capture_t;
+
+typedef struct {
+	/* usec since the start of the capture */
+	uint64_t usec;
+	unsigned stream;
+	const char* data;
+	size_t size;
+} oris_capture_record_t;
+
+typedef struct oris_capture_reader {
+	FILE* file;
+	/* offset of the next record and where the records end */
+	uint64_t offset;
+	uint64_t end;
+	/* time of the last record read */
+	uint64_t usec;
+	oris_capture_index_entry_t* index;
+	size_t index_count;
+	/* data of the last record read */
+	char* data;
+	size_t capacity;
+} oris_capture_reader_t;
+
+/* truncate fn and start a capture */
+bool oris_capture_open(oris_capture_t* capture, const char* fn);
+
+/* write the remaining records and the index, must precede
+ * oris_snapshot_finalize */
+void oris_capture_close(oris_capture_t* capture);
+
+/* a new stream number for a connection */
+unsigned oris_capture_stream(oris_capture_t* capture);
+
+/* record the bytes of buf following offset as received at the given
+ * monotonic usec */
+void oris_capture_write(oris_capture_t* capture, unsigned stream, uint64_t received,
+	struct evbuffer* buf, size_t offset);
+
+bool oris_capture_reader_open(oris_capture_reader_t* reader, const char* fn);
+void oris_capture_reader_close(oris_capture_reader_t* reader);
+
+/* continue with the last indexed record at or before usec (since the start
+ * of the capture), records before usec are not skipped */
+bool oris_capture_reader_seek(oris_capture_reader_t* reader, uint64_t usec);
+
+/* read the next record, its data is valid until the next call. false at the
+ * end of the capture. */
+bool oris_capture_reader_next(oris_capture_reader_t* reader,
+	oris_capture_record_t* record);
+
+#endif /* __ORIS_CAPTURE_H */
@@ -0,0 +1,122 @@
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define ORIS_CHARSET_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define ORIS_CHARSET_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#include "oris_charset.h"
+#include "oris_log.h"
+
+typedef size_t (*oris_ascii_prefix_fn_t)(const unsigned char* s, size_t len);
+
+static size_t oris_ascii_prefix_resolve(const unsigned char* s, size_t len);
+
+static oris_ascii_prefix_fn_t ascii_prefix = oris_ascii_prefix_resolve;
+
+/* scalar version, also used for the tail of the vectorized ones */
+static size_t oris_ascii_prefix_scalar(const unsigned char* s, size_t len)
+{
+	uint64_t w;
+	size_t i = 0;
+
+	for (; i + sizeof(w) <= len; i += sizeof(w)) {
+		memcpy(&w, s + i, sizeof(w));
+		if (w & UINT64_C(0x8080808080808080)) {
+			break;
+		}
+	}
+
+	while (i < len && s[i] < 0x80) {
+		i++;
+	}
+
+	return i;
+}
+
+#ifdef ORIS_CHARSET_SSE2
+static size_t oris_ascii_prefix_sse2(const unsigned char* s, size_t len)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= len; i += 16) {
+		if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*) (s + i)))) {
+			break;
+		}
+	}
+
+	return i + oris_ascii_prefix_scalar(s + i, len - i);
+}
+#endif
+
+#ifdef ORIS_CHARSET_AVX2
+__attribute__((target("avx2")))
+static size_t oris_ascii_prefix_avx2(const unsigned char* s, size_t len)
+{
+	size_t i = 0;
+
+	for (; i + 32 <= len; i += 32) {
+		if (_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*) (s + i)))) {
+			break;
+		}
+	}
+
+	return i + oris_ascii_prefix_scalar(s + i, len - i);
+}
+#endif
+
+/* picks the best implementation for the cpu on first use */
+static size_t oris_ascii_prefix_resolve(const unsigned char* s, size_t len)
+{
+	const char* name = "scalar";
+
+	ascii_prefix = oris_ascii_prefix_scalar;
+#ifdef ORIS_CHARSET_SSE2
+	ascii_prefix = oris_ascii_prefix_sse2;
+	name = "sse2";
+#endif
+#ifdef ORIS_CHARSET_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		ascii_prefix = oris_ascii_prefix_avx2;
+		name = "avx2";
+	}
+#endif
+
+	oris_log_f(LOG_DEBUG, "using %s charset conversion", name);
+
+	return ascii_prefix(s, len);
+}
+
+size_t oris_ascii_prefix(const char* s, size_t len)
+{
+	return ascii_prefix((const unsigned char*) s, len);
+}
+
+size_t oris_iso8859_to_utf8(const char* in, size_t len, char* out)
+{
+	const unsigned char* s = (const unsigned char*) in;
+	unsigned char* o = (unsigned char*) out;
+	size_t i = 0, n;
+
+	while (i < len) {
+		/* copy ASCII runs at once, expand the others to two bytes */
+		n = ascii_prefix(s + i, len - i);
+		memcpy(o, s + i, n);
+		o += n;
+		i += n;
+
+		for (; i < len && s[i] >= 0x80; i++) {
+			*o++ = 0xc2 + (s[i] > 0xbf);
+			*o++ = 0x80 + (s[i] & 0x3f);
+		}
+	}
+	*o = '\0';
+
+	return (size_t) (o - (unsigned char*) out);
+}
@@ -0,0 +1,16 @@
+#ifndef __ORIS_CHARSET_H
+#define __ORIS_CHARSET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* length of the leading pure ASCII part of s */
+size_t oris_ascii_prefix(const char* s, size_t len);
+
+#define oris_is_ascii(s, len) (oris_ascii_prefix((s), (len)) == (len))
+
+/* converts ISO-8859-1 to UTF-8. out must be able to hold 2 * len + 1 bytes,
+ * the result is NUL terminated and its length is returned */
+size_t oris_iso8859_to_utf8(const char* in, size_t len, char* out);
+
+#endif /* __ORIS_CHARSET_H */
@@ -1,5 +1,7 @@
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
+#include <ctype.h>
 #include <errno.h>
 
 #include <sys/queue.h>
@@ -11,6 +13,7 @@
 #include "oris_connection.h"
 #include "oris_configuration.h"
 #include "oris_log.h"
+#include "oris_util.h"
 
 #include "grammars/configLexer.h"
 #include "grammars/configParser.h"
@@ -39,11 +42,25 @@ void oris_add_config_file(const char* filename)
 static pANTLR3_BASE_TREE get_subtree_by_type(pANTLR3_BASE_TREE tree, ANTLR3_UINT32 type);
 static pANTLR3_LIST get_nodes_of_type(pANTLR3_BASE_TREE tree, ANTLR3_UINT32 type, pANTLR3_LIST result);
 static void collect_automation_nodes(pANTLR3_BASE_TREE root_tree);
+static void link_automation_events(void);
+static void build_dispatch_table(void);
+static void free_dispatch_table(void);
 static bool oris_load_config_file(oris_application_info_t* info, const char* filename);
 
 static size_t automation_events_count;
 static oris_automation_action_t* automation_events;
 
+/* dispatch table for all but timer events: open addressing over type and the
+ * case folded name, each bucket lists the matching events in config order */
+typedef struct {
+	const oris_automation_event_t* key;
+	size_t count;
+	const oris_automation_action_t** actions;
+} oris_dispatch_bucket_t;
+
+static oris_dispatch_bucket_t* dispatch;
+static size_t dispatch_size;
+
 static struct {
 	pANTLR3_INPUT_STREAM input;
 	pconfigLexer lexer;
@@ -52,8 +69,6 @@ static struct {
 	pANTLR3_COMMON_TREE_NODE_STREAM node_stream;
 	configParser_configuration_return parseTree;
 	pANTLR3_BASE_TREE automationTree;
-    pANTLR3_BASE_TREE request_defs_node;
-    pANTLR3_LIST templates;
 } parsing_state;
 
 bool oris_load_configuration(oris_application_info_t* info)
@@ -84,13 +99,20 @@ bool oris_load_configuration(oris_application_info_t* info)
 		oris_log_f(LOG_WARNING, "no configuration file(s) given");
 	}
 
+	if (retval) {
+		link_automation_events();
+		build_dispatch_table();
+	}
+
 	return retval;
 }
 
 static bool oris_load_config_file(oris_application_info_t* info, const char* filename)
 {
 	pANTLR3_BASE_TREE configTree, tree;
+	pANTLR3_LIST templates;
 	pconfigTree walker;
+	ANTLR3_UINT32 i;
 
 	oris_log_f(LOG_DEBUG, "loading configuration from: %s.", filename);
 
@@ -126,15 +148,8 @@ static bool oris_load_config_file(oris_application_info_t* info, const char* fil
 	}
 
 	configTree = get_subtree_by_type(parsing_state.parseTree.tree, CONFIG);
-    parsing_state.request_defs_node = get_subtree_by_type(parsing_state.parseTree.tree, REQUESTS);
 	parsing_state.automationTree = get_subtree_by_type(parsing_state.parseTree.tree, AUTOMATION);
 
-    parsing_state.templates = antlr3ListNew(32); /* we expect no more than 32 templates */
-    tree = get_subtree_by_type(parsing_state.parseTree.tree, TEMPLATES);
-    if (tree) {
-        parsing_state.templates = get_nodes_of_type(tree, TEMPLATE, parsing_state.templates);
-    }
-
 	/* create tree parser for configuration */
 	parsing_state.node_stream = antlr3CommonTreeNodeStreamNewTree(configTree, ANTLR3_SIZE_HINT);
 	walker = configTreeNew(parsing_state.node_stream);
@@ -142,10 +157,23 @@ static bool oris_load_config_file(oris_application_info_t* info, const char* fil
 	/* walk the configuration node (parses connections and targets) */
 	walker->configuration(walker, info);
 	walker->free(walker);
-
-	/* recreate token stream for re-use on automation interpretation */
 	parsing_state.node_stream->free(parsing_state.node_stream);
-	parsing_state.node_stream = antlr3CommonTreeNodeStreamNewTree(parsing_state.automationTree, ANTLR3_SIZE_HINT);
+
+	/* compile templates and requests first, the automation refers to them */
+	templates = antlr3ListNew(32); /* we expect no more than 32 templates */
+	tree = get_subtree_by_type(parsing_state.parseTree.tree, TEMPLATES);
+	if (tree) {
+		get_nodes_of_type(tree, TEMPLATE, templates);
+	}
+	for (i = 1; i < templates->size(templates) + 1; i++) {
+		oris_program_add_template(templates->get(templates, i));
+	}
+	templates->free(templates);
+
+	tree = get_subtree_by_type(parsing_state.parseTree.tree, REQUESTS);
+	if (tree) {
+		oris_program_add_requests(tree);
+	}
 
 	collect_automation_nodes(parsing_state.automationTree);
 
@@ -161,21 +189,21 @@ void oris_configuration_finalize(void)
 {
 	size_t i;
 
-	parsing_state.node_stream->free(parsing_state.node_stream);
-
-	parsing_state.input->close(parsing_state.input);
-	parsing_state.lexer->free(parsing_state.lexer);
-	parsing_state.token_stream->free(parsing_state.token_stream); /* ! */
-	parsing_state.parser->free(parsing_state.parser);
-    parsing_state.templates->free(parsing_state.templates);
+	free_dispatch_table();
 
+	/* programs refer to the token texts, release them first */
 	if (automation_events) {
 		for (i = 0; i < automation_events_count; i++) {
-//			automation_events[i].tree->free(automation_events[i].tree);
-			automation_events[i].node_stream->free(automation_events[i].node_stream);
+			oris_program_free(&automation_events[i].program);
 		}
 		free(automation_events);
 	}
+	oris_program_free_definitions();
+
+	parsing_state.input->close(parsing_state.input);
+	parsing_state.lexer->free(parsing_state.lexer);
+	parsing_state.token_stream->free(parsing_state.token_stream); /* ! */
+	parsing_state.parser->free(parsing_state.parser);
 }
 
 static pANTLR3_BASE_TREE get_subtree_by_type(pANTLR3_BASE_TREE tree, ANTLR3_UINT32 type)
@@ -227,54 +255,6 @@ static pANTLR3_LIST get_nodes_of_type(pANTLR3_BASE_TREE tree, ANTLR3_UINT32 type
     return result;
 }
 
-pANTLR3_BASE_TREE oris_get_request_parse_tree(const char *name)
-{
-    ANTLR3_UINT32 i, child_count;
-    pANTLR3_BASE_TREE child;
-    pANTLR3_COMMON_TOKEN token;
-    pANTLR3_STRING token_name;
-
-	if (!parsing_state.request_defs_node) {
-		oris_log_f(LOG_WARNING, "no requests defined");
-		return NULL;
-	}
-
-    child_count = parsing_state.request_defs_node->getChildCount(parsing_state.request_defs_node);
-    for (i = 0; i < child_count; i += 2) {
-        child = parsing_state.request_defs_node->getChild(parsing_state.request_defs_node, i);
-        token = child->getToken(child);
-        token_name = token->getText(token);
-        if (token_name->compare(token_name, name) == 0) {
-            /* this is an expression node */
-            child = parsing_state.request_defs_node->getChild(parsing_state.request_defs_node, i + 1);
-
-            return child;
-        }
-    }
-
-    oris_log_f(LOG_WARNING, "request %s does not exist", name);
-    return NULL;
-}
-
-pANTLR3_BASE_TREE oris_get_template_by_name(pANTLR3_STRING name)
-{
-	ANTLR3_UINT32 i;
-	pANTLR3_BASE_TREE tmpl, inode;
-	pANTLR3_STRING iname;
-
-	for (i = 1; i < parsing_state.templates->size(parsing_state.templates) + 1; i++) {
-		tmpl = parsing_state.templates->get(parsing_state.templates, i);
-		inode = tmpl->getChild(tmpl, 0);
-		iname = inode->getText(inode);
-		if (inode->getType(inode) == IDENTIFIER && iname->compareS(iname, name) == 0) {
-			return tmpl;
-		}
-	}
-
-    oris_log_f(LOG_WARNING, "template %s does not exist", name->chars);
-	return NULL;
-}
-
 static oris_automation_event_t parse_automation_object_node(pANTLR3_BASE_TREE object)
 {
 	pANTLR3_COMMON_TREE_NODE_STREAM node_stream;
@@ -301,6 +281,7 @@ static void collect_automation_nodes(pANTLR3_BASE_TREE root_tree)
     e_count = root_tree->getChildCount(root_tree);
     oris_log_f(LOG_DEBUG, "loading %d automation actions", e_count);
 	automation_events = realloc(automation_events, (automation_events_count + e_count) * sizeof(*automation_events));
+	memset(automation_events + automation_events_count, 0, e_count * sizeof(*automation_events));
 
     for (i = 0; i < e_count; i++) {
 		event = root_tree->getChild(root_tree, i);
@@ -309,14 +290,121 @@ static void collect_automation_nodes(pANTLR3_BASE_TREE root_tree)
 
 		object = event->getChild(event, 0);
 		automation_events[i + automation_events_count].event = parse_automation_object_node(object);
-		automation_events[i + automation_events_count].tree = event->getChild(event, 1);
-		automation_events[i + automation_events_count].node_stream = antlr3CommonTreeNodeStreamNewTree(
-			automation_events[i + automation_events_count].tree, ANTLR3_SIZE_HINT);
+		oris_program_compile(&automation_events[i + automation_events_count].program,
+			event->getChild(event, 1));
 	}
 
     automation_events_count += e_count;
 }
 
+/* templates and requests may be defined in any of the config files, so they
+ * are bound after all files are loaded */
+static void link_automation_events(void)
+{
+	size_t i, missing = 0;
+
+	for (i = 0; i < automation_events_count; i++) {
+		missing += oris_program_link(&automation_events[i].program);
+	}
+
+	if (missing > 0) {
+		oris_log_f(LOG_ERR, "%d unresolved template/request reference(s), "
+			"the affected actions are skipped", (int) missing);
+	}
+}
+
+/* FNV-1a over the event type and the lower case name */
+static size_t dispatch_hash(const oris_automation_event_t* event)
+{
+	const unsigned char* s;
+	uint32_t h = 2166136261u;
+
+	h = (h ^ (uint32_t) event->type) * 16777619u;
+	for (s = (const unsigned char*) event->name; *s; s++) {
+		h = (h ^ (uint32_t) tolower(*s)) * 16777619u;
+	}
+
+	return (size_t) h;
+}
+
+static oris_dispatch_bucket_t* dispatch_lookup(const oris_automation_event_t* event)
+{
+	size_t slot;
+
+	if (dispatch_size == 0) {
+		return NULL;
+	}
+
+	slot = dispatch_hash(event) & (dispatch_size - 1);
+	while (dispatch[slot].key) {
+		if (oris_is_same_automation_event(dispatch[slot].key, event)) {
+			return &dispatch[slot];
+		}
+		slot = (slot + 1) & (dispatch_size - 1);
+	}
+
+	/* the (empty) slot the event belongs to */
+	return &dispatch[slot];
+}
+
+static void build_dispatch_table(void)
+{
+	oris_dispatch_bucket_t* bucket;
+	const oris_automation_action_t** actions;
+	size_t i;
+
+	dispatch_size = 16;
+	while (dispatch_size < automation_events_count * 2) {
+		dispatch_size *= 2;
+	}
+
+	dispatch = calloc(dispatch_size, sizeof(*dispatch));
+	if (!dispatch) {
+		dispatch_size = 0;
+		return;
+	}
+
+	for (i = 0; i < automation_events_count; i++) {
+		if (automation_events[i].event.type == EVT_TIMER || !automation_events[i].event.name) {
+			continue;
+		}
+
+		bucket = dispatch_lookup(&automation_events[i].event);
+		actions = realloc(bucket->actions, (bucket->count + 1) * sizeof(*actions));
+		if (!actions) {
+			oris_log_f(LOG_ERR, "could not register automation event %s",
+				automation_events[i].event.name);
+			continue;
+		}
+
+		actions[bucket->count++] = &automation_events[i];
+		bucket->actions = actions;
+		bucket->key = &automation_events[i].event;
+	}
+}
+
+static void free_dispatch_table(void)
+{
+	size_t i;
+
+	for (i = 0; i < dispatch_size; i++) {
+		free(dispatch[i].actions);
+	}
+
+	oris_free_and_null(dispatch);
+	dispatch_size = 0;
+}
+
+const oris_automation_action_t* const* oris_get_automation_handlers(
+	const oris_automation_event_t* event, size_t* count)
+{
+	oris_dispatch_bucket_t* bucket = dispatch_lookup(event);
+
+	*count = bucket ? bucket->count : 0;
+
+	return bucket ? bucket->actions : NULL;
+}
+
 size_t oris_get_automation_event_count(void)
 {
 	return automation_events_count;
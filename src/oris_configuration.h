@@ -9,11 +9,11 @@
 #include "oris_app_info.h"
 #include "oris_automation_types.h"
 #include "oris_table.h"
+#include "oris_program.h"
 
 typedef struct {
 	oris_automation_event_t event;
-	pANTLR3_BASE_TREE tree;
-	pANTLR3_COMMON_TREE_NODE_STREAM node_stream;
+	oris_program_t program;
 } oris_automation_action_t;
 
 /* add a filename to the internal list of config files */
@@ -26,9 +26,9 @@ bool oris_load_configuration(oris_application_info_t* info);
 void oris_configuration_init(void);
 void oris_configuration_finalize(void);
 
-pANTLR3_BASE_TREE oris_get_request_tree(const char* name);
-pANTLR3_BASE_TREE oris_get_request_parse_tree(const char *name);
-pANTLR3_BASE_TREE oris_get_template_by_name(pANTLR3_STRING name);
+/* automation events handling the given (non-timer) event, in config order */
+const oris_automation_action_t* const* oris_get_automation_handlers(
+	const oris_automation_event_t* event, size_t* count);
 
 size_t oris_get_automation_event_count(void);
 const oris_automation_action_t* oris_get_automation_event(size_t idx);
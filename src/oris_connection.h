@@ -12,6 +12,7 @@ typedef struct oris_connection {
 	/* statistical data */
 	size_t bytesIn;
 	size_t bytesOut;
+	size_t linesIn;
 	/* protocol which is used for this connection */
 	struct oris_protocol* protocol;
 	/* pointer to destructor */
@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "oris_util.h"
+#include "oris_delta.h"
+
+void oris_delta_init(oris_delta_state_t* state)
+{
+	memset(state, 0, sizeof(*state));
+}
+
+void oris_delta_free(oris_delta_state_t* state)
+{
+	oris_http_ack_unref(state->ack);
+	state->ack = NULL;
+	oris_free_and_null(state->rows);
+	state->count = 0;
+	state->capacity = 0;
+	state->published = false;
+}
+
+oris_http_ack_t* oris_delta_begin(oris_delta_state_t* state)
+{
+	if (!state->ack) {
+		state->ack = oris_http_ack_new();
+	}
+
+	if (!state->ack || state->ack->failed) {
+		state->published = false;
+	}
+	if (state->ack) {
+		state->ack->failed = false;
+	}
+
+	return state->ack;
+}
+
+bool oris_delta_row_changed(const oris_delta_state_t* state, int row, uint64_t hash)
+{
+	return row >= state->count || state->rows[row] != hash;
+}
+
+int oris_delta_removed(const oris_delta_state_t* state, int count)
+{
+	return state->count > count ? state->count - count : 0;
+}
+
+bool oris_delta_use_full(const oris_delta_state_t* state, int count, int changes)
+{
+	int rows = count > state->count ? count : state->count;
+
+	return !state->published || changes * 100 > rows * ORIS_DELTA_FULL_PERCENT;
+}
+
+bool oris_delta_update(oris_delta_state_t* state, const uint64_t* rows, int count)
+{
+	uint64_t* tmp;
+
+	if (count > state->capacity) {
+		tmp = realloc(state->rows, (size_t) count * sizeof(*tmp));
+		if (!tmp) {
+			/* publish the whole table next time */
+			oris_delta_free(state);
+			return false;
+		}
+		state->rows = tmp;
+		state->capacity = count;
+	}
+
+	if (count > 0) {
+		memcpy(state->rows, rows, (size_t) count * sizeof(*rows));
+	}
+	state->count = count;
+	state->published = true;
+
+	return true;
+}
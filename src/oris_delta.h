@@ -0,0 +1,41 @@
+#ifndef __ORIS_DELTA_H
+#define __ORIS_DELTA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "oris_http_payload.h"
+
+/* send the whole table if more than this percentage of its rows changed */
+#define ORIS_DELTA_FULL_PERCENT 25
+
+/* fingerprints of the rendered rows of a table as last published */
+typedef struct oris_delta_state {
+	uint64_t* rows;
+	int count;
+	int capacity;
+	bool published;
+	/* shared with the requests publishing the table */
+	oris_http_ack_t* ack;
+} oris_delta_state_t;
+
+void oris_delta_init(oris_delta_state_t* state);
+void oris_delta_free(oris_delta_state_t* state);
+
+/* start publishing the table again: if a request of the last ones failed
+ * the whole table is sent. Returns the ack for the new requests. */
+oris_http_ack_t* oris_delta_begin(oris_delta_state_t* state);
+
+/* whether a row with the given fingerprint differs from the published one */
+bool oris_delta_row_changed(const oris_delta_state_t* state, int row, uint64_t hash);
+
+/* number of published rows missing from a table with count rows */
+int oris_delta_removed(const oris_delta_state_t* state, int count);
+
+/* whether the whole table has to be sent instead of the changes */
+bool oris_delta_use_full(const oris_delta_state_t* state, int count, int changes);
+
+/* remember the fingerprints of the published rows */
+bool oris_delta_update(oris_delta_state_t* state, const uint64_t* rows, int count);
+
+#endif /* __ORIS_DELTA_H */
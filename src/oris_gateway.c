@@ -8,6 +8,8 @@
 #include "oris_app_info.h"
 #include "oris_configuration.h"
 #include "oris_automation.h"
+#include "oris_timer.h"
+#include "oris_snapshot.h"
 
 int oris_main_default(oris_application_info_t *info)
 {
@@ -16,6 +18,20 @@ int oris_main_default(oris_application_info_t *info)
 		return EXIT_FAILURE;
 	}
 
+	if (info->storage_fn) {
+		if (!oris_storage_init(&info->storage, &info->data_tables, info->storage_fn,
+				info->journal_storage)) {
+			oris_log_f(LOG_CRIT, "could not init storage %s. Exiting", info->storage_fn);
+			return EXIT_FAILURE;
+		}
+		oris_storage_restore(&info->storage);
+	}
+
+	if (info->capture_fn && !oris_capture_open(&info->capture, info->capture_fn)) {
+		oris_log_f(LOG_CRIT, "could not start capture %s. Exiting", info->capture_fn);
+		return EXIT_FAILURE;
+	}
+
 	oris_automation_init(info);
 	oris_interpreter_init(&info->data_tables);
 	oris_configuration_init();
@@ -30,10 +46,16 @@ int oris_main_default(oris_application_info_t *info)
 		return EXIT_FAILURE;
 	}
 
+	if (!oris_timers_init(info)) {
+		oris_log_f(LOG_ERR, "failed to set up timer events");
+		return EXIT_FAILURE;
+	}
+
 	/* run */
 	event_base_dispatch(info->libevent_info.base);
 
 	/* cleanup */
+	oris_timers_finalize();
 	oris_configuration_finalize();
 	oris_interpreter_finalize();
 	oris_automation_finalize();
@@ -63,6 +85,9 @@ int oris_print_usage(oris_application_info_t* info)
 	printf("\t-c, --config=file\t - use given file to read configuration (use multiple times)\n");
 	printf("\t-d, --datafile=file\t - loads data from a CP file\n");
 	printf("\t-s, --storage=file\t - file to store received data (none by default)\n");
+	printf("\t-j, --journal\t - keep storage as snapshot plus append-only journal\n");
+	printf("\t-r, --capture=file\t - record the received data for data+replay connections\n");
+	printf("\t-F, --fsync=policy\t - sync written data to disk: none, snapshot (default), always\n");
 	printf("\t-z, --compress\t - use HTTP deflate content encoding\n");
 	printf("\t-V, --version\t - print version and exit\n");
 	printf("\t-h, --help   \t - print this help\n");
@@ -85,12 +110,15 @@ bool oris_handle_args(oris_application_info_t *info)
 		{ "config", required_argument, NULL, 'c' },
 		{ "cert", required_argument, NULL, 'C' },
 		{ "storage", required_argument, NULL, 's' },
+		{ "journal", no_argument, NULL, 'j' },
+		{ "fsync", required_argument, NULL, 'F' },
+		{ "capture", required_argument, NULL, 'r' },
 		{ "logfile", required_argument, NULL, 'L' },
 		{ "help", no_argument, NULL, 'h' },
 		{ NULL, 0, NULL, 0 }
 	};
 
-	const char* short_opt_str = "vVl:d:c:C:s:zL:h?";
+	const char* short_opt_str = "vVl:d:c:C:s:jF:r:zL:h?";
 
 	opt_code = getopt_long(info->argc, info->argv, short_opt_str, long_opts, &opt_idx);
 	while (opt_code != -1) {
@@ -134,6 +162,19 @@ bool oris_handle_args(oris_application_info_t *info)
 			case 's':
 				info->storage_fn = strdup(optarg);
 				break;
+			case 'j':
+				info->journal_storage = true;
+				break;
+			case 'F':
+				if (!oris_snapshot_parse_fsync_policy(optarg, &info->fsync_policy)) {
+					fprintf(stderr, "invalid fsync policy %s\n", optarg);
+					info->main = &oris_print_usage;
+					retval = true;
+				}
+				break;
+			case 'r':
+				info->capture_fn = strdup(optarg);
+				break;
 			case 'z':
 				info->compress_http = true;
 				break;
@@ -168,6 +209,7 @@ int main(int argc, char **argv)
 	info.argv = argv;
 	info.cert_fn = NULL;
 	info.storage_fn = NULL;
+	info.fsync_policy = ORIS_FSYNC_SNAPSHOT;
 
 	info.log_level = LOG_ERR;
 	oris_init_log(NULL, info.log_level);
@@ -0,0 +1,164 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "oris_util.h"
+#include "oris_histogram.h"
+
+#define HISTOGRAM_MAX_VALUE ((UINT64_C(1) << ORIS_HISTOGRAM_VALUE_BITS) - 1)
+
+void oris_histogram_init(oris_histogram_t* histogram)
+{
+	memset(histogram, 0, sizeof(*histogram));
+}
+
+static size_t oris_histogram_index(uint64_t value)
+{
+	int magnitude = ORIS_HISTOGRAM_SUB_BUCKET_BITS;
+	int shift;
+
+	if (value < ORIS_HISTOGRAM_SUB_BUCKETS) {
+		return (size_t) value;
+	}
+
+	while (value >> (magnitude + 1)) {
+		magnitude++;
+	}
+
+	/* the bits right below the leading one select the sub bucket */
+	shift = magnitude - ORIS_HISTOGRAM_SUB_BUCKET_BITS;
+
+	return (size_t) (shift + 1) * ORIS_HISTOGRAM_SUB_BUCKETS +
+		(size_t) (value >> shift) - ORIS_HISTOGRAM_SUB_BUCKETS;
+}
+
+/* the largest value counted in the bucket */
+static uint64_t oris_histogram_value(size_t index)
+{
+	int shift;
+	uint64_t sub;
+
+	if (index < ORIS_HISTOGRAM_SUB_BUCKETS) {
+		return (uint64_t) index;
+	}
+
+	shift = (int) (index / ORIS_HISTOGRAM_SUB_BUCKETS) - 1;
+	sub = (uint64_t) (index % ORIS_HISTOGRAM_SUB_BUCKETS) + ORIS_HISTOGRAM_SUB_BUCKETS;
+
+	return ((sub + 1) << shift) - 1;
+}
+
+void oris_histogram_record(oris_histogram_t* histogram, uint64_t value)
+{
+	if (value > HISTOGRAM_MAX_VALUE) {
+		value = HISTOGRAM_MAX_VALUE;
+	}
+
+	histogram->counts[oris_histogram_index(value)]++;
+	histogram->total++;
+	histogram->sum += value;
+	if (value > histogram->max) {
+		histogram->max = value;
+	}
+}
+
+uint64_t oris_histogram_percentile(const oris_histogram_t* histogram, double percentile)
+{
+	uint64_t rank, seen = 0;
+	size_t i;
+
+	if (histogram->total == 0) {
+		return 0;
+	}
+
+	rank = (uint64_t) (percentile / 100.0 * (double) histogram->total + 0.5);
+	rank = rank < 1 ? 1 : (rank > histogram->total ? histogram->total : rank);
+
+	for (i = 0; i < ORIS_HISTOGRAM_BUCKETS; i++) {
+		seen += histogram->counts[i];
+		if (seen >= rank) {
+			/* the bucket's bound may exceed anything actually recorded */
+			return oris_histogram_value(i) < histogram->max ?
+				oris_histogram_value(i) : histogram->max;
+		}
+	}
+
+	return histogram->max;
+}
+
+uint64_t oris_histogram_count_below(const oris_histogram_t* histogram, uint64_t value)
+{
+	uint64_t count = 0;
+	size_t i;
+
+	if (value >= histogram->max) {
+		return histogram->total;
+	}
+
+	for (i = 0; i < ORIS_HISTOGRAM_BUCKETS && oris_histogram_value(i) <= value; i++) {
+		count += histogram->counts[i];
+	}
+
+	return count;
+}
+
+void oris_histogram_set_init(oris_histogram_set_t* set)
+{
+	memset(set, 0, sizeof(*set));
+}
+
+void oris_histogram_set_finalize(oris_histogram_set_t* set)
+{
+	size_t i;
+
+	for (i = 0; i < set->count; i++) {
+		free(set->names[i]);
+		free(set->items[i]);
+	}
+
+	oris_free_and_null(set->names);
+	oris_free_and_null(set->items);
+	set->count = 0;
+}
+
+oris_histogram_t* oris_histogram_set_find(const oris_histogram_set_t* set, const char* name)
+{
+	size_t i;
+
+	for (i = 0; i < set->count; i++) {
+		if (strcmp(set->names[i], name) == 0) {
+			return set->items[i];
+		}
+	}
+
+	return NULL;
+}
+
+oris_histogram_t* oris_histogram_set_get(oris_histogram_set_t* set, const char* name)
+{
+	oris_histogram_t* histogram = oris_histogram_set_find(set, name);
+	char* copy;
+
+	if (histogram) {
+		return histogram;
+	}
+
+	if (!oris_safe_realloc((void**) &set->names, set->count + 1, sizeof(*set->names)) ||
+			!oris_safe_realloc((void**) &set->items, set->count + 1, sizeof(*set->items))) {
+		return NULL;
+	}
+
+	histogram = malloc(sizeof(*histogram));
+	copy = strdup(name);
+	if (!histogram || !copy) {
+		free(histogram);
+		free(copy);
+		return NULL;
+	}
+
+	oris_histogram_init(histogram);
+	set->names[set->count] = copy;
+	set->items[set->count] = histogram;
+	set->count++;
+
+	return histogram;
+}
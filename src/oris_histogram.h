@@ -0,0 +1,51 @@
+#ifndef __ORIS_HISTOGRAM_H
+#define __ORIS_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* values below 2^SUB_BUCKET_BITS are counted exactly, larger ones in
+ * 2^SUB_BUCKET_BITS linear sub buckets per power of two (about 3% error) */
+#define ORIS_HISTOGRAM_SUB_BUCKET_BITS 5
+#define ORIS_HISTOGRAM_SUB_BUCKETS (1 << ORIS_HISTOGRAM_SUB_BUCKET_BITS)
+/* larger values are counted as the largest one */
+#define ORIS_HISTOGRAM_VALUE_BITS 40
+#define ORIS_HISTOGRAM_BUCKETS \
+	((ORIS_HISTOGRAM_VALUE_BITS - ORIS_HISTOGRAM_SUB_BUCKET_BITS + 1) * ORIS_HISTOGRAM_SUB_BUCKETS)
+
+/* HDR style histogram of non-negative values, e.g. latencies in usec */
+typedef struct oris_histogram {
+	uint64_t counts[ORIS_HISTOGRAM_BUCKETS];
+	uint64_t total;
+	uint64_t sum;
+	uint64_t max;
+} oris_histogram_t;
+
+/* named histograms, the histograms stay at their address until finalized */
+typedef struct oris_histogram_set {
+	char** names;
+	oris_histogram_t** items;
+	size_t count;
+} oris_histogram_set_t;
+
+void oris_histogram_init(oris_histogram_t* histogram);
+void oris_histogram_record(oris_histogram_t* histogram, uint64_t value);
+
+/* the value percentile (0..100) percent of the recorded values are less or
+ * equal to, up to the precision of the buckets. 0 if nothing was recorded */
+uint64_t oris_histogram_percentile(const oris_histogram_t* histogram, double percentile);
+
+/* number of recorded values less or equal to value, up to the precision of
+ * the buckets */
+uint64_t oris_histogram_count_below(const oris_histogram_t* histogram, uint64_t value);
+
+void oris_histogram_set_init(oris_histogram_set_t* set);
+void oris_histogram_set_finalize(oris_histogram_set_t* set);
+
+/* the histogram for name, NULL if there is none */
+oris_histogram_t* oris_histogram_set_find(const oris_histogram_set_t* set, const char* name);
+
+/* the histogram for name, created if missing. NULL if out of memory */
+oris_histogram_t* oris_histogram_set_get(oris_histogram_set_t* set, const char* name);
+
+#endif /* __ORIS_HISTOGRAM_H */
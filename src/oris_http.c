@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 
@@ -10,20 +11,35 @@
 #include "oris_util.h"
 #include "oris_http.h"
 
-#include "zlib.h"
-
 #ifdef _MSC_VER
 #pragma warning( push )
 #pragma warning( disable: 4706 )
 #endif
 
-/* limit for deflate body compression */
-#define HTTP_DEFLATE_LIMIT 128
-
 static void http_request_done_cb(struct evhttp_request *req, void *ctx);
 static void http_connection_close(struct evhttp_connection *con, void *ctx);
-static bool http_compress_body(struct evbuffer *body);
 static const char* oris_get_http_method_string(const enum evhttp_cmd_type method);
+static void oris_http_send_queued(oris_http_target_t* target);
+static void oris_http_conn_release(oris_http_conn_t* conn);
+
+/* context of a request handed to a connection */
+typedef struct {
+	oris_http_conn_t* conn;
+	char* url;
+	oris_http_origin_t origin;
+	oris_http_ack_t* ack;
+} oris_http_request_ctx_t;
+
+static void oris_http_record_latency(oris_http_target_t* target,
+	const oris_http_origin_t* origin)
+{
+	uint64_t latency = oris_monotonic_usec() - origin->received;
+
+	oris_histogram_record(&target->latency, latency);
+	if (origin->latency) {
+		oris_histogram_record(origin->latency, latency);
+	}
+}
 
 /* taken from libevent https-client sample */
 static void http_request_done_cb(struct evhttp_request *req, void *ctx)
@@ -31,15 +47,46 @@ static void http_request_done_cb(struct evhttp_request *req, void *ctx)
 	int status, nread;
 	size_t length;
 	struct evbuffer* response;
-	oris_http_target_t* target = (oris_http_target_t*) ctx;
+	oris_http_request_ctx_t* request_ctx = (oris_http_request_ctx_t*) ctx;
+	oris_http_conn_t* conn = request_ctx->conn;
+	oris_http_target_t* target = conn->target;
 	char buffer[256];
+	bool success;
+
+	/* resume the TLS session on further connections of the pool */
+	if (req && conn->ssl && !target->ssl_session) {
+		target->ssl_session = SSL_get1_session(conn->ssl);
+	}
+
+	success = req && evhttp_request_get_response_code(req) / 100 == 2;
+	oris_http_cache_acked(&target->cache, request_ctx->url, success);
+	if (!success) {
+		target->errors++;
+		if (request_ctx->ack) {
+			request_ctx->ack->failed = true;
+		}
+	}
+	if (req && request_ctx->origin.received) {
+		oris_http_record_latency(target, &request_ctx->origin);
+	}
+	if (!req) {
+		/* the target's state is unknown after reconnecting */
+		oris_http_cache_clear(&target->cache);
+	}
+	oris_http_ack_unref(request_ctx->ack);
+	free(request_ctx->url);
+	free(request_ctx);
+
+	/* the slot is free again, whatever the outcome */
+	oris_http_conn_release(conn);
+	oris_http_send_queued(target);
 
 	if (req == NULL) {
 		bool printed_err = false;
 		int errcode = EVUTIL_SOCKET_ERROR();
 		unsigned long oslerr;
 
-		while ((oslerr = bufferevent_get_openssl_error(target->bev))) {
+		while (conn->bev && (oslerr = bufferevent_get_openssl_error(conn->bev))) {
 			ERR_error_string_n(oslerr, buffer, sizeof(buffer));
 			oris_log_f(LOG_ERR, "SSL error %s", buffer);
 			printed_err = true;
@@ -67,7 +114,7 @@ static void http_request_done_cb(struct evhttp_request *req, void *ctx)
 		evhttp_request_get_response_code_line(req),
 		length);
 
-	if (oris_get_log_level() == LOG_DEBUG) {
+	if (LOG_ENABLED(LOG_DEBUG)) {
 		while ((nread = evbuffer_remove(response, buffer, sizeof(buffer))) > 0) {
 			fwrite(buffer, nread, 1, stderr);
 		}
@@ -79,8 +126,8 @@ static void http_request_done_cb(struct evhttp_request *req, void *ctx)
 
 static void http_connection_close(struct evhttp_connection *con, void *ctx)
 {
-	oris_http_target_t* target = (oris_http_target_t*) ctx;
-	oris_log_f(LOG_DEBUG, "http connection %s closed", target->name);
+	oris_http_conn_t* conn = (oris_http_conn_t*) ctx;
+	oris_log_f(LOG_DEBUG, "http connection %s closed", conn->target->name);
 
 	(void) con; /* keep compiler happy */
 }
@@ -119,97 +166,329 @@ static const char* oris_get_http_method_string(const enum evhttp_cmd_type method
 	}
 }
 
-static bool http_compress_body(struct evbuffer *body)
+bool oris_http_target_init(oris_http_target_t* target)
 {
-	size_t body_size, compress_size;
-	unsigned char* body_data;
+	struct evkeyvalq params;
+	const char* query = evhttp_uri_get_query(target->uri);
+	const char* encoding;
 
-	/* add buffer space for compression */
-	body_size = evbuffer_get_length(body);
-	if (body_size < HTTP_DEFLATE_LIMIT) {
-		return false;
+	/* initializes params, also for an empty query */
+	if (evhttp_parse_query_str(query ? query : "", &params) != 0) {
+		oris_log_f(LOG_WARNING, "invalid parameters for target %s", target->name);
 	}
 
-	compress_size = compressBound(body_size);
-	if (evbuffer_expand(body, compress_size)) {
-		oris_log_f(LOG_ERR, "buffer expansion failed");
-		return false;
+	target->pool_size = oris_get_int_param(&params, "connections", 1,
+		ORIS_HTTP_MAX_CONNECTIONS);
+	target->max_inflight = oris_get_int_param(&params, "max_inflight",
+		target->pool_size, ORIS_HTTP_MAX_INFLIGHT);
+	target->idle_timeout = oris_get_int_param(&params, "idle",
+		ORIS_HTTP_DEFAULT_IDLE_TIMEOUT, 24 * 3600);
+	encoding = evhttp_find_header(&params, "encoding");
+	if (encoding && !oris_str_to_http_encoding(encoding, &target->encoding)) {
+		oris_log_f(LOG_WARNING, "unknown encoding %s for target %s", encoding, target->name);
+	}
+	evhttp_clear_headers(&params);
+
+	/* the parameters are not part of the request URLs */
+	evhttp_uri_set_query(target->uri, NULL);
+
+	oris_http_queue_init(&target->queue);
+	oris_http_cache_init(&target->cache);
+	oris_histogram_init(&target->latency);
+	target->in_flight = 0;
+	target->pool = calloc((size_t) target->pool_size, sizeof(*target->pool));
+
+	return target->pool != NULL;
+}
+
+static void oris_http_conn_close(oris_http_conn_t* conn)
+{
+	/* frees the bufferevent and with that the SSL object */
+	if (conn->connection) {
+		evhttp_connection_free(conn->connection);
+	}
+
+	conn->connection = NULL;
+	conn->bev = NULL;
+	conn->ssl = NULL;
+	conn->in_flight = 0;
+}
+
+void oris_http_target_finalize(oris_http_target_t* target)
+{
+	int i;
+
+	for (i = 0; target->pool && i < target->pool_size; i++) {
+		oris_http_conn_close(&target->pool[i]);
+		if (target->pool[i].idle_event) {
+			event_free(target->pool[i].idle_event);
+		}
+	}
+	oris_free_and_null(target->pool);
+
+	if (target->ssl_session) {
+		SSL_SESSION_free(target->ssl_session);
+		target->ssl_session = NULL;
+	}
+
+	oris_http_queue_clear(&target->queue);
+	oris_http_cache_finalize(&target->cache);
+}
+
+static void oris_http_idle_cb(evutil_socket_t fd, short what, void* arg)
+{
+	oris_http_conn_t* conn = (oris_http_conn_t*) arg;
+
+	(void) fd;
+	(void) what;
+
+	if (conn->in_flight == 0 && conn->connection) {
+		oris_log_f(LOG_DEBUG, "closing idle connection to %s", conn->target->name);
+		oris_http_conn_close(conn);
 	}
+}
 
-	/* make sure evbuffer is contignous */
-	body_data = evbuffer_pullup(body, -1);
-	if (!body_data) {
-		oris_log_f(LOG_ERR, "buffer pullup failed");
+static void oris_http_conn_release(oris_http_conn_t* conn)
+{
+	struct timeval timeout = { conn->target->idle_timeout, 0 };
+
+	conn->in_flight--;
+	conn->target->in_flight--;
+
+	if (conn->in_flight == 0 && conn->idle_event) {
+		event_add(conn->idle_event, &timeout);
+	}
+}
+
+static bool oris_http_conn_open(oris_http_target_t* target, oris_http_conn_t* conn)
+{
+	struct event_base* base = target->libevent_info->base;
+
+	conn->target = target;
+	if (!conn->idle_event) {
+		conn->idle_event = event_new(base, -1, 0, oris_http_idle_cb, conn);
+	}
+
+	/* TODO: plain http (no ssl) works fine, but when the https (!)
+	 * connection is closed by the server side we end up in "bad file descriptor"
+	 * messages.... so https is not working properbly ATM :-(
+	 * BUT: maybe http is also affected, as we close the buffereevent_Sockets when
+	 * a close comes in! */
+	if (!target->ssl_ctx) {
+		conn->ssl = NULL;
+		conn->bev = bufferevent_socket_new(base, -1, BEV_OPT_CLOSE_ON_FREE);
+	} else {
+		conn->ssl = SSL_new(target->ssl_ctx);
+		if (!conn->ssl) {
+			return false;
+		}
+		if (target->ssl_session) {
+			SSL_set_session(conn->ssl, target->ssl_session);
+		}
+		conn->bev = bufferevent_openssl_socket_new(base, -1, conn->ssl,
+			BUFFEREVENT_SSL_CONNECTING, BEV_OPT_CLOSE_ON_FREE
+			| BEV_OPT_DEFER_CALLBACKS);
+		if (!conn->bev) {
+			oris_log_f(LOG_ERR, "could not create SSL socket for %s", target->name);
+			SSL_free(conn->ssl);
+			conn->ssl = NULL;
+			return false;
+		}
+		bufferevent_openssl_set_allow_dirty_shutdown(conn->bev, 1);
+	}
+
+	if (!conn->bev) {
 		return false;
 	}
 
-	/* compress and discard uncompressed data */
-	if (compress(body_data + body_size, &compress_size, body_data, body_size) != Z_OK) {
-	oris_log_f(LOG_ERR, "could not compress http payload");
+	conn->connection = evhttp_connection_base_bufferevent_new(base,
+		target->libevent_info->dns_base, conn->bev, evhttp_uri_get_host(target->uri),
+		(unsigned short) evhttp_uri_get_port(target->uri));
+	if (!conn->connection) {
+		bufferevent_free(conn->bev);
+		conn->bev = NULL;
+		conn->ssl = NULL;
 		return false;
 	}
 
-	oris_log_f(LOG_DEBUG, "compressed HTTP body from %ld to %ld bytes (%d%% saving)",
-			body_size, compress_size, 100 - compress_size * 100 / body_size);
-	evbuffer_drain(body, body_size);
+	evhttp_connection_set_closecb(conn->connection, http_connection_close, conn);
 
 	return true;
 }
 
+/* the least loaded connection, a new one is opened while all are busy */
+static oris_http_conn_t* oris_http_get_conn(oris_http_target_t* target)
+{
+	oris_http_conn_t *conn, *best = NULL, *unused = NULL;
+	int i;
+
+	for (i = 0; i < target->pool_size; i++) {
+		conn = &target->pool[i];
+		if (!conn->connection) {
+			unused = unused ? unused : conn;
+		} else if (!best || conn->in_flight < best->in_flight) {
+			best = conn;
+		}
+	}
+
+	if ((!best || best->in_flight > 0) && unused && oris_http_conn_open(target, unused)) {
+		best = unused;
+	}
+
+	return best;
+}
 
 #define MAX_URL_SIZE 256
 
-void oris_perform_http_on_targets(oris_http_target_t* targets, int target_count,
-	const enum evhttp_cmd_type method, const char* uri, struct evbuffer* body)
+/* path is relative to the target's one like the uri of the requests */
+static void oris_http_invalidate_cached(oris_http_target_t* target, const char* path)
 {
 	char url_buf[MAX_URL_SIZE] = { 0 };
+
+	evutil_snprintf(url_buf, MAX_URL_SIZE - 1, "%s%s", evhttp_uri_get_path(target->uri),
+		path);
+	oris_http_cache_invalidate(&target->cache, url_buf);
+}
+
+static void oris_http_send(oris_http_conn_t* conn, oris_http_queue_entry_t* entry)
+{
+	oris_http_target_t* target = conn->target;
 	struct evhttp_request *request;
 	struct evkeyvalq *output_headers;
-	struct evbuffer* output_buffer;
+	struct evbuffer* body;
+	oris_http_encoding_t encoding = target->encoding;
+	oris_http_request_ctx_t* request_ctx = malloc(sizeof(*request_ctx));
+
+	request = request_ctx ? evhttp_request_new(http_request_done_cb, request_ctx) : NULL;
+	if (!request) {
+		oris_log_f(LOG_ERR, "could not send request %s to target %s. target's state may be undefined!",
+				entry->url, target->name);
+		oris_http_payload_failed(entry->payload);
+		free(request_ctx);
+		return;
+	}
+
+	output_headers = evhttp_request_get_output_headers(request);
+	evhttp_add_header(output_headers, "Host", evhttp_uri_get_host(target->uri));
+	evhttp_add_header(output_headers, "User-Agent", ORIS_USER_AGENT);
+	evhttp_add_header(output_headers, "Accept", "application/json, text/plain");
+	evhttp_add_header(output_headers, "Accept-Charset", "utf-8");
+	if (oris_http_payload_length(entry->payload) > 0) {
+		evhttp_add_header(output_headers, "Content-Type", "application/json");
+	}
+	if (target->auth_header_value != NULL) {
+		evhttp_add_header(output_headers, "Authorization", target->auth_header_value);
+	}
+
+	if (entry->method == EVHTTP_REQ_PUT || entry->method == EVHTTP_REQ_POST) {
+		body = oris_http_payload_get(entry->payload, &encoding);
+		if (encoding != ORIS_HTTP_ENCODING_IDENTITY) {
+			evhttp_add_header(output_headers, "Content-Encoding",
+				oris_http_encoding_name(encoding));
+		}
+		evbuffer_add_buffer_reference(evhttp_request_get_output_buffer(request), body);
+	}
+
+	oris_log_f(LOG_DEBUG, "sending request %s to '%s'", entry->url, target->name);
+	if (conn->idle_event) {
+		event_del(conn->idle_event);
+	}
+	conn->in_flight++;
+	target->in_flight++;
+	target->requests++;
+	oris_http_cache_sent(&target->cache, entry->method, entry->url, entry->payload->hash);
+	if (entry->payload->stale_url) {
+		oris_http_invalidate_cached(target, entry->payload->stale_url);
+	}
+
+	/* the url is kept for the response */
+	request_ctx->conn = conn;
+	request_ctx->url = entry->url;
+	request_ctx->origin = entry->payload->origin;
+	request_ctx->ack = entry->payload->ack ? oris_http_ack_ref(entry->payload->ack) : NULL;
+	entry->url = NULL;
+	if (evhttp_make_request(conn->connection, request, entry->method, request_ctx->url) != 0) {
+		/* the request is freed by libevent without calling back */
+		oris_http_cache_acked(&target->cache, request_ctx->url, false);
+		oris_http_payload_failed(entry->payload);
+		oris_http_conn_release(conn);
+		target->errors++;
+		oris_http_ack_unref(request_ctx->ack);
+		free(request_ctx->url);
+		free(request_ctx);
+		oris_log_f(LOG_ERR, "error making http request");
+	}
+}
+
+static void oris_http_send_queued(oris_http_target_t* target)
+{
+	oris_http_queue_entry_t* entry;
+	oris_http_conn_t* conn;
+
+	while (target->in_flight < target->max_inflight && target->queue.first) {
+		entry = target->queue.first;
+		if (oris_http_cache_lookup(&target->cache, entry->method, entry->url,
+				entry->payload->hash)) {
+			oris_log_f(LOG_DEBUG, "skipping unchanged %s for '%s'", entry->url, target->name);
+			oris_http_queue_entry_free(oris_http_queue_pop(&target->queue));
+			continue;
+		}
+
+		conn = oris_http_get_conn(target);
+		if (!conn) {
+			oris_log_f(LOG_ERR, "no connection to target %s", target->name);
+			return;
+		}
+
+		entry = oris_http_queue_pop(&target->queue);
+		oris_http_send(conn, entry);
+		oris_http_queue_entry_free(entry);
+	}
+}
+
+void oris_perform_http_on_targets(oris_http_target_t* targets, int target_count,
+	const enum evhttp_cmd_type method, const char* uri, struct evbuffer* body,
+	const oris_http_origin_t* origin)
+{
+	oris_http_payload_t* payload;
+
+	/* shared by all targets, encoded once per content encoding */
+	payload = oris_http_payload_new(body);
+	if (!payload) {
+		oris_log_f(LOG_ERR, "could not allocate http payload");
+		return;
+	}
+	if (origin) {
+		payload->origin = *origin;
+	}
+
+	oris_perform_http_payload_on_targets(targets, target_count, method, uri, payload);
+	oris_http_payload_unref(payload);
+}
+
+void oris_perform_http_payload_on_targets(oris_http_target_t* targets, int target_count,
+	const enum evhttp_cmd_type method, const char* uri, oris_http_payload_t* payload)
+{
+	char url_buf[MAX_URL_SIZE] = { 0 };
 	int i;
 
 	oris_log_f(LOG_INFO, "http %s %s (%lu bytes body) ", oris_get_http_method_string(method),
-			uri, evbuffer_get_length(body));
+			uri, (unsigned long) oris_http_payload_length(payload));
 
 	for (i = 0; i < target_count; i++) {
 		if (!targets[i].enabled) {
+			/* misses the request, a publisher has to start over */
+			oris_http_payload_failed(payload);
 			continue;
 		}
 
-		request = evhttp_request_new(http_request_done_cb, &targets[i]);
-		if (request) {
-			/* todo: place this at a better position */
-			evhttp_connection_set_closecb(targets[i].connection, http_connection_close, targets + i);
-
-			output_headers = evhttp_request_get_output_headers(request);
-			evhttp_add_header(output_headers, "Host", evhttp_uri_get_host(targets[i].uri));
-			evhttp_add_header(output_headers, "User-Agent", ORIS_USER_AGENT);
-			evhttp_add_header(output_headers, "Accept", "application/json, text/plain");
-			evhttp_add_header(output_headers, "Accept-Charset", "utf-8");
-			if (evbuffer_get_length(body) > 0) {
-				evhttp_add_header(output_headers, "Content-Type", "application/json");
-			}
-			if (targets[i].auth_header_value != NULL) {
-				evhttp_add_header(output_headers, "Authorization", targets[i].auth_header_value);
-			}
-			evutil_snprintf(url_buf, MAX_URL_SIZE - 1, "%s%s", evhttp_uri_get_path(
-					targets[i].uri), uri);
-
-			if (method == EVHTTP_REQ_PUT || method == EVHTTP_REQ_POST) {
-				if (targets[i].compress && http_compress_body(body)) {
-					evhttp_add_header(output_headers, "Content-Encoding", "deflate");
-				}
-				output_buffer = evhttp_request_get_output_buffer(request);
-				evbuffer_add_buffer_reference(output_buffer, body);
-			}
-
-			oris_log_f(LOG_DEBUG, "sending request %s to '%s'", url_buf, targets[i].name);
-			if (evhttp_make_request(targets[i].connection, request, method, url_buf) != 0) {
-				oris_log_f(LOG_ERR, "error making http request");
-			}
+		evutil_snprintf(url_buf, MAX_URL_SIZE - 1, "%s%s", evhttp_uri_get_path(
+				targets[i].uri), uri);
+
+		if (oris_http_queue_push(&targets[i].queue, method, url_buf, payload)) {
+			oris_http_send_queued(&targets[i]);
 		} else {
-			oris_log_f(LOG_ERR, "could not send request %s to target %s. target's state may be undefined!", uri,
-					targets[i].name);
+			oris_http_payload_failed(payload);
 		}
 	}
 }
@@ -9,20 +9,67 @@
 #include <event2/http.h>
 #include <openssl/ssl.h>
 
+#include "oris_http_queue.h"
+#include "oris_http_cache.h"
+
+/* limits and defaults of the target URI parameters */
+#define ORIS_HTTP_MAX_CONNECTIONS 16
+#define ORIS_HTTP_MAX_INFLIGHT 64
+#define ORIS_HTTP_DEFAULT_IDLE_TIMEOUT 60
+
+struct oris_http_target;
+
+/* a pooled connection, created when needed and closed after being idle */
+typedef struct oris_http_conn {
+	struct oris_http_target* target;
+	struct evhttp_connection* connection;
+	struct bufferevent* bev;
+	SSL* ssl;
+	struct event* idle_event;
+	int in_flight;
+} oris_http_conn_t;
+
 typedef struct oris_http_target {
 	char* name;
 	struct evhttp_uri* uri;
-	struct evhttp_connection* connection;
 	oris_libevent_base_info_t* libevent_info;
-	struct bufferevent* bev;
-	SSL* ssl;
+	/* NULL for plain http */
+	SSL_CTX* ssl_ctx;
+	SSL_SESSION* ssl_session;
 	bool enabled;
 	char* auth_header_value;
-	bool compress;
+	/* content encoding of request bodies */
+	oris_http_encoding_t encoding;
+	/* connections=, max_inflight=, idle= and encoding= parameters of the target URI */
+	oris_http_conn_t* pool;
+	int pool_size;
+	int max_inflight;
+	int idle_timeout;
+	/* requests waiting for a connection and number of unanswered ones */
+	oris_http_queue_t queue;
+	int in_flight;
+	/* requests equal to the last acknowledged one for a URL are skipped */
+	oris_http_cache_t cache;
+	/* requests handed to a connection and those failed or not answered with 2xx */
+	unsigned long requests;
+	unsigned long errors;
+	/* time from receiving a feed line to the response of its requests */
+	oris_histogram_t latency;
 } oris_http_target_t;
 
+/* take the pool parameters from the query of the target's URI */
+bool oris_http_target_init(oris_http_target_t* target);
+void oris_http_target_finalize(oris_http_target_t* target);
+
+/* queue the request for all enabled targets and send as many as possible.
+ * origin may be NULL if the request is not caused by the feed */
 void oris_perform_http_on_targets(oris_http_target_t* targets, int target_count,
-	const enum evhttp_cmd_type method, const char* uri, struct evbuffer* body);
+	const enum evhttp_cmd_type method, const char* uri, struct evbuffer* body,
+	const oris_http_origin_t* origin);
+
+/* same with a payload prepared by the caller, which keeps its reference */
+void oris_perform_http_payload_on_targets(oris_http_target_t* targets, int target_count,
+	const enum evhttp_cmd_type method, const char* uri, oris_http_payload_t* payload);
 
 bool oris_str_to_http_method(const char* str, enum evhttp_cmd_type* method);
 
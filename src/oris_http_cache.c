@@ -0,0 +1,181 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "oris_log.h"
+#include "oris_util.h"
+#include "oris_http_cache.h"
+
+#define HTTP_CACHE_INITIAL_SIZE 64
+
+static bool oris_http_cache_is_idempotent(enum evhttp_cmd_type method)
+{
+	return method == EVHTTP_REQ_PUT || method == EVHTTP_REQ_DELETE;
+}
+
+void oris_http_cache_init(oris_http_cache_t* cache)
+{
+	memset(cache, 0, sizeof(*cache));
+}
+
+void oris_http_cache_clear(oris_http_cache_t* cache)
+{
+	size_t i;
+
+	for (i = 0; i < cache->size; i++) {
+		oris_free_and_null(cache->slots[i].url);
+	}
+
+	if (cache->slots) {
+		memset(cache->slots, 0, cache->size * sizeof(*cache->slots));
+	}
+	cache->count = 0;
+}
+
+void oris_http_cache_finalize(oris_http_cache_t* cache)
+{
+	oris_http_cache_clear(cache);
+	oris_free_and_null(cache->slots);
+	cache->size = 0;
+}
+
+static oris_http_cache_entry_t* oris_http_cache_slot(oris_http_cache_entry_t* slots,
+	size_t size, const char* url)
+{
+	size_t i = (size_t) oris_hash64(url, strlen(url)) & (size - 1);
+
+	while (slots[i].url && strcmp(slots[i].url, url) != 0) {
+		i = (i + 1) & (size - 1);
+	}
+
+	return &slots[i];
+}
+
+static bool oris_http_cache_grow(oris_http_cache_t* cache)
+{
+	oris_http_cache_entry_t* slots;
+	size_t i, size = cache->size > 0 ? cache->size * 2 : HTTP_CACHE_INITIAL_SIZE;
+
+	slots = calloc(size, sizeof(*slots));
+	if (!slots) {
+		return false;
+	}
+
+	for (i = 0; i < cache->size; i++) {
+		if (cache->slots[i].url) {
+			*oris_http_cache_slot(slots, size, cache->slots[i].url) = cache->slots[i];
+		}
+	}
+
+	free(cache->slots);
+	cache->slots = slots;
+	cache->size = size;
+
+	return true;
+}
+
+static oris_http_cache_entry_t* oris_http_cache_find(oris_http_cache_t* cache,
+	const char* url)
+{
+	oris_http_cache_entry_t* entry;
+
+	if (cache->count == 0) {
+		return NULL;
+	}
+
+	entry = oris_http_cache_slot(cache->slots, cache->size, url);
+
+	return entry->url ? entry : NULL;
+}
+
+static oris_http_cache_entry_t* oris_http_cache_insert(oris_http_cache_t* cache,
+	const char* url)
+{
+	oris_http_cache_entry_t* entry = oris_http_cache_find(cache, url);
+
+	if (entry) {
+		return entry;
+	}
+
+	if (cache->count >= ORIS_HTTP_CACHE_LIMIT) {
+		oris_log_f(LOG_DEBUG, "publish cache full, clearing it");
+		oris_http_cache_clear(cache);
+	}
+
+	if ((cache->count + 1) * 4 > cache->size * 3 && !oris_http_cache_grow(cache)) {
+		return NULL;
+	}
+
+	entry = oris_http_cache_slot(cache->slots, cache->size, url);
+	entry->url = strdup(url);
+	if (!entry->url) {
+		return NULL;
+	}
+	cache->count++;
+
+	return entry;
+}
+
+bool oris_http_cache_lookup(oris_http_cache_t* cache, enum evhttp_cmd_type method,
+	const char* url, uint64_t hash)
+{
+	oris_http_cache_entry_t* entry;
+
+	if (!oris_http_cache_is_idempotent(method)) {
+		return false;
+	}
+
+	entry = oris_http_cache_find(cache, url);
+	if (entry && entry->valid && entry->method == method && entry->hash == hash) {
+		cache->hits++;
+		return true;
+	}
+
+	cache->misses++;
+
+	return false;
+}
+
+void oris_http_cache_invalidate(oris_http_cache_t* cache, const char* url)
+{
+	oris_http_cache_entry_t* entry = oris_http_cache_find(cache, url);
+
+	if (entry) {
+		entry->valid = false;
+		entry->failed = entry->pending > 0;
+	}
+}
+
+void oris_http_cache_sent(oris_http_cache_t* cache, enum evhttp_cmd_type method,
+	const char* url, uint64_t hash)
+{
+	oris_http_cache_entry_t* entry;
+
+	if (method == EVHTTP_REQ_GET) {
+		return;
+	}
+
+	entry = oris_http_cache_insert(cache, url);
+	if (entry) {
+		entry->method = method;
+		entry->hash = hash;
+		entry->pending++;
+		entry->valid = false;
+	}
+}
+
+void oris_http_cache_acked(oris_http_cache_t* cache, const char* url, bool success)
+{
+	oris_http_cache_entry_t* entry = oris_http_cache_find(cache, url);
+
+	if (!entry || entry->pending == 0) {
+		return;
+	}
+
+	entry->failed = entry->failed || !success;
+
+	/* with several requests in flight the outcome is only known after the last */
+	if (--entry->pending == 0) {
+		entry->valid = !entry->failed && oris_http_cache_is_idempotent(entry->method);
+		entry->failed = false;
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef __ORIS_HTTP_CACHE_H
+#define __ORIS_HTTP_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <event2/http.h>
+
+/* maximum number of URLs kept, the cache is cleared when exceeded */
+#define ORIS_HTTP_CACHE_LIMIT 4096
+
+/* the last request sent to a URL and whether it has been acknowledged. Only
+ * acknowledged PUT and DELETE requests are considered to be published. */
+typedef struct {
+	char* url;
+	enum evhttp_cmd_type method;
+	uint64_t hash;
+	int pending;
+	bool failed;
+	bool valid;
+} oris_http_cache_entry_t;
+
+/* publish cache of a target: open addressing over the URLs */
+typedef struct oris_http_cache {
+	oris_http_cache_entry_t* slots;
+	size_t size;
+	size_t count;
+	unsigned long hits;
+	unsigned long misses;
+} oris_http_cache_t;
+
+void oris_http_cache_init(oris_http_cache_t* cache);
+void oris_http_cache_finalize(oris_http_cache_t* cache);
+
+/* forget all URLs (e.g. when the target's state is unknown), keeps counters */
+void oris_http_cache_clear(oris_http_cache_t* cache);
+
+/* true if the request equals the last acknowledged one for url */
+bool oris_http_cache_lookup(oris_http_cache_t* cache, enum evhttp_cmd_type method,
+	const char* url, uint64_t hash);
+
+/* the body last acknowledged for url is not known to be published anymore,
+ * including that of requests still in flight */
+void oris_http_cache_invalidate(oris_http_cache_t* cache, const char* url);
+
+/* record a request handed to the connection and its response */
+void oris_http_cache_sent(oris_http_cache_t* cache, enum evhttp_cmd_type method,
+	const char* url, uint64_t hash);
+void oris_http_cache_acked(oris_http_cache_t* cache, const char* url, bool success);
+
+#endif /* __ORIS_HTTP_CACHE_H */
@@ -0,0 +1,241 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "oris_log.h"
+#include "oris_util.h"
+#include "oris_http_payload.h"
+
+#include "zlib.h"
+
+/* limit for body compression */
+#define HTTP_DEFLATE_LIMIT 128
+
+/* deflate streams, reset for every body */
+static z_stream streams[ORIS_HTTP_ENCODING_COUNT];
+static bool stream_ready[ORIS_HTTP_ENCODING_COUNT];
+
+static oris_http_encoding_stats_t stats;
+
+static const char* encoding_names[ORIS_HTTP_ENCODING_COUNT] = {
+	"identity", "deflate", "gzip"
+};
+
+oris_http_payload_t* oris_http_payload_new(struct evbuffer* body)
+{
+	oris_http_payload_t* payload = calloc(1, sizeof(*payload));
+	size_t length = body ? evbuffer_get_length(body) : 0;
+
+	if (!payload) {
+		return NULL;
+	}
+
+	payload->refcount = 1;
+	payload->tried[ORIS_HTTP_ENCODING_IDENTITY] = true;
+	payload->variants[ORIS_HTTP_ENCODING_IDENTITY] = evbuffer_new();
+	if (!payload->variants[ORIS_HTTP_ENCODING_IDENTITY] || (length > 0 &&
+			evbuffer_add(payload->variants[ORIS_HTTP_ENCODING_IDENTITY],
+				evbuffer_pullup(body, -1), length) != 0)) {
+		oris_http_payload_unref(payload);
+		return NULL;
+	}
+
+	payload->hash = oris_hash64(evbuffer_pullup(payload->variants[ORIS_HTTP_ENCODING_IDENTITY], -1),
+		length);
+
+	return payload;
+}
+
+oris_http_payload_t* oris_http_payload_ref(oris_http_payload_t* payload)
+{
+	payload->refcount++;
+
+	return payload;
+}
+
+void oris_http_payload_unref(oris_http_payload_t* payload)
+{
+	int i;
+
+	if (!payload || --payload->refcount > 0) {
+		return;
+	}
+
+	for (i = 0; i < ORIS_HTTP_ENCODING_COUNT; i++) {
+		if (payload->variants[i]) {
+			evbuffer_free(payload->variants[i]);
+		}
+	}
+
+	oris_http_ack_unref(payload->ack);
+	free(payload->stale_url);
+	free(payload);
+}
+
+void oris_http_payload_failed(oris_http_payload_t* payload)
+{
+	if (payload->ack) {
+		payload->ack->failed = true;
+	}
+}
+
+oris_http_ack_t* oris_http_ack_new(void)
+{
+	oris_http_ack_t* ack = calloc(1, sizeof(*ack));
+
+	if (ack) {
+		ack->refcount = 1;
+	}
+
+	return ack;
+}
+
+oris_http_ack_t* oris_http_ack_ref(oris_http_ack_t* ack)
+{
+	ack->refcount++;
+
+	return ack;
+}
+
+void oris_http_ack_unref(oris_http_ack_t* ack)
+{
+	if (ack && --ack->refcount == 0) {
+		free(ack);
+	}
+}
+
+size_t oris_http_payload_length(const oris_http_payload_t* payload)
+{
+	return evbuffer_get_length(payload->variants[ORIS_HTTP_ENCODING_IDENTITY]);
+}
+
+static z_stream* oris_http_get_stream(oris_http_encoding_t encoding)
+{
+	z_stream* strm = &streams[encoding];
+
+	if (stream_ready[encoding]) {
+		return deflateReset(strm) == Z_OK ? strm : NULL;
+	}
+
+	/* window bits + 16 selects the gzip wrapper */
+	memset(strm, 0, sizeof(*strm));
+	if (deflateInit2(strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			encoding == ORIS_HTTP_ENCODING_GZIP ? 15 + 16 : 15, 8,
+			Z_DEFAULT_STRATEGY) != Z_OK) {
+		oris_log_f(LOG_ERR, "could not init %s compression", encoding_names[encoding]);
+		return NULL;
+	}
+
+	stream_ready[encoding] = true;
+
+	return strm;
+}
+
+static struct evbuffer* oris_http_payload_encode(struct evbuffer* identity,
+	oris_http_encoding_t encoding)
+{
+	struct evbuffer* out;
+	struct evbuffer_iovec vec;
+	size_t size = evbuffer_get_length(identity);
+	uint64_t start = oris_monotonic_usec();
+	z_stream* strm = oris_http_get_stream(encoding);
+
+	if (!strm) {
+		return NULL;
+	}
+
+	out = evbuffer_new();
+	if (!out || evbuffer_reserve_space(out, (ev_ssize_t) deflateBound(strm, (uLong) size),
+			&vec, 1) < 1) {
+		oris_log_f(LOG_ERR, "buffer expansion failed");
+		if (out) {
+			evbuffer_free(out);
+		}
+		return NULL;
+	}
+
+	strm->next_in = evbuffer_pullup(identity, -1);
+	strm->avail_in = (uInt) size;
+	strm->next_out = vec.iov_base;
+	strm->avail_out = (uInt) vec.iov_len;
+	if (deflate(strm, Z_FINISH) != Z_STREAM_END) {
+		oris_log_f(LOG_ERR, "could not compress http payload");
+		evbuffer_free(out);
+		return NULL;
+	}
+
+	vec.iov_len = strm->total_out;
+	evbuffer_commit_space(out, &vec, 1);
+
+	stats.encoded++;
+	stats.bytes_in += size;
+	stats.bytes_out += strm->total_out;
+	stats.usec += oris_monotonic_usec() - start;
+
+	oris_log_f(LOG_DEBUG, "%s encoded HTTP body from %lu to %lu bytes (%d%% saving)",
+		encoding_names[encoding], (unsigned long) size, (unsigned long) strm->total_out,
+		(int) (100 - strm->total_out * 100 / size));
+
+	return out;
+}
+
+struct evbuffer* oris_http_payload_get(oris_http_payload_t* payload,
+	oris_http_encoding_t* encoding)
+{
+	struct evbuffer* identity = payload->variants[ORIS_HTTP_ENCODING_IDENTITY];
+
+	if (*encoding == ORIS_HTTP_ENCODING_IDENTITY ||
+			evbuffer_get_length(identity) < HTTP_DEFLATE_LIMIT) {
+		*encoding = ORIS_HTTP_ENCODING_IDENTITY;
+		return identity;
+	}
+
+	if (payload->variants[*encoding]) {
+		stats.reused++;
+	} else if (!payload->tried[*encoding]) {
+		payload->tried[*encoding] = true;
+		payload->variants[*encoding] = oris_http_payload_encode(identity, *encoding);
+	}
+
+	if (!payload->variants[*encoding]) {
+		*encoding = ORIS_HTTP_ENCODING_IDENTITY;
+		return identity;
+	}
+
+	return payload->variants[*encoding];
+}
+
+bool oris_str_to_http_encoding(const char* str, oris_http_encoding_t* encoding)
+{
+	int i;
+
+	for (i = 0; i < ORIS_HTTP_ENCODING_COUNT; i++) {
+		if (strcasecmp(str, encoding_names[i]) == 0) {
+			*encoding = (oris_http_encoding_t) i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const char* oris_http_encoding_name(oris_http_encoding_t encoding)
+{
+	return encoding < ORIS_HTTP_ENCODING_COUNT ? encoding_names[encoding] : "?";
+}
+
+const oris_http_encoding_stats_t* oris_http_encoding_get_stats(void)
+{
+	return &stats;
+}
+
+void oris_http_payload_finalize(void)
+{
+	int i;
+
+	for (i = 0; i < ORIS_HTTP_ENCODING_COUNT; i++) {
+		if (stream_ready[i]) {
+			deflateEnd(&streams[i]);
+			stream_ready[i] = false;
+		}
+	}
+}
@@ -0,0 +1,88 @@
+#ifndef __ORIS_HTTP_PAYLOAD_H
+#define __ORIS_HTTP_PAYLOAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <event2/buffer.h>
+
+#include "oris_histogram.h"
+
+typedef enum {
+	ORIS_HTTP_ENCODING_IDENTITY,
+	ORIS_HTTP_ENCODING_DEFLATE,
+	ORIS_HTTP_ENCODING_GZIP,
+	ORIS_HTTP_ENCODING_COUNT
+} oris_http_encoding_t;
+
+/* the feed line a request results from: when it was received (monotonic
+ * usec, 0 if the request was not caused by the feed) and the latency
+ * histogram of its table */
+typedef struct {
+	uint64_t received;
+	oris_histogram_t* latency;
+} oris_http_origin_t;
+
+/* outcome of the requests of a publisher, shared by their payloads: failed
+ * is set when one of them is dropped, fails or is not answered with 2xx */
+typedef struct oris_http_ack {
+	int refcount;
+	bool failed;
+} oris_http_ack_t;
+
+/* body of an outgoing request shared by all targets. Each content encoding
+ * is built at most once, when the first target asks for it. */
+typedef struct oris_http_payload {
+	int refcount;
+	/* hash of the identity encoded body */
+	uint64_t hash;
+	struct evbuffer* variants[ORIS_HTTP_ENCODING_COUNT];
+	bool tried[ORIS_HTTP_ENCODING_COUNT];
+	/* replaced together with the body when requests are coalesced */
+	oris_http_origin_t origin;
+	/* set for publishers whose requests depend on each other (table deltas):
+	 * they are never coalesced, failures are reported to ack and once sent,
+	 * the body last acknowledged for stale_url (relative to the target's
+	 * path) is not known to be published anymore */
+	oris_http_ack_t* ack;
+	char* stale_url;
+} oris_http_payload_t;
+
+typedef struct {
+	unsigned long encoded;
+	/* variants taken from the cache instead of being encoded again */
+	unsigned long reused;
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+	uint64_t usec;
+} oris_http_encoding_stats_t;
+
+/* copy body into a new payload with a reference count of one */
+oris_http_payload_t* oris_http_payload_new(struct evbuffer* body);
+oris_http_payload_t* oris_http_payload_ref(oris_http_payload_t* payload);
+void oris_http_payload_unref(oris_http_payload_t* payload);
+
+size_t oris_http_payload_length(const oris_http_payload_t* payload);
+
+/* a request with the payload was dropped or failed */
+void oris_http_payload_failed(oris_http_payload_t* payload);
+
+oris_http_ack_t* oris_http_ack_new(void);
+oris_http_ack_t* oris_http_ack_ref(oris_http_ack_t* ack);
+void oris_http_ack_unref(oris_http_ack_t* ack);
+
+/* the body in the given encoding. Small bodies and failed encodings fall back
+ * to identity, encoding is updated accordingly. The buffer must not be
+ * modified, use evbuffer_add_buffer_reference. */
+struct evbuffer* oris_http_payload_get(oris_http_payload_t* payload,
+	oris_http_encoding_t* encoding);
+
+bool oris_str_to_http_encoding(const char* str, oris_http_encoding_t* encoding);
+const char* oris_http_encoding_name(oris_http_encoding_t encoding);
+
+const oris_http_encoding_stats_t* oris_http_encoding_get_stats(void);
+
+/* release the compression streams */
+void oris_http_payload_finalize(void);
+
+#endif /* __ORIS_HTTP_PAYLOAD_H */
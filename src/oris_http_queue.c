@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "oris_util.h"
+#include "oris_log.h"
+#include "oris_http_queue.h"
+
+void oris_http_queue_init(oris_http_queue_t* queue)
+{
+	memset(queue, 0, sizeof(*queue));
+}
+
+void oris_http_queue_clear(oris_http_queue_t* queue)
+{
+	oris_http_queue_entry_t* entry;
+
+	while ((entry = oris_http_queue_pop(queue))) {
+		oris_http_queue_entry_free(entry);
+	}
+
+	oris_free_and_null(queue->index);
+}
+
+/* slot of the last request queued for url, or the empty slot to put it in */
+static size_t oris_http_queue_slot(oris_http_queue_t* queue, uint64_t hash,
+	const char* url)
+{
+	size_t i = (size_t) hash & (ORIS_HTTP_QUEUE_INDEX_SIZE - 1);
+
+	while (queue->index[i] && (queue->index[i]->hash != hash ||
+			strcmp(queue->index[i]->url, url) != 0)) {
+		i = (i + 1) & (ORIS_HTTP_QUEUE_INDEX_SIZE - 1);
+	}
+
+	return i;
+}
+
+/* empty slot i, following entries are moved up so probing stays intact */
+static void oris_http_queue_unindex(oris_http_queue_t* queue, size_t i)
+{
+	const size_t mask = ORIS_HTTP_QUEUE_INDEX_SIZE - 1;
+	size_t j = i, home;
+
+	for (;;) {
+		j = (j + 1) & mask;
+		if (!queue->index[j]) {
+			break;
+		}
+
+		/* entries whose home slot lies cyclically in (i, j] stay */
+		home = (size_t) queue->index[j]->hash & mask;
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			queue->index[i] = queue->index[j];
+			i = j;
+		}
+	}
+
+	queue->index[i] = NULL;
+}
+
+bool oris_http_queue_push(oris_http_queue_t* queue, enum evhttp_cmd_type method,
+	const char* url, oris_http_payload_t* payload)
+{
+	oris_http_queue_entry_t *entry, *latest;
+	uint64_t hash;
+	size_t slot;
+
+	if (!queue->index) {
+		queue->index = calloc(ORIS_HTTP_QUEUE_INDEX_SIZE, sizeof(*queue->index));
+		if (!queue->index) {
+			return false;
+		}
+	}
+
+	hash = oris_hash64(url, strlen(url));
+	slot = oris_http_queue_slot(queue, hash, url);
+	latest = queue->index[slot];
+
+	if (method == EVHTTP_REQ_PUT || method == EVHTTP_REQ_DELETE) {
+		if (latest && latest->method == method && !latest->payload->ack &&
+				!payload->ack) {
+			queue->coalesced++;
+			oris_http_payload_unref(latest->payload);
+			latest->payload = oris_http_payload_ref(payload);
+			return true;
+		}
+	}
+
+	if (queue->count >= ORIS_HTTP_QUEUE_LIMIT) {
+		queue->dropped++;
+		oris_log_f(LOG_WARNING, "http queue full, dropping request for %s", url);
+		return false;
+	}
+
+	entry = calloc(1, sizeof(*entry));
+	if (!entry) {
+		return false;
+	}
+
+	entry->method = method;
+	entry->hash = hash;
+	entry->url = strdup(url);
+	if (!entry->url) {
+		free(entry);
+		return false;
+	}
+	entry->payload = oris_http_payload_ref(payload);
+
+	if (queue->last) {
+		queue->last->next = entry;
+	} else {
+		queue->first = entry;
+	}
+	queue->last = entry;
+	queue->count++;
+	queue->index[slot] = entry;
+
+	return true;
+}
+
+oris_http_queue_entry_t* oris_http_queue_pop(oris_http_queue_t* queue)
+{
+	oris_http_queue_entry_t* entry = queue->first;
+
+	size_t slot;
+
+	if (entry) {
+		/* still indexed unless a later request for the URL was queued */
+		slot = oris_http_queue_slot(queue, entry->hash, entry->url);
+		if (queue->index[slot] == entry) {
+			oris_http_queue_unindex(queue, slot);
+		}
+
+		queue->first = entry->next;
+		if (!queue->first) {
+			queue->last = NULL;
+		}
+		queue->count--;
+		entry->next = NULL;
+	}
+
+	return entry;
+}
+
+void oris_http_queue_entry_free(oris_http_queue_entry_t* entry)
+{
+	if (entry) {
+		oris_http_payload_unref(entry->payload);
+		free(entry->url);
+		free(entry);
+	}
+}
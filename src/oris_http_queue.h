@@ -0,0 +1,54 @@
+#ifndef __ORIS_HTTP_QUEUE_H
+#define __ORIS_HTTP_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <event2/http.h>
+
+#include "oris_http_payload.h"
+
+/* maximum number of requests waiting for a target */
+#define ORIS_HTTP_QUEUE_LIMIT 1024
+
+/* slots of the URL index, at most half of them are used */
+#define ORIS_HTTP_QUEUE_INDEX_SIZE (2 * ORIS_HTTP_QUEUE_LIMIT)
+
+/* a request that has not been handed to the connection yet */
+typedef struct oris_http_queue_entry {
+	enum evhttp_cmd_type method;
+	char* url;
+	uint64_t hash;
+	oris_http_payload_t* payload;
+	struct oris_http_queue_entry* next;
+} oris_http_queue_entry_t;
+
+/* outbound requests of a target in FIFO order. A PUT or DELETE replaces the
+ * body of the last queued request for the same URL if that one uses the same
+ * method, so the order of different methods per URL is kept. Payloads of
+ * publishers tracking acknowledgements are never coalesced. index is an open
+ * addressing hash table (linear probing) from the URL to its last queued
+ * request, allocated on first use. */
+typedef struct oris_http_queue {
+	oris_http_queue_entry_t* first;
+	oris_http_queue_entry_t* last;
+	size_t count;
+	oris_http_queue_entry_t** index;
+	/* number of requests replaced or dropped */
+	size_t coalesced;
+	size_t dropped;
+} oris_http_queue_t;
+
+void oris_http_queue_init(oris_http_queue_t* queue);
+void oris_http_queue_clear(oris_http_queue_t* queue);
+
+/* queue a reference to payload, false if the request was dropped */
+bool oris_http_queue_push(oris_http_queue_t* queue, enum evhttp_cmd_type method,
+	const char* url, oris_http_payload_t* payload);
+
+/* remove the first request (NULL if empty), the caller frees it */
+oris_http_queue_entry_t* oris_http_queue_pop(oris_http_queue_t* queue);
+void oris_http_queue_entry_free(oris_http_queue_entry_t* entry);
+
+#endif /* __ORIS_HTTP_QUEUE_H */
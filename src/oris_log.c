@@ -1,17 +1,227 @@
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
 #include <openssl/err.h>
 #include <event2/util.h>
 
 #include "oris_log.h"
+#include "oris_thread.h"
+
+/* slots of the message ring, must be a power of two */
+#define ORIS_LOG_RING_SIZE 1024
+/* longer messages are cut and end with "..." */
+#define ORIS_LOG_MSG_SIZE 512
+#define ORIS_LOG_TRUNCATED "..."
+
+/* a formatted message. seq tells the state of the slot: it equals the ring
+ * position when the slot is free for that position and position + 1 when the
+ * message at that position has been published */
+typedef struct {
+	oris_atomic_t seq;
+	int severity;
+	struct timeval tv;
+	char text[ORIS_LOG_MSG_SIZE];
+} oris_log_slot_t;
+
+int oris_log_level;
 
 static FILE* logFile = NULL;
-static int logLevel;
+
+static oris_log_slot_t ring[ORIS_LOG_RING_SIZE];
+static oris_atomic_t ring_head;
+static long ring_tail;
+static oris_atomic_t dropped;
+
+static oris_thread_t writer;
+static oris_mutex_t writer_lock;
+static oris_cond_t writer_cond;
+static oris_atomic_t writer_running;
+static oris_atomic_t writer_sleeping;
+static oris_atomic_t writer_stop;
+static int writer_initialized;
+
+/* the signed distance between two ring positions, robust to wrap around */
+static long oris_log_distance(long a, long b)
+{
+	return (long) ((unsigned long) a - (unsigned long) b);
+}
+
+static const char* oris_log_severity(int severity)
+{
+	switch (severity) {
+	case LOG_DEBUG:
+		return "DEBUG";
+	case LOG_INFO:
+		return "INFO";
+	case LOG_WARNING:
+		return "WARN";
+	case LOG_NOTICE:
+		return "NOTICE";
+	case LOG_ERR:
+		return "ERROR";
+	case LOG_ALERT:
+		return "ALERT";
+	case LOG_CRIT:
+		return "CRITICAL";
+	default:
+		return "";
+	}
+}
+
+/* the date part of the line is only formatted once per second */
+static const char* oris_log_date(time_t sec)
+{
+	static time_t cached_sec = 0;
+	static char cached_date[64];
+	struct tm t;
+
+	if (sec != cached_sec || cached_date[0] == '\0') {
+#ifndef _WIN32
+		localtime_r(&sec, &t);
+#else
+		localtime_s(&t, &sec);
+#endif
+		snprintf(cached_date, sizeof(cached_date), "%4d-%02d-%02d %02d:%02d:%02d",
+			1900 + t.tm_year, t.tm_mon + 1, t.tm_mday,
+			t.tm_hour, t.tm_min, t.tm_sec);
+		cached_sec = sec;
+	}
+
+	return cached_date;
+}
+
+static void oris_log_write(const oris_log_slot_t* slot)
+{
+	static struct timeval last_log = { 0, 0 };
+	int64_t diff;
+	size_t len = strlen(slot->text);
+
+	/* every message ends up on a line of its own */
+	while (len > 0 && (slot->text[len - 1] == '\n' || slot->text[len - 1] == '\r')) {
+		len--;
+	}
+
+	fputs(oris_log_date(slot->tv.tv_sec), logFile);
+	if (last_log.tv_sec != 0) {
+		diff = ((int64_t) slot->tv.tv_sec * 1000000 + slot->tv.tv_usec -
+			((int64_t) last_log.tv_sec * 1000000 + last_log.tv_usec)) / 1000;
+		fprintf(logFile, " [+%ld.%03ld]: ", (long) (diff / 1000), (long) (diff % 1000));
+	} else {
+		fputs(": ", logFile);
+	}
+	fprintf(logFile, "%s %.*s\n", oris_log_severity(slot->severity), (int) len, slot->text);
+
+	last_log = slot->tv;
+}
+
+/* write all published messages, returns their number */
+static int oris_log_drain(void)
+{
+	oris_log_slot_t* slot;
+	int count = 0;
+
+	for (;;) {
+		slot = &ring[ring_tail & (ORIS_LOG_RING_SIZE - 1)];
+		if (oris_atomic_load(&slot->seq) != ring_tail + 1) {
+			break;
+		}
+
+		if (logFile) {
+			oris_log_write(slot);
+		}
+		oris_atomic_store(&slot->seq, ring_tail + ORIS_LOG_RING_SIZE);
+		ring_tail++;
+		count++;
+	}
+
+	return count;
+}
+
+static bool oris_log_pending(void)
+{
+	oris_log_slot_t* slot = &ring[ring_tail & (ORIS_LOG_RING_SIZE - 1)];
+
+	return oris_atomic_load(&slot->seq) == ring_tail + 1;
+}
+
+static oris_thread_result_t ORIS_THREAD_CALL oris_log_writer(void* arg)
+{
+	(void) arg;
+
+	for (;;) {
+		if (oris_log_drain() > 0) {
+			/* keep on batching while messages are coming in */
+			continue;
+		}
+
+		if (logFile) {
+			fflush(logFile);
+		}
+
+		oris_mutex_lock(&writer_lock);
+		oris_atomic_store(&writer_sleeping, 1);
+		while (!oris_atomic_load(&writer_stop) && !oris_log_pending()) {
+			oris_cond_wait(&writer_cond, &writer_lock);
+		}
+		oris_atomic_store(&writer_sleeping, 0);
+		oris_mutex_unlock(&writer_lock);
+
+		if (oris_atomic_load(&writer_stop)) {
+			oris_log_drain();
+			break;
+		}
+	}
+
+	if (logFile) {
+		fflush(logFile);
+	}
+
+	return 0;
+}
+
+static void oris_log_start_writer(void)
+{
+	long i;
+
+	if (!writer_initialized) {
+		for (i = 0; i < ORIS_LOG_RING_SIZE; i++) {
+			ring[i].seq = i;
+		}
+		oris_mutex_init(&writer_lock);
+		oris_cond_init(&writer_cond);
+		writer_initialized = 1;
+	}
+
+	oris_atomic_store(&writer_stop, 0);
+	if (oris_thread_create(&writer, oris_log_writer, NULL)) {
+		oris_atomic_store(&writer_running, 1);
+	} else {
+		/* messages are written synchronously instead */
+		fprintf(stderr, "could not start log writer\n");
+	}
+}
+
+static void oris_log_stop_writer(void)
+{
+	if (!oris_atomic_load(&writer_running)) {
+		return;
+	}
+
+	oris_atomic_store(&writer_running, 0);
+	oris_mutex_lock(&writer_lock);
+	oris_atomic_store(&writer_stop, 1);
+	oris_cond_signal(&writer_cond);
+	oris_mutex_unlock(&writer_lock);
+	oris_thread_join(writer);
+}
 
 void oris_init_log(const char* logfilename, int desiredLogLevel)
 {
+	oris_log_stop_writer();
+
 	if (logfilename) {
 		if (logFile && logFile != stdout) {
 			fclose(logFile);
@@ -25,126 +235,132 @@ void oris_init_log(const char* logfilename, int desiredLogLevel)
 		logFile = stdout;
 	}
 
-	logLevel = desiredLogLevel;
+	oris_log_level = desiredLogLevel;
+
+	oris_log_start_writer();
 }
 
-static void get_localtime(struct tm* t, struct timeval *tv)
+/* claim the slot for the next message, NULL if the ring is full */
+static oris_log_slot_t* oris_log_claim(long* pos)
 {
-	time_t rawtime;
+	oris_log_slot_t* slot;
+	long seq, distance;
 
-	evutil_gettimeofday(tv, NULL);
-	rawtime = tv->tv_sec;
-	time(&rawtime);
-#ifndef _WIN32
-	localtime_r(&rawtime, t);
-#else
-	localtime_s(t, &rawtime);
-#endif
+	for (;;) {
+		*pos = oris_atomic_load(&ring_head);
+		slot = &ring[*pos & (ORIS_LOG_RING_SIZE - 1)];
+		seq = oris_atomic_load(&slot->seq);
+		distance = oris_log_distance(seq, *pos);
+
+		if (distance == 0) {
+			if (oris_atomic_cas(&ring_head, *pos, *pos + 1)) {
+				return slot;
+			}
+		} else if (distance < 0) {
+			/* the writer has not yet consumed the message of the last round */
+			oris_atomic_add(&dropped, 1);
+			return NULL;
+		}
+	}
 }
 
-static void oris_log_time(void)
+static void oris_log_publish(oris_log_slot_t* slot, long pos)
 {
-	struct tm t;
-	struct timeval now;
-	static struct timeval last_log = { 0, 0 };
-	int64_t diff;
-
-	get_localtime(&t, &now);
-	fprintf(logFile, "%4d-%02d-%02d %02d:%02d:%02d",
-		1900 + t.tm_year, t.tm_mon + 1, t.tm_mday,
-		t.tm_hour, t.tm_min, t.tm_sec);
+	oris_atomic_store(&slot->seq, pos + 1);
 
-	if (last_log.tv_sec != 0) {
-		diff = (int64_t)
-			(((now.tv_sec * 1E6 + now.tv_usec) -
-			 (last_log.tv_sec * 1E6 + last_log.tv_usec)) / 1E3);
-		fprintf(logFile, " [+%0ld.%03ld]: ", diff / 1000, diff % 1000);
-	} else {
-		fprintf(logFile, ": ");
+	if (oris_atomic_load(&writer_sleeping)) {
+		oris_mutex_lock(&writer_lock);
+		oris_cond_signal(&writer_cond);
+		oris_mutex_unlock(&writer_lock);
 	}
-
-	last_log = now;
 }
 
-static void oris_log_severity(int severity)
+static void oris_log_format(oris_log_slot_t* slot, int severity, const char* fmt,
+	va_list args)
 {
-	char* msg;
+	int n;
 
-	switch (severity) {
-	case LOG_DEBUG:
-		msg = "DEBUG";
-		break;
-	case LOG_INFO:
-		msg = "INFO";
-		break;
-	case LOG_WARNING:
-		msg = "WARN";
-		break;
-	case LOG_NOTICE:
-		msg = "NOTICE";
-		break;
-	case LOG_ERR:
-		msg = "ERROR";
-		break;
-	case LOG_ALERT:
-		msg = "ALERT";
-		break;
-	case LOG_CRIT:
-		msg = "CRITICAL";
-		break;
-	default:
-		msg = "";
+	slot->severity = severity;
+	evutil_gettimeofday(&slot->tv, NULL);
+	n = vsnprintf(slot->text, sizeof(slot->text), fmt, args);
+	if (n >= (int) sizeof(slot->text)) {
+		memcpy(slot->text + sizeof(slot->text) - sizeof(ORIS_LOG_TRUNCATED),
+			ORIS_LOG_TRUNCATED, sizeof(ORIS_LOG_TRUNCATED));
 	}
-
-	fprintf(logFile, "%s ", msg);
 }
 
-void oris_log_f(int severity, char* fmt, ...)
+static void oris_log_post(int severity, const char* fmt, va_list args)
 {
-	va_list arglist;
+	oris_log_slot_t local;
+	oris_log_slot_t* slot;
+	long pos;
+
+	if (!oris_atomic_load(&writer_running)) {
+		if (logFile) {
+			oris_log_format(&local, severity, fmt, args);
+			oris_log_write(&local);
+			fflush(logFile);
+		}
+		return;
+	}
 
-	if (logFile && severity <= logLevel) {
-		oris_log_time();
-		oris_log_severity(severity);
-        	va_start(arglist, fmt);
-		vfprintf(logFile, fmt, arglist);
-		va_end(arglist);
-		fprintf(logFile," \n");
+	slot = oris_log_claim(&pos);
+	if (!slot) {
+		return;
 	}
+
+	oris_log_format(slot, severity, fmt, args);
+	oris_log_publish(slot, pos);
 }
 
-void oris_logs(int severity, const char* s)
+void oris_log_print_f(int severity, const char* fmt, ...)
 {
-	if (logFile && severity <= logLevel) {
-		oris_log_time();
-		oris_log_severity(severity);
-		fputs(s, logFile);
-	}
+	va_list args;
+
+	va_start(args, fmt);
+	oris_log_post(severity, fmt, args);
+	va_end(args);
 }
 
+void oris_log_print_s(int severity, const char* s)
+{
+	oris_log_print_f(severity, "%s", s);
+}
 
 void oris_log_ssl_error(int severity)
 {
-	if (logFile && severity <= logLevel) {
-		oris_log_time();
-		oris_log_severity(severity);
-		ERR_print_errors_fp(logFile);
+	unsigned long error;
+	char buffer[256];
+
+	while ((error = ERR_get_error()) != 0) {
+		if (LOG_ENABLED(severity)) {
+			ERR_error_string_n(error, buffer, sizeof(buffer));
+			oris_log_print_f(severity, "%s", buffer);
+		}
 	}
 }
 
+unsigned long oris_log_dropped(void)
+{
+	return (unsigned long) oris_atomic_load(&dropped);
+}
+
 int oris_get_log_level(void)
 {
-	return logLevel;
+	return oris_log_level;
 }
 
 void oris_set_log_level(int level)
 {
-	logLevel = level;
+	oris_log_level = level;
 }
 
 void oris_finalize_log(void)
 {
-	if (logFile && logFile != stderr) {
+	oris_log_stop_writer();
+
+	if (logFile && logFile != stdout) {
 		fclose(logFile);
 	}
+	logFile = NULL;
 }
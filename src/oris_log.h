@@ -16,23 +16,40 @@
 #define LOG_ALERT 1
 #endif
 
+/* current log level, use LOG_ENABLED instead of reading it */
+extern int oris_log_level;
+
+/* whether messages of the given severity are logged at all */
+#define LOG_ENABLED(level) ((level) <= oris_log_level)
+
 /**
  * oris_init_log
  *
- * initiate the loggign infrastructure
+ * initiate the loggign infrastructure. Messages are formatted by the caller
+ * into a ring and written by a background thread.
  */
 void oris_init_log(const char* logfilename, int desiredLogLevel);
 
 /**
  * oris_log
  *
- * log a message with given severity (either a plain string for printf stuff)
+ * log a message with given severity (either a plain string for printf stuff).
+ * the arguments are not evaluated if the severity is disabled. Messages are
+ * cut at 512 bytes, truncated ones end with "...".
  */
-void oris_log_f(int severity, char* fmt, ...);
-void oris_logs(int severity, const char* s);
+#define oris_log_f(severity, ...) \
+	do { if (LOG_ENABLED(severity)) oris_log_print_f((severity), __VA_ARGS__); } while (0)
+#define oris_logs(severity, s) \
+	do { if (LOG_ENABLED(severity)) oris_log_print_s((severity), (s)); } while (0)
+
+void oris_log_print_f(int severity, const char* fmt, ...);
+void oris_log_print_s(int severity, const char* s);
 
 void oris_log_ssl_error(int severity);
 
+/* number of messages lost because the ring was full */
+unsigned long oris_log_dropped(void);
+
 /**
  * get/set log level
  */
@@ -0,0 +1,467 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <event2/event.h>
+#include <event2/http.h>
+
+#include "oris_app_info.h"
+#include "oris_histogram.h"
+#include "oris_http_payload.h"
+#include "oris_log.h"
+#include "oris_metrics.h"
+#include "oris_protocol_data.h"
+
+/* the values are read on the event loop, which also updates all counters
+ * but the log's, so they are plain fields of the objects they are about */
+
+typedef enum {
+	ORIS_METRIC_GLOBAL,
+	ORIS_METRIC_CONNECTION,
+	/* connections of the data protocol only */
+	ORIS_METRIC_DATA_CONNECTION,
+	ORIS_METRIC_TABLE,
+	ORIS_METRIC_TARGET
+} oris_metric_scope_t;
+
+/* a metric family. Either value or histogram is set, both are called with
+ * the connection, table or target the sample is about (NULL if global). A
+ * NULL histogram is skipped */
+typedef struct {
+	const char* name;
+	const char* type;
+	const char* help;
+	oris_metric_scope_t scope;
+	uint64_t (*value)(oris_application_info_t* info, const void* object);
+	const oris_histogram_t* (*histogram)(oris_application_info_t* info, const void* object);
+} oris_metric_t;
+
+typedef struct {
+	oris_connection_t base;
+	struct evhttp* http;
+	struct evhttp_uri* uri;
+} oris_metrics_connection_t;
+
+/* upper bounds of the latency histogram buckets in usec */
+static const uint64_t latency_buckets[] = {
+	1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+	1000000, 2500000, 5000000, 10000000
+};
+
+#define LABEL_SIZE 256
+
+#define CONNECTION(o) ((const oris_connection_t*) (o))
+#define DATA(o) ((const oris_data_protocol_data_t*) CONNECTION(o)->protocol->data)
+#define TABLE(o) ((const oris_table_t*) (o))
+#define TARGET(o) ((const oris_http_target_t*) (o))
+
+static uint64_t connection_bytes_in(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return CONNECTION(o)->bytesIn;
+}
+
+static uint64_t connection_bytes_out(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return CONNECTION(o)->bytesOut;
+}
+
+static uint64_t connection_lines(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return CONNECTION(o)->linesIn;
+}
+
+static uint64_t data_queue_length(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return DATA(o)->queue_length;
+}
+
+static uint64_t data_deduped(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return DATA(o)->deduped;
+}
+
+static uint64_t data_dropped(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return DATA(o)->dropped;
+}
+
+static uint64_t table_updates(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return TABLE(o)->updates;
+}
+
+static uint64_t table_rows(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return (uint64_t) TABLE(o)->row_count;
+}
+
+static uint64_t table_arena_bytes(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return TABLE(o)->data.capacity + TABLE(o)->offsets.capacity;
+}
+
+static const oris_histogram_t* table_latency(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return TABLE(o)->latency;
+}
+
+static uint64_t target_requests(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return TARGET(o)->requests;
+}
+
+static uint64_t target_errors(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return TARGET(o)->errors;
+}
+
+static const oris_histogram_t* target_latency(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return &TARGET(o)->latency;
+}
+
+static uint64_t target_queue_depth(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return TARGET(o)->queue.count;
+}
+
+static uint64_t target_in_flight(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return (uint64_t) TARGET(o)->in_flight;
+}
+
+static uint64_t target_coalesced(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return TARGET(o)->queue.coalesced;
+}
+
+static uint64_t target_dropped(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return TARGET(o)->queue.dropped;
+}
+
+static uint64_t target_cache_hits(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return TARGET(o)->cache.hits;
+}
+
+static uint64_t target_cache_misses(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	return TARGET(o)->cache.misses;
+}
+
+static uint64_t bodies_encoded(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	(void) o;
+	return oris_http_encoding_get_stats()->encoded;
+}
+
+static uint64_t bodies_reused(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	(void) o;
+	return oris_http_encoding_get_stats()->reused;
+}
+
+static uint64_t expr_pool_used(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	(void) o;
+	return oris_expr_mem_pool ?
+		oris_expr_mem_pool->obj_nr - oris_expr_mem_pool->free_obj_nr : 0;
+}
+
+static uint64_t expr_pool_free(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	(void) o;
+	return oris_expr_mem_pool ? oris_expr_mem_pool->free_obj_nr : 0;
+}
+
+static uint64_t log_dropped(oris_application_info_t* info, const void* o)
+{
+	(void) info;
+	(void) o;
+	return oris_log_dropped();
+}
+
+static const oris_metric_t metrics[] = {
+	{ "oris_connection_received_bytes_total", "counter",
+		"bytes received on a connection", ORIS_METRIC_CONNECTION,
+		connection_bytes_in, NULL },
+	{ "oris_connection_sent_bytes_total", "counter",
+		"bytes sent on a connection", ORIS_METRIC_CONNECTION,
+		connection_bytes_out, NULL },
+	{ "oris_connection_lines_total", "counter",
+		"lines received from the data feed", ORIS_METRIC_CONNECTION,
+		connection_lines, NULL },
+	{ "oris_data_queue_depth", "gauge",
+		"data requests waiting to be sent", ORIS_METRIC_DATA_CONNECTION,
+		data_queue_length, NULL },
+	{ "oris_data_deduplicated_total", "counter",
+		"data requests dropped because an equal one was queued", ORIS_METRIC_DATA_CONNECTION,
+		data_deduped, NULL },
+	{ "oris_data_dropped_total", "counter",
+		"data requests dropped because the queue was full", ORIS_METRIC_DATA_CONNECTION,
+		data_dropped, NULL },
+	{ "oris_table_updates_total", "counter",
+		"number of times a table was received completely", ORIS_METRIC_TABLE,
+		table_updates, NULL },
+	{ "oris_table_rows", "gauge",
+		"rows of a table", ORIS_METRIC_TABLE,
+		table_rows, NULL },
+	{ "oris_table_arena_bytes", "gauge",
+		"memory reserved for the content of a table", ORIS_METRIC_TABLE,
+		table_arena_bytes, NULL },
+	{ "oris_table_latency_seconds", "histogram",
+		"time from receiving a table to the responses of its requests", ORIS_METRIC_TABLE,
+		NULL, table_latency },
+	{ "oris_http_requests_total", "counter",
+		"requests sent to a target", ORIS_METRIC_TARGET,
+		target_requests, NULL },
+	{ "oris_http_errors_total", "counter",
+		"requests failed or answered with a non 2xx status", ORIS_METRIC_TARGET,
+		target_errors, NULL },
+	{ "oris_http_latency_seconds", "histogram",
+		"time from receiving a feed line to the response of a target", ORIS_METRIC_TARGET,
+		NULL, target_latency },
+	{ "oris_http_queue_depth", "gauge",
+		"requests waiting for a connection to a target", ORIS_METRIC_TARGET,
+		target_queue_depth, NULL },
+	{ "oris_http_in_flight", "gauge",
+		"requests waiting for the response of a target", ORIS_METRIC_TARGET,
+		target_in_flight, NULL },
+	{ "oris_http_coalesced_total", "counter",
+		"queued requests replaced by a newer body", ORIS_METRIC_TARGET,
+		target_coalesced, NULL },
+	{ "oris_http_dropped_total", "counter",
+		"requests dropped because the queue was full", ORIS_METRIC_TARGET,
+		target_dropped, NULL },
+	{ "oris_http_cache_hits_total", "counter",
+		"requests skipped because they were published already", ORIS_METRIC_TARGET,
+		target_cache_hits, NULL },
+	{ "oris_http_cache_misses_total", "counter",
+		"requests not found in the publish cache", ORIS_METRIC_TARGET,
+		target_cache_misses, NULL },
+	{ "oris_http_bodies_encoded_total", "counter",
+		"request bodies compressed", ORIS_METRIC_GLOBAL,
+		bodies_encoded, NULL },
+	{ "oris_http_bodies_reused_total", "counter",
+		"compressed request bodies shared between targets", ORIS_METRIC_GLOBAL,
+		bodies_reused, NULL },
+	{ "oris_expr_pool_used_objects", "gauge",
+		"expression values allocated from the memory pool", ORIS_METRIC_GLOBAL,
+		expr_pool_used, NULL },
+	{ "oris_expr_pool_free_objects", "gauge",
+		"expression values available in the memory pool", ORIS_METRIC_GLOBAL,
+		expr_pool_free, NULL },
+	{ "oris_log_dropped_total", "counter",
+		"log messages dropped because the log writer could not keep up", ORIS_METRIC_GLOBAL,
+		log_dropped, NULL }
+};
+
+/* key="value" with value escaped */
+static const char* oris_metrics_label(char* buf, const char* key, const char* value)
+{
+	size_t i = (size_t) evutil_snprintf(buf, LABEL_SIZE, "%s=\"", key);
+
+	for (; *value && i < LABEL_SIZE - 4; value++) {
+		if (*value == '\\' || *value == '"') {
+			buf[i++] = '\\';
+			buf[i++] = *value;
+		} else if (*value == '\n') {
+			buf[i++] = '\\';
+			buf[i++] = 'n';
+		} else {
+			buf[i++] = *value;
+		}
+	}
+	buf[i++] = '"';
+	buf[i] = '\0';
+
+	return buf;
+}
+
+/* cumulative buckets, sum and count of a histogram of usec values in seconds */
+static void oris_metrics_histogram(struct evbuffer* out, const char* name,
+	const char* labels, const oris_histogram_t* histogram)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(latency_buckets) / sizeof(*latency_buckets); i++) {
+		evbuffer_add_printf(out, "%s_bucket{%s,le=\"%g\"} %llu\n", name, labels,
+			latency_buckets[i] / 1E6, (unsigned long long) oris_histogram_count_below(
+				histogram, latency_buckets[i]));
+	}
+	evbuffer_add_printf(out, "%s_bucket{%s,le=\"+Inf\"} %llu\n", name, labels,
+		(unsigned long long) histogram->total);
+	evbuffer_add_printf(out, "%s_sum{%s} %.6f\n", name, labels, histogram->sum / 1E6);
+	evbuffer_add_printf(out, "%s_count{%s} %llu\n", name, labels,
+		(unsigned long long) histogram->total);
+}
+
+static void oris_metrics_sample(oris_application_info_t* info, struct evbuffer* out,
+	const oris_metric_t* metric, const void* object, const char* key, const char* name)
+{
+	char label[LABEL_SIZE];
+	const oris_histogram_t* histogram;
+
+	if (metric->histogram) {
+		histogram = metric->histogram(info, object);
+		if (histogram) {
+			oris_metrics_histogram(out, metric->name,
+				oris_metrics_label(label, key, name), histogram);
+		}
+	} else if (key) {
+		evbuffer_add_printf(out, "%s{%s} %llu\n", metric->name,
+			oris_metrics_label(label, key, name),
+			(unsigned long long) metric->value(info, object));
+	} else {
+		evbuffer_add_printf(out, "%s %llu\n", metric->name,
+			(unsigned long long) metric->value(info, object));
+	}
+}
+
+void oris_metrics_write(void* data, struct evbuffer* out)
+{
+	oris_application_info_t* info = (oris_application_info_t*) data;
+	const oris_metric_t* metric;
+	const oris_connection_t* c;
+	size_t i, j;
+
+	for (i = 0; i < sizeof(metrics) / sizeof(*metrics); i++) {
+		metric = &metrics[i];
+		evbuffer_add_printf(out, "# HELP %s %s\n# TYPE %s %s\n",
+			metric->name, metric->help, metric->name, metric->type);
+
+		switch (metric->scope) {
+			case ORIS_METRIC_GLOBAL:
+				oris_metrics_sample(info, out, metric, NULL, NULL, NULL);
+				break;
+			case ORIS_METRIC_CONNECTION:
+			case ORIS_METRIC_DATA_CONNECTION:
+				for (j = 0; j < info->connections.count; j++) {
+					c = info->connections.items[j];
+					if (metric->scope == ORIS_METRIC_CONNECTION || (c->protocol &&
+							strcmp(c->protocol->name, "data") == 0)) {
+						oris_metrics_sample(info, out, metric, c, "connection", c->name);
+					}
+				}
+				break;
+			case ORIS_METRIC_TABLE:
+				for (j = 0; j < info->data_tables.count; j++) {
+					oris_metrics_sample(info, out, metric, &info->data_tables.tables[j],
+						"table", info->data_tables.tables[j].name);
+				}
+				break;
+			case ORIS_METRIC_TARGET:
+				for (j = 0; j < (size_t) info->targets.count; j++) {
+					oris_metrics_sample(info, out, metric, &info->targets.items[j],
+						"target", info->targets.items[j].name);
+				}
+				break;
+		}
+	}
+}
+
+static void oris_metrics_request_cb(struct evhttp_request* req, void* arg)
+{
+	struct evbuffer* out;
+
+	if (evhttp_request_get_command(req) != EVHTTP_REQ_GET) {
+		evhttp_send_error(req, HTTP_BADMETHOD, NULL);
+		return;
+	}
+
+	out = evbuffer_new();
+	if (!out) {
+		evhttp_send_error(req, HTTP_INTERNAL, NULL);
+		return;
+	}
+
+	oris_metrics_write(arg, out);
+	evhttp_add_header(evhttp_request_get_output_headers(req), "Content-Type",
+		"text/plain; version=0.0.4");
+	evhttp_send_reply(req, HTTP_OK, "OK", out);
+	evbuffer_free(out);
+}
+
+static void oris_metrics_connection_free(oris_connection_t* connection)
+{
+	oris_metrics_connection_t* mc = (oris_metrics_connection_t*) connection;
+
+	if (mc->http) {
+		evhttp_free(mc->http);
+	}
+	if (mc->uri) {
+		evhttp_uri_free(mc->uri);
+	}
+
+	oris_connection_free(connection);
+}
+
+oris_connection_t* oris_metrics_connection_create(const char* name,
+		struct evhttp_uri* uri, void* data)
+{
+	oris_application_info_t* info = (oris_application_info_t*) data;
+	oris_metrics_connection_t* retval;
+	const char* host = evhttp_uri_get_host(uri);
+	int port = evhttp_uri_get_port(uri);
+
+	if (port <= 0) {
+		oris_log_f(LOG_ERR, "no port given for metrics connection '%s'", name);
+		return NULL;
+	}
+
+	retval = calloc(1, sizeof(*retval));
+	if (!retval) {
+		oris_log_f(LOG_ERR, "could not create connection '%s'", name);
+		return NULL;
+	}
+
+	if (!oris_connection_init((oris_connection_t*) retval, name, NULL)) {
+		free(retval);
+		return NULL;
+	}
+	retval->base.destroy = oris_metrics_connection_free;
+
+	if (!host || strcmp(host, "*") == 0) {
+		host = "0.0.0.0";
+	}
+
+	retval->http = evhttp_new(info->libevent_info.base);
+	if (!retval->http || evhttp_bind_socket(retval->http, host, (ev_uint16_t) port) != 0) {
+		oris_log_f(LOG_ERR, "could not bind metrics connection '%s' to %s:%d",
+			name, host, port);
+		oris_metrics_connection_free((oris_connection_t*) retval);
+		return NULL;
+	}
+
+	evhttp_set_allowed_methods(retval->http, EVHTTP_REQ_GET);
+	evhttp_set_cb(retval->http, "/metrics", oris_metrics_request_cb, info);
+	retval->uri = uri;
+
+	oris_log_f(LOG_INFO, "metrics connection '%s' ready", name);
+
+	return (oris_connection_t*) retval;
+}
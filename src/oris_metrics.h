@@ -0,0 +1,17 @@
+#ifndef __ORIS_METRICS_H
+#define __ORIS_METRICS_H
+
+#include <event2/buffer.h>
+#include <event2/http.h>
+
+#include "oris_connection.h"
+
+/* write all metrics in the Prometheus text exposition format */
+void oris_metrics_write(void* info, struct evbuffer* out);
+
+/* a connection serving the metrics via HTTP GET /metrics, as configured by
+ * metrics://host:port under connections. uri is freed with the connection */
+oris_connection_t* oris_metrics_connection_create(const char* name,
+		struct evhttp_uri* uri, void* info);
+
+#endif /* __ORIS_METRICS_H */
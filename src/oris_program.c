@@ -0,0 +1,447 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oris_libevent.h"
+#include <antlr3defs.h>
+
+#include "oris_util.h"
+#include "oris_log.h"
+#include "oris_http.h"
+#include "oris_program.h"
+
+#include "grammars/configParser.h"
+
+/* definitions are allocated one by one, programs keep pointers to them */
+static oris_template_t** templates = NULL;
+static size_t template_count = 0;
+static oris_request_def_t** requests = NULL;
+static size_t request_count = 0;
+
+static char* oris_node_text(pANTLR3_BASE_TREE node)
+{
+	return (char*) node->getText(node)->chars;
+}
+
+static bool oris_append_ptr(void*** items, size_t* count, void* item)
+{
+	void** tmp = realloc(*items, (*count + 1) * sizeof(**items));
+
+	if (!tmp) {
+		return false;
+	}
+
+	tmp[(*count)++] = item;
+	*items = tmp;
+
+	return true;
+}
+
+static void oris_free_template(oris_template_t* tmpl)
+{
+	size_t i;
+
+	for (i = 0; i < tmpl->count; i++) {
+		free(tmpl->fields[i].fragment);
+		oris_expr_program_free(&tmpl->fields[i].value);
+	}
+
+	free(tmpl->fields);
+	free(tmpl->name);
+	free(tmpl);
+}
+
+/* estimated length of a rendered value */
+#define TEMPLATE_VALUE_SIZE_HINT 16
+
+/* tree: (TEMPLATE name key value key value ...) */
+void oris_program_add_template(pANTLR3_BASE_TREE tree)
+{
+	oris_template_t* tmpl;
+	oris_template_field_t* field;
+	pANTLR3_BASE_TREE key;
+	ANTLR3_UINT32 i, count = tree->getChildCount(tree);
+	const char* key_name;
+
+	tmpl = calloc(1, sizeof(*tmpl));
+	if (!tmpl || count == 0) {
+		free(tmpl);
+		return;
+	}
+
+	tmpl->name = strdup(oris_node_text(tree->getChild(tree, 0)));
+	tmpl->fields = calloc(count / 2, sizeof(*tmpl->fields));
+	if (!tmpl->name || !tmpl->fields) {
+		oris_free_template(tmpl);
+		return;
+	}
+
+	for (i = 1; i + 1 < count; i += 2) {
+		key = tree->getChild(tree, i);
+		if (key->getType(key) != IDENTIFIER) {
+			continue;
+		}
+
+		key_name = oris_node_text(key);
+		field = &tmpl->fields[tmpl->count];
+		field->fragment = malloc(strlen(key_name) + sizeof(",\"\":"));
+		if (!field->fragment) {
+			oris_free_template(tmpl);
+			return;
+		}
+		field->fragment_len = (size_t) sprintf(field->fragment,
+			tmpl->count > 0 ? ",\"%s\":" : "\"%s\":", key_name);
+
+		if (!oris_expr_compile(&field->value, tree->getChild(tree, i + 1))) {
+			oris_log_f(LOG_ERR, "invalid value for %s in template %s",
+				key_name, tmpl->name);
+		}
+
+		tmpl->size_hint += field->fragment_len + TEMPLATE_VALUE_SIZE_HINT;
+		tmpl->count++;
+	}
+
+	if (!oris_append_ptr((void***) &templates, &template_count, tmpl)) {
+		oris_free_template(tmpl);
+	}
+}
+
+/* tree: (REQUESTS name expr name expr ...) */
+void oris_program_add_requests(pANTLR3_BASE_TREE tree)
+{
+	oris_request_def_t* req;
+	ANTLR3_UINT32 i, count = tree->getChildCount(tree);
+
+	for (i = 0; i + 1 < count; i += 2) {
+		req = calloc(1, sizeof(*req));
+		if (!req) {
+			return;
+		}
+
+		req->name = strdup(oris_node_text(tree->getChild(tree, i)));
+		if (!req->name || !oris_expr_compile(&req->expr, tree->getChild(tree, i + 1))) {
+			oris_log_f(LOG_ERR, "invalid request definition %s", req->name);
+			free(req->name);
+			free(req);
+			continue;
+		}
+
+		if (!oris_append_ptr((void***) &requests, &request_count, req)) {
+			oris_expr_program_free(&req->expr);
+			free(req->name);
+			free(req);
+		}
+	}
+}
+
+/* later definitions (from later config files) take precedence */
+const oris_template_t* oris_program_get_template(const char* name)
+{
+	size_t i;
+
+	for (i = template_count; i > 0; i--) {
+		if (strcmp(templates[i - 1]->name, name) == 0) {
+			return templates[i - 1];
+		}
+	}
+
+	return NULL;
+}
+
+const oris_request_def_t* oris_program_get_request(const char* name)
+{
+	size_t i;
+
+	for (i = request_count; i > 0; i--) {
+		if (strcmp(requests[i - 1]->name, name) == 0) {
+			return requests[i - 1];
+		}
+	}
+
+	return NULL;
+}
+
+void oris_program_free_definitions(void)
+{
+	size_t i;
+
+	for (i = 0; i < template_count; i++) {
+		oris_free_template(templates[i]);
+	}
+	oris_free_and_null(templates);
+	template_count = 0;
+
+	for (i = 0; i < request_count; i++) {
+		oris_expr_program_free(&requests[i]->expr);
+		free(requests[i]->name);
+		free(requests[i]);
+	}
+	oris_free_and_null(requests);
+	request_count = 0;
+}
+
+static bool oris_program_emit(oris_program_t* prog, oris_action_type_t type,
+	size_t* index)
+{
+	oris_action_t* actions;
+	size_t capacity;
+
+	if (prog->count == prog->capacity) {
+		capacity = prog->capacity > 0 ? prog->capacity * 2 : 8;
+		actions = realloc(prog->actions, capacity * sizeof(*actions));
+		if (!actions) {
+			return false;
+		}
+		prog->actions = actions;
+		prog->capacity = capacity;
+	}
+
+	*index = prog->count++;
+	memset(&prog->actions[*index], 0, sizeof(*prog->actions));
+	prog->actions[*index].type = type;
+
+	return true;
+}
+
+/* drop all actions behind count */
+static void oris_program_truncate(oris_program_t* prog, size_t count)
+{
+	oris_action_t* action;
+
+	while (prog->count > count) {
+		action = &prog->actions[--prog->count];
+		oris_expr_program_free(&action->a);
+		oris_expr_program_free(&action->b);
+		oris_expr_program_free(&action->delta_url);
+		if (action->delta) {
+			oris_delta_free(action->delta);
+			free(action->delta);
+		}
+		free(action->tbl_name);
+		free(action->ref_name);
+	}
+}
+
+static bool oris_program_compile_http(oris_action_t* action, pANTLR3_BASE_TREE tree)
+{
+	ANTLR3_UINT32 count = tree->getChildCount(tree);
+	pANTLR3_BASE_TREE c;
+
+	if (count < 2 || !oris_str_to_http_method(oris_node_text(tree->getChild(tree, 0)),
+			&action->method) || !oris_expr_compile(&action->a, tree->getChild(tree, 1))) {
+		return false;
+	}
+
+	if (count == 2) {
+		return true;
+	}
+
+	c = tree->getChild(tree, 2);
+	if (c->getType(c) != IDENTIFIER) {
+		/* with value ... */
+		return oris_expr_compile(&action->b, c);
+	}
+
+	/* using template [for table|each record of] table */
+	action->ref_name = strdup(oris_node_text(c));
+
+	if (count >= 5) {
+		action->per_record = strcmp(oris_node_text(tree->getChild(tree, 3)), "record") == 0;
+		action->tbl_name = strdup(oris_node_text(tree->getChild(tree, 4)));
+	}
+
+	/* ... for table name delta url */
+	if (count == 6) {
+		if (action->per_record) {
+			oris_logs(LOG_WARNING, "delta is ignored for requests per record");
+			return true;
+		}
+
+		action->delta = malloc(sizeof(*action->delta));
+		if (!action->delta) {
+			return false;
+		}
+		oris_delta_init(action->delta);
+
+		return oris_expr_compile(&action->delta_url, tree->getChild(tree, 5));
+	}
+
+	return true;
+}
+
+static bool oris_program_compile_action(oris_program_t* prog, pANTLR3_BASE_TREE tree)
+{
+	oris_action_t* action;
+	size_t index;
+	bool retval;
+
+	switch (tree->getType(tree)) {
+		case FOREACH:
+		case REQUEST:
+			if (!oris_program_emit(prog, tree->getType(tree) == FOREACH ?
+					ORIS_ACTION_FOREACH : ORIS_ACTION_REQUEST, &index)) {
+				return false;
+			}
+			action = &prog->actions[index];
+			action->ref_name = strdup(oris_node_text(tree->getChild(tree, 0)));
+			if (action->type == ORIS_ACTION_FOREACH) {
+				action->tbl_name = strdup(oris_node_text(tree->getChild(tree, 1)));
+			}
+			return true;
+
+		case HTTP:
+			if (!oris_program_emit(prog, ORIS_ACTION_HTTP, &index)) {
+				return false;
+			}
+			retval = oris_program_compile_http(&prog->actions[index], tree);
+			break;
+
+		case UPDATE:
+			if (!oris_program_emit(prog, ORIS_ACTION_UPDATE, &index)) {
+				return false;
+			}
+			action = &prog->actions[index];
+			action->tbl_name = strdup(oris_node_text(tree->getChild(tree, 0)));
+			retval = oris_expr_compile(&action->a, tree->getChild(tree, 1)) &&
+				oris_expr_compile(&action->b, tree->getChild(tree, 2));
+			break;
+
+		case COPY:
+			if (!oris_program_emit(prog, ORIS_ACTION_COPY, &index)) {
+				return false;
+			}
+			action = &prog->actions[index];
+			retval = oris_expr_compile(&action->a, tree->getChild(tree, 0)) &&
+				oris_expr_compile(&action->b, tree->getChild(tree, 1));
+			break;
+
+		default:
+			oris_log_f(LOG_ERR, "unexpected action %s", oris_node_text(tree));
+			return false;
+	}
+
+	if (!retval) {
+		oris_program_truncate(prog, index);
+	}
+
+	return retval;
+}
+
+static bool oris_program_compile_operations(oris_program_t* prog,
+	pANTLR3_BASE_TREE tree, int nesting);
+
+/* tree: (ITERATE table (OPERATIONS ...) condition?) */
+static bool oris_program_compile_iterate(oris_program_t* prog,
+	pANTLR3_BASE_TREE tree, int nesting)
+{
+	size_t begin, end;
+
+	if (nesting >= ORIS_PROGRAM_MAX_NESTING) {
+		oris_logs(LOG_ERR, "iterations nested too deeply");
+		return false;
+	}
+
+	if (tree->getChildCount(tree) < 2 ||
+			!oris_program_emit(prog, ORIS_ACTION_ITERATE, &begin)) {
+		return false;
+	}
+
+	prog->actions[begin].tbl_name = strdup(oris_node_text(tree->getChild(tree, 0)));
+	if ((tree->getChildCount(tree) > 2 &&
+			!oris_expr_compile(&prog->actions[begin].a, tree->getChild(tree, 2))) ||
+			!oris_program_compile_operations(prog, tree->getChild(tree, 1), nesting + 1) ||
+			!oris_program_emit(prog, ORIS_ACTION_NEXT_ROW, &end)) {
+		oris_program_truncate(prog, begin);
+		return false;
+	}
+
+	prog->actions[end].target = begin + 1;
+	prog->actions[begin].target = end + 1;
+
+	return true;
+}
+
+/* tree: (OPERATIONS (ITERATE ...)|(COND_ACTION condition action)|action ...) */
+static bool oris_program_compile_operations(oris_program_t* prog,
+	pANTLR3_BASE_TREE tree, int nesting)
+{
+	pANTLR3_BASE_TREE child;
+	ANTLR3_UINT32 i;
+	size_t index;
+
+	for (i = 0; i < tree->getChildCount(tree); i++) {
+		child = tree->getChild(tree, i);
+
+		switch (child->getType(child)) {
+			case ITERATE:
+				oris_program_compile_iterate(prog, child, nesting);
+				break;
+
+			case COND_ACTION:
+				if (!oris_program_emit(prog, ORIS_ACTION_UNLESS, &index)) {
+					return false;
+				}
+				if (!oris_expr_compile(&prog->actions[index].a, child->getChild(child, 0)) ||
+						!oris_program_compile_action(prog, child->getChild(child, 1))) {
+					oris_program_truncate(prog, index);
+					break;
+				}
+				prog->actions[index].target = prog->count;
+				break;
+
+			default:
+				oris_program_compile_action(prog, child);
+				break;
+		}
+	}
+
+	return true;
+}
+
+bool oris_program_compile(oris_program_t* prog, pANTLR3_BASE_TREE tree)
+{
+	memset(prog, 0, sizeof(*prog));
+
+	if (!oris_program_compile_operations(prog, tree, 0)) {
+		oris_program_free(prog);
+		return false;
+	}
+
+	return true;
+}
+
+void oris_program_free(oris_program_t* prog)
+{
+	oris_program_truncate(prog, 0);
+	oris_free_and_null(prog->actions);
+	prog->capacity = 0;
+}
+
+size_t oris_program_link(oris_program_t* prog)
+{
+	oris_action_t* action;
+	size_t i, retval = 0;
+
+	for (i = 0; i < prog->count; i++) {
+		action = &prog->actions[i];
+		if (!action->ref_name) {
+			continue;
+		}
+
+		if (action->type == ORIS_ACTION_HTTP) {
+			action->tmpl = oris_program_get_template(action->ref_name);
+			if (!action->tmpl) {
+				oris_log_f(LOG_ERR, "template %s does not exist", action->ref_name);
+				retval++;
+			}
+		} else {
+			action->request = oris_program_get_request(action->ref_name);
+			if (!action->request) {
+				oris_log_f(LOG_ERR, "request %s does not exist", action->ref_name);
+				retval++;
+			}
+		}
+	}
+
+	return retval;
+}
@@ -0,0 +1,90 @@
+#ifndef __ORIS_PROGRAM_H
+#define __ORIS_PROGRAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <event2/http.h>
+#include <antlr3commontree.h>
+
+#include "oris_bytecode.h"
+#include "oris_delta.h"
+
+/* maximum nesting of iterate blocks */
+#define ORIS_PROGRAM_MAX_NESTING 16
+
+/* the automation operations of an event are compiled into a flat list of
+ * actions, blocks (conditions, iterations) are expressed by jump targets */
+typedef enum {
+	ORIS_ACTION_UNLESS,   /* continue at target unless a is true */
+	ORIS_ACTION_ITERATE,  /* loop over the rows of tbl_name (if a is true) */
+	ORIS_ACTION_NEXT_ROW, /* next row of the loop starting before target */
+	ORIS_ACTION_REQUEST,  /* send request */
+	ORIS_ACTION_FOREACH,  /* send request for each row of tbl_name */
+	ORIS_ACTION_HTTP,     /* http request to url a with template or value b,
+	                       * changed rows only to delta_url */
+	ORIS_ACTION_UPDATE,   /* set field a of tbl_name to value b */
+	ORIS_ACTION_COPY      /* copy table a to table b */
+} oris_action_type_t;
+
+/* a template field: the preformatted key fragment ("key": with a leading
+ * comma for all but the first field) followed by the value */
+typedef struct {
+	char* fragment;
+	size_t fragment_len;
+	oris_expr_program_t value;
+} oris_template_field_t;
+
+/* a named template compiled into a render plan */
+typedef struct {
+	char* name;
+	size_t count;
+	oris_template_field_t* fields;
+	/* estimated size of a rendered record, used to preallocate buffers */
+	size_t size_hint;
+} oris_template_t;
+
+/* a named request definition */
+typedef struct {
+	char* name;
+	oris_expr_program_t expr;
+} oris_request_def_t;
+
+typedef struct {
+	oris_action_type_t type;
+	size_t target;
+	char* tbl_name;
+	oris_expr_program_t a;
+	oris_expr_program_t b;
+	enum evhttp_cmd_type method;
+	bool per_record;
+	/* rows published last, kept across runs */
+	oris_expr_program_t delta_url;
+	oris_delta_state_t* delta;
+	/* name of the template or request, bound by oris_program_link */
+	char* ref_name;
+	const oris_template_t* tmpl;
+	const oris_request_def_t* request;
+} oris_action_t;
+
+typedef struct {
+	oris_action_t* actions;
+	size_t count;
+	size_t capacity;
+} oris_program_t;
+
+/* templates and requests, referenced by compiled programs */
+void oris_program_add_template(pANTLR3_BASE_TREE tree);
+void oris_program_add_requests(pANTLR3_BASE_TREE tree);
+const oris_template_t* oris_program_get_template(const char* name);
+const oris_request_def_t* oris_program_get_request(const char* name);
+void oris_program_free_definitions(void);
+
+/* compile an OPERATIONS tree, unusable actions are dropped with a message */
+bool oris_program_compile(oris_program_t* prog, pANTLR3_BASE_TREE tree);
+void oris_program_free(oris_program_t* prog);
+
+/* bind templates and requests to the actions once all definitions are known,
+ * returns the number of missing ones (those actions are skipped) */
+size_t oris_program_link(oris_program_t* prog);
+
+#endif /* __ORIS_PROGRAM_H */
@@ -61,8 +61,9 @@ oris_protocol_t* oris_get_protocol_from_scheme(const char* scheme, void *data)
 					((oris_ctrl_protocol_data_t*) retval->data)->info = data;
 				}
 			}
-		} else if (strcmp(scheme, "data") == 0) {
-			retval = oris_simple_protocol_create(scheme,
+		} else if (strcmp(scheme, "data") == 0 || strcmp(scheme, "data+replay") == 0) {
+			/* replayed data is handled like received data */
+			retval = oris_simple_protocol_create("data",
 				oris_protocol_data_read_cb);
 			if (retval) {
                 /* TODO: refactor this out */
@@ -73,6 +74,9 @@ oris_protocol_t* oris_get_protocol_from_scheme(const char* scheme, void *data)
 					oris_protocol_data_init(retval);
 				}
 			}
+		} else if (strcmp(scheme, "metrics") == 0) {
+			/* served by the connection itself */
+			retval = oris_simple_protocol_create(scheme, NULL);
 		}
 	}
 
@@ -17,6 +17,8 @@
 #include "oris_log.h"
 #include "oris_util.h"
 #include "oris_http.h"
+#include "oris_protocol_data.h"
+#include "oris_snapshot.h"
 
 #define LINE_DELIM_CR 0x0D
 #define LINE_DELIM_LF 0x0A
@@ -56,6 +58,8 @@ static void oris_builtin_cmd_trigger(char* s, oris_application_info_t* info,
 	struct evbuffer* out);
 static void oris_builtin_cmd_http(char* s, oris_application_info_t* info,
 	struct evbuffer* out);
+static void oris_builtin_cmd_stats(char* s, oris_application_info_t* info,
+	struct evbuffer* out);
 
 static oris_ctrl_cmd_t ctrl_commands[] = {
 	{ "add", "add a row of records to a table (usage: add table row)", oris_builtin_cmd_add },
@@ -69,6 +73,7 @@ static oris_ctrl_cmd_t ctrl_commands[] = {
 	{ "request", "issue request to data feed provider(s)", oris_builtin_cmd_request },
 	{ "resume", "re-enable automation actions", oris_builtin_cmd_pause_resume },
 	{ "show", "show content of table (name is argument)", oris_builtin_cmd_show },
+	{ "stats", "show statistics (optional argument: http, cache, latency, data, log)", oris_builtin_cmd_stats },
 	{ "target", "modify http target (usage: target disable|enable name)", oris_builtin_cmd_target},
 	{ "terminate", "terminate the gateway", oris_builtin_cmd_terminate },
 	{ "trigger", "trigger actions (table, command)", oris_builtin_cmd_trigger }
@@ -78,6 +83,9 @@ static oris_ctrl_cmd_t ctrl_commands[] = {
 static void process_command(const char* cmd, oris_application_info_t* info,
 	struct evbuffer* output);
 
+/* connection the command being processed was received on (for late replies) */
+static struct bufferevent* current_bev = NULL;
+
 void oris_protocol_ctrl_connected_cb(struct oris_protocol* self)
 {
 	/* sorry, self is not a protocol here */
@@ -105,7 +113,9 @@ void oris_protocol_ctrl_read_cb(struct bufferevent *bev, void *ctx)
 		close = strcmp(cmd, "exit") == 0 || strcmp(cmd, "quit") == 0;
 
 		if (strlen(cmd) > 0 && !close) {
+			current_bev = bev;
 			process_command(cmd, pdata->info, output);
+			current_bev = NULL;
 			if (evbuffer_get_length(output) > 0) {
 				evbuffer_add_printf(output, "\r\n");
 			}
@@ -231,6 +241,23 @@ static void oris_builtin_cmd_help(char* s, oris_application_info_t* info,
 	(void) info;
 }
 
+static void oris_dump_done_cb(const char* fn, bool success, size_t size, void* arg)
+{
+	struct bufferevent* bev = arg;
+
+	if (bev) {
+		if (success) {
+			evbuffer_add_printf(bufferevent_get_output(bev),
+				"\r\ntables dumped to %s (%lu bytes)\r\n%s", fn,
+				(unsigned long) size, ORIS_CTRL_PROMPT);
+		} else {
+			evbuffer_add_printf(bufferevent_get_output(bev),
+				"\r\ncould not dump to %s\r\n%s", fn, ORIS_CTRL_PROMPT);
+		}
+		bufferevent_decref(bev);
+	}
+}
+
 static void oris_builtin_cmd_dump(char* s, oris_application_info_t* info,
 	struct evbuffer* out)
 {
@@ -244,9 +271,18 @@ static void oris_builtin_cmd_dump(char* s, oris_application_info_t* info,
 		return;
 	}
 
-	if (oris_tables_dump_to_file(&info->data_tables, fn)) {
-		evbuffer_add_printf(out, "tables dumped to %s", fn);
+	/* the result is reported when the writer is done, keep the connection */
+	if (current_bev) {
+		bufferevent_incref(current_bev);
+	}
+
+	if (oris_snapshot_write_tables(&info->data_tables, fn, NULL, oris_dump_done_cb,
+			current_bev)) {
+		evbuffer_add_printf(out, "dumping tables to %s", fn);
 	} else {
+		if (current_bev) {
+			bufferevent_decref(current_bev);
+		}
 		evbuffer_add_printf(out, "could not dump to %s", fn);
 	}
 }
@@ -272,10 +308,13 @@ static void oris_builtin_cmd_list(char* s, oris_application_info_t* info,
 	} else if (strcmp(object, "targets") == 0) {
 		evbuffer_add_printf(out, "%d http targets defined", (int) info->targets.count);
 		for (i = 0; i < (size_t) info->targets.count; i++) {
-			evbuffer_add_printf(out, "\r\n\t%s -> %s://%s/%s %s", info->targets.items[i].name,
+			evbuffer_add_printf(out, "\r\n\t%s -> %s://%s/%s (%d connections, %d in flight, %d queued)%s",
+					info->targets.items[i].name,
 					evhttp_uri_get_scheme(info->targets.items[i].uri),
 					evhttp_uri_get_host(info->targets.items[i].uri),
 					evhttp_uri_get_path(info->targets.items[i].uri),
+					info->targets.items[i].pool_size, info->targets.items[i].in_flight,
+					(int) info->targets.items[i].queue.count,
 					!info->targets.items[i].enabled ? " (disabled)" : "");
 		}
 	} else {
@@ -468,7 +507,7 @@ static void oris_builtin_cmd_http(char* s, oris_application_info_t* info,
 	}
 
 	oris_perform_http_on_targets(info->targets.items, info->targets.count,
-		method, uri, body);
+		method, uri, body, NULL);
 
 	evbuffer_free(body);
 }
@@ -512,6 +551,134 @@ static void oris_builtin_cmd_target(char* s, oris_application_info_t* info,
 	}
 
 	target->enabled = strcasecmp(op, "enable") == 0;
+	if (target->enabled) {
+		/* the target may have been changed meanwhile */
+		oris_http_cache_clear(&target->cache);
+	}
+}
+
+static void oris_ctrl_stats_http(oris_application_info_t* info, struct evbuffer* out)
+{
+	const oris_http_encoding_stats_t* stats = oris_http_encoding_get_stats();
+	const oris_http_target_t* target;
+	int i;
+
+	evbuffer_add_printf(out, "http encoding: %lu bodies encoded (%lu -> %lu bytes) in %lu ms, "
+		"%lu reused (about %lu ms saved)", stats->encoded,
+		(unsigned long) stats->bytes_in, (unsigned long) stats->bytes_out,
+		(unsigned long) (stats->usec / 1000), stats->reused,
+		stats->encoded > 0 ? (unsigned long) (stats->usec * stats->reused /
+			stats->encoded / 1000) : 0UL);
+
+	for (i = 0; i < info->targets.count; i++) {
+		target = &info->targets.items[i];
+		evbuffer_add_printf(out, "\r\n\t%s: %d in flight, %lu queued, %lu coalesced, %lu dropped",
+			target->name, target->in_flight, (unsigned long) target->queue.count,
+			(unsigned long) target->queue.coalesced, (unsigned long) target->queue.dropped);
+	}
+}
+
+static void oris_ctrl_stats_cache(oris_application_info_t* info, struct evbuffer* out)
+{
+	const oris_http_target_t* target;
+	int i;
+
+	evbuffer_add_printf(out, "publish cache:");
+	for (i = 0; i < info->targets.count; i++) {
+		target = &info->targets.items[i];
+		evbuffer_add_printf(out, "\r\n\t%s: %lu urls, %lu hits, %lu misses",
+			target->name, (unsigned long) target->cache.count,
+			target->cache.hits, target->cache.misses);
+	}
+}
+
+static void oris_ctrl_stats_histogram(struct evbuffer* out, const char* kind,
+	const char* name, const oris_histogram_t* histogram)
+{
+	evbuffer_add_printf(out, "\r\n\t%s %s: %.3f / %.3f / %.3f ms (%lu responses)",
+		kind, name,
+		oris_histogram_percentile(histogram, 50.0) / 1000.0,
+		oris_histogram_percentile(histogram, 99.0) / 1000.0,
+		oris_histogram_percentile(histogram, 99.9) / 1000.0,
+		(unsigned long) histogram->total);
+}
+
+static void oris_ctrl_stats_latency(oris_application_info_t* info, struct evbuffer* out)
+{
+	size_t i;
+	int j;
+
+	evbuffer_add_printf(out, "latency from feed line to http response (p50 / p99 / p999):");
+	for (i = 0; i < info->table_latency.count; i++) {
+		if (info->table_latency.items[i]->total > 0) {
+			oris_ctrl_stats_histogram(out, "table", info->table_latency.names[i],
+				info->table_latency.items[i]);
+		}
+	}
+
+	for (j = 0; j < info->targets.count; j++) {
+		oris_ctrl_stats_histogram(out, "target", info->targets.items[j].name,
+			&info->targets.items[j].latency);
+	}
+}
+
+static void oris_ctrl_stats_data(oris_application_info_t* info, struct evbuffer* out)
+{
+	const oris_connection_t* con;
+	const oris_data_protocol_data_t* data;
+	size_t i;
+
+	evbuffer_add_printf(out, "data requests:");
+	for (i = 0; i < info->connections.count; i++) {
+		con = info->connections.items[i];
+		if (!con->protocol || strcmp(con->protocol->name, "data") != 0) {
+			continue;
+		}
+		data = (const oris_data_protocol_data_t*) con->protocol->data;
+		evbuffer_add_printf(out, "\r\n\t%s: %d pending, %lu queued, %lu deduplicated, %lu dropped, "
+			"rtt %.1f ms (+/- %.1f), timeout %.1f ms",
+			con->name, data->pending_count, (unsigned long) data->queue_length,
+			data->deduped, data->dropped, data->srtt / 1000.0, data->rttvar / 1000.0,
+			data->rto / 1000.0);
+	}
+}
+
+static void oris_ctrl_stats_log(struct evbuffer* out)
+{
+	evbuffer_add_printf(out, "log: %lu messages dropped", oris_log_dropped());
+}
+
+static void oris_builtin_cmd_stats(char* s, oris_application_info_t* info,
+	struct evbuffer* out)
+{
+	char* object;
+
+	word_end(&s);
+	object = next_word(&s);
+
+	if (!object) {
+		oris_ctrl_stats_http(info, out);
+		evbuffer_add_printf(out, "\r\n");
+		oris_ctrl_stats_cache(info, out);
+		evbuffer_add_printf(out, "\r\n");
+		oris_ctrl_stats_latency(info, out);
+		evbuffer_add_printf(out, "\r\n");
+		oris_ctrl_stats_data(info, out);
+		evbuffer_add_printf(out, "\r\n");
+		oris_ctrl_stats_log(out);
+	} else if (strcmp(object, "http") == 0) {
+		oris_ctrl_stats_http(info, out);
+	} else if (strcmp(object, "cache") == 0) {
+		oris_ctrl_stats_cache(info, out);
+	} else if (strcmp(object, "latency") == 0) {
+		oris_ctrl_stats_latency(info, out);
+	} else if (strcmp(object, "data") == 0) {
+		oris_ctrl_stats_data(info, out);
+	} else if (strcmp(object, "log") == 0) {
+		oris_ctrl_stats_log(out);
+	} else {
+		evbuffer_add_printf(out, "unknown statistics '%s'", object);
+	}
 }
 
 #ifdef _MSC_VER
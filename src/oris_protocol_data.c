@@ -3,6 +3,7 @@
 #include <stdint.h>
 
 #include <event2/event.h>
+#include <event2/buffer.h>
 
 #include "oris_protocol_data.h"
 #include "oris_util.h"
@@ -10,6 +11,7 @@
 #include "oris_table.h"
 #include "oris_automation.h"
 #include "oris_connection.h"
+#include "oris_charset.h"
 
 #define LINE_DELIM_START 0x02
 #define LINE_DELIM_END   0x03
@@ -20,9 +22,11 @@
 #pragma warning( disable : 4706 )
 #endif
 
-static bool is_empty_reply(const char *exp_tbl_name, const char* reply);
-static void process_line(char* line, oris_data_protocol_data_t* protocol);
-static void table_complete_cb(oris_table_t* tbl, oris_application_info_t* info);
+static bool is_empty_reply(const char *exp_tbl_name, const char* reply, size_t len);
+static void process_line(const char* line, size_t len,
+	oris_data_protocol_data_t* protocol);
+static void table_complete_cb(oris_table_t* tbl, oris_application_info_t* info,
+	uint64_t received);
 static void oris_protocol_data_write(const void* buf, size_t bufsize,
 	void* connection, oris_connection_write_fn_t transfer);
 static void oris_protocol_data_free(struct oris_protocol* protocol);
@@ -36,159 +40,316 @@ void oris_protocol_data_init(struct oris_protocol* self)
 	self->write = oris_protocol_data_write;
 	self->destroy = oris_protocol_data_free;
 	data->connection = NULL;
-	data->state = IDLE;
-	data->last_req_tbl_name = NULL;
+	data->capture_stream = -1;
+	data->pending_count = 0;
+	data->window = ORIS_DATA_DEFAULT_WINDOW;
+	data->queue_limit = ORIS_DATA_DEFAULT_QUEUE_LIMIT;
+	data->drop_oldest = true;
+	data->srtt = 0;
+	data->rttvar = 0;
+	data->rto = ORIS_DATA_INITIAL_RTO * 1000;
+	data->rto_min = ORIS_DATA_DEFAULT_RTO_MIN * 1000;
+	data->rto_max = ORIS_DATA_DEFAULT_RTO_MAX * 1000;
 	data->idle_event = event_new(data->info->libevent_info.base, -1, 0,
 		oris_protocol_data_idle_event_cb, data);
 
 	STAILQ_INIT(&data->outstanding_requests);
 }
 
+static uint64_t oris_protocol_data_clamp_rto(const oris_data_protocol_data_t* self,
+	uint64_t rto)
+{
+	if (rto < self->rto_min) {
+		return self->rto_min;
+	}
+
+	return rto > self->rto_max ? self->rto_max : rto;
+}
+
+/* update the estimate with a measured round trip like TCP does (RFC 6298) */
+static void oris_protocol_data_rtt_sample(oris_data_protocol_data_t* self, uint64_t rtt)
+{
+	uint64_t delta;
+
+	if (self->srtt == 0) {
+		self->srtt = rtt;
+		self->rttvar = rtt / 2;
+	} else {
+		delta = self->srtt > rtt ? self->srtt - rtt : rtt - self->srtt;
+		self->rttvar = (3 * self->rttvar + delta) / 4;
+		self->srtt = (7 * self->srtt + rtt) / 8;
+	}
+
+	self->rto = oris_protocol_data_clamp_rto(self, self->srtt + 4 * self->rttvar);
+}
+
+void oris_protocol_data_set_params(struct oris_protocol* self, const struct evhttp_uri* uri)
+{
+	oris_data_protocol_data_t* data = (oris_data_protocol_data_t*) self->data;
+	struct evkeyvalq params;
+	const char* query = evhttp_uri_get_query(uri);
+	const char* overflow;
+
+	if (evhttp_parse_query_str(query ? query : "", &params) != 0) {
+		oris_log_f(LOG_WARNING, "invalid parameters for data connection");
+	}
+
+	data->window = oris_get_int_param(&params, "window", ORIS_DATA_DEFAULT_WINDOW,
+		ORIS_DATA_MAX_WINDOW);
+	data->queue_limit = (size_t) oris_get_int_param(&params, "queue",
+		ORIS_DATA_DEFAULT_QUEUE_LIMIT, ORIS_DATA_MAX_QUEUE_LIMIT);
+	data->rto_min = 1000 * (uint64_t) oris_get_int_param(&params, "rto_min",
+		ORIS_DATA_DEFAULT_RTO_MIN, ORIS_DATA_MAX_RTO);
+	data->rto_max = 1000 * (uint64_t) oris_get_int_param(&params, "rto_max",
+		ORIS_DATA_DEFAULT_RTO_MAX, ORIS_DATA_MAX_RTO);
+	if (data->rto_max < data->rto_min) {
+		oris_log_f(LOG_WARNING, "rto_max is less than rto_min, using rto_min");
+		data->rto_max = data->rto_min;
+	}
+	data->rto = oris_protocol_data_clamp_rto(data, ORIS_DATA_INITIAL_RTO * 1000);
+
+	overflow = evhttp_find_header(&params, "overflow");
+	if (overflow && strcmp(overflow, "newest") == 0) {
+		data->drop_oldest = false;
+	} else if (overflow && strcmp(overflow, "oldest") != 0) {
+		oris_log_f(LOG_WARNING, "invalid value %s for overflow, using oldest", overflow);
+	}
+	evhttp_clear_headers(&params);
+}
+
+static oris_data_request_t** oris_protocol_data_bucket(oris_data_protocol_data_t* self,
+	uint64_t hash)
+{
+	return &self->buckets[hash & (ORIS_DATA_QUEUE_BUCKETS - 1)];
+}
+
+static oris_data_request_t* oris_protocol_data_find(oris_data_protocol_data_t* self,
+	const void* buf, size_t bufsize, uint64_t hash)
+{
+	oris_data_request_t* request = *oris_protocol_data_bucket(self, hash);
+
+	while (request && (request->hash != hash || request->size != bufsize ||
+			memcmp(request->message, buf, bufsize) != 0)) {
+		request = request->bucket_next;
+	}
+
+	return request;
+}
+
+/* remove the first queued request, the caller frees it */
+static oris_data_request_t* oris_protocol_data_dequeue(oris_data_protocol_data_t* self)
+{
+	oris_data_request_t* request = STAILQ_FIRST(&self->outstanding_requests);
+	oris_data_request_t** link = oris_protocol_data_bucket(self, request->hash);
+
+	STAILQ_REMOVE_HEAD(&self->outstanding_requests, queue);
+	while (*link != request) {
+		link = &(*link)->bucket_next;
+	}
+	*link = request->bucket_next;
+	self->queue_length--;
+
+	return request;
+}
+
+static void oris_protocol_data_request_free(oris_data_request_t* request)
+{
+	free(request->message);
+	free(request);
+}
+
 static void oris_protocol_data_free(struct oris_protocol* self)
 {
 	oris_data_protocol_data_t* data = (oris_data_protocol_data_t*) self->data;
-	oris_data_request_t* i;
+	int j;
 
 	event_del(data->idle_event);
 	event_free(data->idle_event);
 
 	while (!STAILQ_EMPTY(&data->outstanding_requests)) {
-		i = STAILQ_FIRST(&data->outstanding_requests);
-		STAILQ_REMOVE_HEAD(&data->outstanding_requests, queue);
-		free(i->message);
-		free(i);
-    }
+		oris_protocol_data_request_free(oris_protocol_data_dequeue(data));
+	}
+
+	for (j = 0; j < data->pending_count; j++) {
+		free(data->pending[j].tbl_name);
+	}
+	data->pending_count = 0;
 
-	oris_free_and_null(data->last_req_tbl_name);
 	oris_free_and_null(data->buffer);
+	oris_free_and_null(data->line);
 	oris_protocol_free(self);
 }
 
+/* hands complete STX...ETX frames to process_line. Frames are read in place
+ * from the input buffer, only frames spanning several chunks of the buffer
+ * are copied to the scratch buffer. */
 void oris_protocol_data_read_cb(struct bufferevent *bev, void *ctx)
 {
 	oris_connection_t* con = ctx;
 	oris_data_protocol_data_t* pdata = (oris_data_protocol_data_t*) con->protocol->data;
 
 	struct evbuffer* input = bufferevent_get_input(bev);
-	char *p_start, *p_end, *bufstart;
+	struct evbuffer_ptr start, end;
+	struct evbuffer_iovec chunk;
+	size_t frame_size;
+	char delim;
 
 	pdata->connection = con;
-	/* receive and return if nothing was recevied */
-	if (oris_protocol_recv(input, &pdata->buffer, &pdata->buf_size, &pdata->buf_capacity) == 0) {
-		return;
+	pdata->received = oris_monotonic_usec();
+	if (pdata->input != input) {
+		pdata->input = input;
+		pdata->scan_pos = 0;
+		pdata->captured = 0;
 	}
 
-	/* process da data */
-	bufstart = pdata->buffer;
-	while (pdata->buf_size > 0 && (p_start = memchr((void*) bufstart, LINE_DELIM_START, pdata->buf_size))) {
-
-		pdata->buf_size -= (p_start - bufstart) + 1;
-
-		/* find end delim */
-		if (pdata->buf_size > 0) {
-			p_end = memchr((void*) ++p_start, LINE_DELIM_END, pdata->buf_size);
-			if (p_end) {
-				*p_end = '\0';
-				process_line(p_start, pdata);
-				pdata->buf_size -= (p_end - p_start) + 1;
-				bufstart = p_end + 1;
-			} else {
-				/* no delim found, discard recieved stuff and wait for next recv */
-				bufstart = p_start;
-				pdata->buf_size++;
-				break;
-			}
+	if (pdata->info->capture.fn) {
+		if (pdata->capture_stream < 0) {
+			pdata->capture_stream = (int) oris_capture_stream(&pdata->info->capture);
 		}
+		oris_capture_write(&pdata->info->capture, (unsigned) pdata->capture_stream,
+			pdata->received, input, pdata->captured);
 	}
 
-	/* move unprocessed data to the beginning of the buffer */
-	if (pdata->buf_size > 0) {
-		memmove(pdata->buffer, bufstart - 1, pdata->buf_size);
-	}
-}
+	for (;;) {
+		/* discard everything before the start of the next frame */
+		delim = LINE_DELIM_START;
+		start = evbuffer_search(input, &delim, 1, NULL);
+		if (start.pos == -1) {
+			evbuffer_drain(input, evbuffer_get_length(input));
+			pdata->scan_pos = 0;
+			break;
+		}
 
-/* conversion of ISO-8859-1 to UTF-8 (from stackoverflow) */
-static char* strdup_iso8859_to_utf8(char* line)
-{
-	unsigned char *c, *retval, *out;
-	size_t size = 0;
+		if (start.pos > 0) {
+			evbuffer_drain(input, start.pos);
+			pdata->scan_pos = 0;
+		}
+
+		/* continue looking for the end where the last search stopped */
+		evbuffer_ptr_set(input, &end, pdata->scan_pos > 0 ? pdata->scan_pos : 1,
+			EVBUFFER_PTR_SET);
+		delim = LINE_DELIM_END;
+		end = evbuffer_search(input, &delim, 1, &end);
+		if (end.pos == -1) {
+			pdata->scan_pos = evbuffer_get_length(input);
+			break;
+		}
 
-	for (c = (unsigned char*) line; *c; c++, size++) {
-		if (*c >= 128) {
-			size++;
+		pdata->scan_pos = 0;
+		frame_size = (size_t) end.pos;
+		con->linesIn++;
+
+		if (evbuffer_peek(input, frame_size, NULL, &chunk, 1) == 1) {
+			process_line((const char*) chunk.iov_base + 1, frame_size - 1, pdata);
+		} else if (frame_size <= pdata->buf_capacity || oris_safe_realloc(
+				(void**) &pdata->buffer, frame_size, sizeof(*pdata->buffer))) {
+			pdata->buf_capacity = frame_size > pdata->buf_capacity ?
+				frame_size : pdata->buf_capacity;
+			evbuffer_copyout(input, pdata->buffer, frame_size);
+			process_line(pdata->buffer + 1, frame_size - 1, pdata);
+		} else {
+			oris_log_f(LOG_ERR, "could not allocate receive buffer (out of memory?). Dropping data");
 		}
+
+		evbuffer_drain(input, frame_size + 1);
 	}
 
-	retval = out = malloc(size + 1);
-	if (retval == NULL) {
-		return NULL;
+	pdata->captured = evbuffer_get_length(input);
+}
+
+/* makes sure the line scratch buffer holds at least size bytes */
+static bool reserve_line_buffer(oris_data_protocol_data_t* protocol, size_t size)
+{
+	if (size <= protocol->line_capacity) {
+		return true;
 	}
 
-	c = (unsigned char*) line;
-	while (*c) {
-		if (*c < 128) {
-			*out++ = *c++;
-		} else {
-			*out++ = 0xc2 + (*c > 0xbf);
-			*out++ = 0x80 + (*c++ & 0x3f);
-		}
+	if (!oris_safe_realloc((void**) &protocol->line, size, sizeof(*protocol->line))) {
+		oris_log_f(LOG_ERR, "could not allocate line buffer (out of memory?). Dropping data");
+		return false;
 	}
-	*out = 0;
 
-	return (char*) retval;
+	protocol->line_capacity = size;
+
+	return true;
+}
+
+static bool is_empty_reply(const char *exp_tbl_name, const char* reply, size_t len)
+{
+	size_t name_len = strlen(exp_tbl_name);
+
+	return len >= name_len + 3 && strncmp(exp_tbl_name, reply, name_len) == 0 &&
+		reply[name_len] == '!' && reply[len - 1] == '0' && reply[len - 2] == '|';
 }
 
-static bool is_empty_reply(const char *exp_tbl_name, const char* reply)
+/* remove the oldest pending request answered by the table, false if none */
+static bool oris_protocol_data_answered(oris_data_protocol_data_t* protocol,
+	const char* tbl_name, const char* line, size_t len)
 {
-	bool retval;
-	const char* p;
-
-	retval = strncmp(exp_tbl_name, reply, strlen(exp_tbl_name)) == 0;
-	if (retval) {
-		retval = *(reply + strlen(exp_tbl_name)) == '!';
-		if (retval) {
-			p = reply + strlen(reply) - 1;
-			retval = (*p == '0') && (*(p-1) == '|');
+	int i;
+
+	for (i = 0; i < protocol->pending_count; i++) {
+		if (strcmp(tbl_name, protocol->pending[i].tbl_name) == 0 ||
+				is_empty_reply(protocol->pending[i].tbl_name, line, len)) {
+			oris_protocol_data_rtt_sample(protocol, protocol->received > protocol->pending[i].sent ?
+				protocol->received - protocol->pending[i].sent : 0);
+			free(protocol->pending[i].tbl_name);
+			protocol->pending_count--;
+			memmove(&protocol->pending[i], &protocol->pending[i + 1],
+				(size_t) (protocol->pending_count - i) * sizeof(*protocol->pending));
+			return true;
 		}
 	}
 
-	return retval;
+	return false;
 }
 
-static void process_line(char* line, oris_data_protocol_data_t* protocol)
+static void process_line(const char* line, size_t len,
+	oris_data_protocol_data_t* protocol)
 {
 	oris_table_t* tbl;
 	oris_application_info_t* info = protocol->info;
-	char *s, *c, *tbl_name;
-	size_t last_char_index;
+	const char *s, *c;
+	char *tbl_name;
+	size_t last_char_index, name_len, size;
 	bool is_last_line, is_response_line;
 
-	if (strlen(line) == 0) {
+	if (len == 0) {
 		return;
 	}
 
-	s = strdup_iso8859_to_utf8(line);
-	c = s;
+	/* the feed is ISO-8859-1, most lines are plain ASCII and used as they are */
+	s = line;
+	size = len;
+	if (!oris_is_ascii(line, len)) {
+		if (!reserve_line_buffer(protocol, 2 * len + 1)) {
+			return;
+		}
+		size = oris_iso8859_to_utf8(line, len, protocol->line);
+		s = protocol->line;
+	}
 
 	/* extract table name */
-	while (*c && *c != RECORD_DELIM) {
-		c++;
+	c = memchr(s, RECORD_DELIM, size);
+	if (!c) {
+		return;
 	}
 
-	if (*c == '\0') {
-		free(s);
+	name_len = (size_t) (c - s);
+	if (name_len < 2) {
 		return;
 	}
 
-	*c = '\0';
-	tbl_name = s;
-
-	if (strlen(tbl_name) < 2) {
-		free(s);
-		return;
+	if (s == line) {
+		if (!reserve_line_buffer(protocol, name_len + 1)) {
+			return;
+		}
+		memcpy(protocol->line, s, name_len);
 	}
+	tbl_name = protocol->line;
+	tbl_name[name_len] = '\0';
 
-	last_char_index = strlen(tbl_name) - 1;
+	last_char_index = name_len - 1;
 	is_last_line = tbl_name[last_char_index] == '0';
 	is_response_line = !is_last_line && tbl_name[last_char_index] != '1';
 	if (!is_response_line) {
@@ -197,8 +358,6 @@ static void process_line(char* line, oris_data_protocol_data_t* protocol)
 
 	tbl = oris_get_or_create_table(&info->data_tables, tbl_name, true);
 	if (!tbl) {
-		free(s);
-		free(line);
 		return;
 	}
 
@@ -207,37 +366,52 @@ static void process_line(char* line, oris_data_protocol_data_t* protocol)
 		oris_table_clear(tbl);
 	}
 
-	oris_table_add_row(tbl, s + last_char_index + 2, ORIS_TABLE_ITEM_SEPERATOR);
+	oris_table_add_row_n(tbl, c + 1, size - name_len - 1, ORIS_TABLE_ITEM_SEPERATOR);
 	tbl->state = (is_response_line || is_last_line) ? COMPLETE : RECEIVING;
 	if (tbl->state == COMPLETE) {
-		table_complete_cb(tbl, info);
-		if (protocol->state == WAIT_FOR_RESPONSE && (strcmp(tbl_name,
-				protocol->last_req_tbl_name) == 0 || is_empty_reply(
-					protocol->last_req_tbl_name, line))) {
-			/* reset state so we can send outstanding requests */
-			oris_log_f(LOG_DEBUG, "received %s, state is idle now, trigger event", tbl_name);
-			protocol->state = IDLE;
+		table_complete_cb(tbl, info, protocol->received);
+		if (oris_protocol_data_answered(protocol, tbl_name, line, len)) {
+			/* a slot of the window is free, send outstanding requests */
+			oris_log_f(LOG_DEBUG, "received %s, %d requests pending, trigger event",
+				tbl_name, protocol->pending_count);
 			event_active(protocol->idle_event, EV_READ, 0);
 		}
 	}
-
-	free(s);
-	return;
 }
 
-static void table_complete_cb(oris_table_t* tbl, oris_application_info_t* info)
+static void table_complete_cb(oris_table_t* tbl, oris_application_info_t* info,
+	uint64_t received)
 {
 	oris_automation_event_t e;
+	oris_http_origin_t previous = info->origin;
+	char* name;
 
-	e.type = EVT_TABLE;
-	e.name = tbl->name;
+	tbl->updates++;
+	if (!tbl->latency) {
+		tbl->latency = oris_histogram_set_get(&info->table_latency, tbl->name);
+	}
 
 	oris_log_f(LOG_INFO, "table %s received (%d lines)", tbl->name, tbl->row_count);
+
+	/* actions may create tables which moves the table list, so neither tbl
+	 * nor its name may be used once they run */
+	name = strdup(tbl->name);
+	if (!name) {
+		return;
+	}
+
+	e.type = EVT_TABLE;
+	e.name = name;
+
+	/* requests of the actions are accounted to the line completing the table */
+	info->origin.received = received;
+	info->origin.latency = tbl->latency;
 	oris_automation_trigger(&e, info);
+	info->origin = previous;
+	free(name);
 
-	if (info->storage_fn) {
-		oris_log_f(LOG_DEBUG, "dumping data tables to %s", info->storage_fn);
-		if (!oris_tables_dump_to_file(&info->data_tables, info->storage_fn)) {
+	if (info->storage.fn) {
+		if (!oris_storage_save(&info->storage)) {
 			oris_log_f(LOG_ERR, "failed to store gateway data tables");
 		}
 	}
@@ -251,80 +425,154 @@ void oris_protocol_data_connected_cb(struct oris_protocol* self)
 	oris_log_f(LOG_DEBUG, "triggering connection actions...");
 }
 
-static void oris_protocol_data_write(const void* buf, size_t bufsize,
-	void* connection, oris_connection_write_fn_t transfer)
+/* wait for the oldest pending request or nothing if none is pending */
+static void oris_protocol_data_schedule(oris_data_protocol_data_t* self)
+{
+	struct timeval timeout;
+	uint64_t now, deadline, wait;
+
+	if (self->pending_count == 0) {
+		event_del(self->idle_event);
+		return;
+	}
+
+	now = oris_monotonic_usec();
+	deadline = self->pending[0].sent + self->rto;
+	wait = deadline > now ? deadline - now : 0;
+	timeout.tv_sec = (long) (wait / 1000000);
+	timeout.tv_usec = (long) (wait % 1000000);
+	event_add(self->idle_event, &timeout);
+}
+
+static void oris_protocol_data_send(oris_data_protocol_data_t* self, const void* buf,
+	size_t bufsize)
 {
+	oris_connection_write_fn_t transfer = ((oris_connection_t*) self->connection)->write;
+	oris_data_pending_t* pending;
 	uint8_t c;
 	char *s;
+
+	oris_log_f(LOG_DEBUG, "sending data request %.*s", (int) bufsize, (const char*) buf);
+	c = LINE_DELIM_START;
+	transfer(self->connection, &c, sizeof(c));
+	transfer(self->connection, buf, bufsize);
+	c = LINE_DELIM_END;
+	transfer(self->connection, &c, sizeof(c));
+
+	/* extract requested table name if any */
+	if (bufsize == 0 || *((const char*) buf) != '?') {
+		return;
+	}
+
+	s = calloc(bufsize, sizeof(*s));
+	if (!s) {
+		return;
+	}
+	memcpy(s, (const char*) buf + 1, bufsize - 1);
+	s[strcspn(s, "|")] = '\0';
+
+	pending = &self->pending[self->pending_count++];
+	pending->tbl_name = s;
+	pending->sent = oris_monotonic_usec();
+	if (self->pending_count == 1) {
+		oris_protocol_data_schedule(self);
+	}
+}
+
+/* send queued requests while the window allows */
+static void oris_protocol_data_send_queued(oris_data_protocol_data_t* self)
+{
+	oris_data_request_t* request;
+
+	while (self->pending_count < self->window && !STAILQ_EMPTY(&self->outstanding_requests)) {
+		request = oris_protocol_data_dequeue(self);
+		oris_protocol_data_send(self, request->message, request->size);
+		oris_protocol_data_request_free(request);
+	}
+}
+
+static void oris_protocol_data_write(const void* buf, size_t bufsize,
+	void* connection, oris_connection_write_fn_t transfer)
+{
 	oris_protocol_t* protocol = ((oris_connection_t*) connection)->protocol;
 	oris_data_protocol_data_t* self = (oris_data_protocol_data_t*) protocol->data;
-	oris_data_request_t* request;
-	struct timeval response_timeout = { 1, 000000 }; /* 1.0 seconds */
+	oris_data_request_t *request, **bucket;
+	uint64_t hash;
+
+	(void) transfer;
 
 	self->connection = connection;
-	if (self->state == IDLE) {
-		oris_log_f(LOG_DEBUG, "sending data request %s", buf);
-		c = LINE_DELIM_START;
-		transfer(connection, &c, sizeof(c));
-		transfer(connection, buf, bufsize);
-		c = LINE_DELIM_END;
-		transfer(connection, &c, sizeof(c));
-
-		/* extract requested table name if any */
-		if (bufsize > 0) {
-			s = (char*) buf;
-			if (*s++ == '?') {
-				s = strdup((const char*) s);
-				if (s) {
-					s[bufsize - 1] = 0;
-					event_add(self->idle_event, &response_timeout);
-					self->state = WAIT_FOR_RESPONSE;
-					self->last_req_tbl_name = s;
-					while (*s++) {
-						if (*s == ORIS_TABLE_ITEM_SEPERATOR) {
-							*s = 0;
-							break;
-						}
-					}
-				}
-			}
+	if (self->pending_count < self->window && STAILQ_EMPTY(&self->outstanding_requests)) {
+		oris_protocol_data_send(self, buf, bufsize);
+		return;
+	}
+
+	hash = oris_hash64(buf, bufsize);
+	if (oris_protocol_data_find(self, buf, bufsize, hash)) {
+		oris_log_f(LOG_DEBUG, "request %.*s is queued already", (int) bufsize, (const char*) buf);
+		self->deduped++;
+		return;
+	}
+
+	if (self->queue_length >= self->queue_limit) {
+		self->dropped++;
+		if (!self->drop_oldest) {
+			oris_log_f(LOG_WARNING, "data request queue full, dropping %.*s",
+				(int) bufsize, (const char*) buf);
+			return;
 		}
-	} else {
-		oris_log_f(LOG_DEBUG, "connection busy, enqueuing request");
-		request = calloc(1, sizeof(*request));
-		request->message = calloc(bufsize + 1, sizeof(*request->message));
-		request->size = bufsize;
-		memcpy(request->message, buf, bufsize);
+		request = oris_protocol_data_dequeue(self);
+		oris_log_f(LOG_WARNING, "data request queue full, dropping %s", request->message);
+		oris_protocol_data_request_free(request);
+	}
 
-		STAILQ_INSERT_TAIL(&self->outstanding_requests, request, queue);
+	oris_log_f(LOG_DEBUG, "connection busy, enqueuing request");
+	request = calloc(1, sizeof(*request));
+	if (!request) {
+		return;
 	}
+	request->message = calloc(bufsize + 1, sizeof(*request->message));
+	if (!request->message) {
+		free(request);
+		return;
+	}
+	request->size = bufsize;
+	memcpy(request->message, buf, bufsize);
+	request->hash = hash;
+
+	STAILQ_INSERT_TAIL(&self->outstanding_requests, request, queue);
+	bucket = oris_protocol_data_bucket(self, hash);
+	request->bucket_next = *bucket;
+	*bucket = request;
+	self->queue_length++;
 }
 
 static void oris_protocol_data_idle_event_cb(evutil_socket_t fd, short type,
 	void *arg)
 {
-	oris_data_request_t* request;
 	oris_data_protocol_data_t* self = (oris_data_protocol_data_t*) arg;
+	uint64_t now = oris_monotonic_usec();
 
 	if (!(type == EV_TIMEOUT || type == EV_READ)) {
 		return;
 	}
 
-	self->state = IDLE;
-
-	if (type == EV_TIMEOUT) {
-		oris_log_f(LOG_DEBUG, "change connection to idle state due to "
-			"missing or timedout reponse");
+	/* give up requests without response */
+	while (self->pending_count > 0 && self->pending[0].sent + self->rto <= now) {
+		oris_log_f(LOG_DEBUG, "missing or timedout response for %s after %lu ms",
+			self->pending[0].tbl_name, (unsigned long) (self->rto / 1000));
+		/* back off like TCP, the next response measures the link again */
+		self->rto = oris_protocol_data_clamp_rto(self, 2 * self->rto);
+		free(self->pending[0].tbl_name);
+		self->pending_count--;
+		memmove(&self->pending[0], &self->pending[1],
+			(size_t) self->pending_count * sizeof(*self->pending));
 	}
 
-	if (STAILQ_EMPTY(&self->outstanding_requests)) {
-		return;
+	if (self->connection) {
+		oris_protocol_data_send_queued(self);
 	}
-
-	request = STAILQ_FIRST(&self->outstanding_requests);
-	STAILQ_REMOVE_HEAD(&self->outstanding_requests, queue);
-	oris_protocol_data_write(request->message, request->size, self->connection,
-		((oris_connection_t*) self->connection)->write);
+	oris_protocol_data_schedule(self);
 
 	/* keep compiler happy */
 	(void) fd;
@@ -1,6 +1,8 @@
 #ifndef __ORIS_PROTOCOL_DATA_H
 #define __ORIS_PROTOCOL_DATA_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <sys/queue.h>
 #ifdef _WIN32
 #define STAILQ_ENTRY SIMPLEQ_ENTRY
@@ -13,29 +15,92 @@
 #endif
 
 #include <event2/bufferevent.h>
+#include <event2/http.h>
 
 #include "oris_app_info.h"
 #include "oris_protocol.h"
 
+/* default and maximum number of requests sent before their responses */
+#define ORIS_DATA_DEFAULT_WINDOW 1
+#define ORIS_DATA_MAX_WINDOW 32
+
+/* response timeout (ms) before the first round trip was measured, default
+ * floor and ceiling of the timeout and the largest ceiling allowed */
+#define ORIS_DATA_INITIAL_RTO 1000
+#define ORIS_DATA_DEFAULT_RTO_MIN 100
+#define ORIS_DATA_DEFAULT_RTO_MAX 10000
+#define ORIS_DATA_MAX_RTO 600000
+
+/* default and maximum number of queued requests */
+#define ORIS_DATA_DEFAULT_QUEUE_LIMIT 1024
+#define ORIS_DATA_MAX_QUEUE_LIMIT 65536
+/* size of the hash table over the queued requests, a power of two */
+#define ORIS_DATA_QUEUE_BUCKETS 256
+
+/* a request that has been sent but not been answered yet */
+typedef struct data_pending {
+	/* name of the table expected as response */
+	char* tbl_name;
+	/* when the request was sent (monotonic usec) */
+	uint64_t sent;
+} oris_data_pending_t;
+
 typedef struct data_request {
 	char* message;
 	size_t size;
+	uint64_t hash;
+	/* next queued request in the same hash bucket */
+	struct data_request* bucket_next;
 	STAILQ_ENTRY(data_request) queue;
 } oris_data_request_t;
 
 typedef struct oris_data_protocol_data {
 	oris_application_info_t* info;
 	void* connection;
+	/* input buffer being framed and how far it was searched for the end */
+	struct evbuffer* input;
+	size_t scan_pos;
+	/* stream number in the capture (-1 if none yet) and the length of the
+	 * input left over from the last read, which has been captured already */
+	int capture_stream;
+	size_t captured;
+	/* when the data being framed was received (monotonic usec) */
+	uint64_t received;
+	/* scratch buffer for frames spanning several chunks */
 	char* buffer;
-	size_t buf_size;
 	size_t buf_capacity;
-	enum { IDLE, WAIT_FOR_RESPONSE } state;
-	char* last_req_tbl_name;
+	/* scratch buffer for the UTF-8 version of a line and the table name */
+	char* line;
+	size_t line_capacity;
+	/* requests sent, oldest first. window= of the connection URI limits them */
+	oris_data_pending_t pending[ORIS_DATA_MAX_WINDOW];
+	int pending_count;
+	int window;
+	/* smoothed round trip time and its variation like TCP's (usec). Requests
+	 * are given up after rto, which stays within rto_min= and rto_max= */
+	uint64_t srtt;
+	uint64_t rttvar;
+	uint64_t rto;
+	uint64_t rto_min;
+	uint64_t rto_max;
+	/* activated by responses and expiring with the oldest pending request */
 	struct event* idle_event;
+	/* requests waiting for the window. A request equal to a queued one is
+	 * dropped, the queue is limited by queue= and overflow=oldest|newest
+	 * tells which request is dropped if it is full */
 	STAILQ_HEAD(request_list, data_request) outstanding_requests;
+	oris_data_request_t* buckets[ORIS_DATA_QUEUE_BUCKETS];
+	size_t queue_length;
+	size_t queue_limit;
+	bool drop_oldest;
+	unsigned long deduped;
+	unsigned long dropped;
 } oris_data_protocol_data_t;
 
 void oris_protocol_data_init(struct oris_protocol* self);
+
+/* take the parameters from the query of the connection's URI */
+void oris_protocol_data_set_params(struct oris_protocol* self, const struct evhttp_uri* uri);
 void oris_protocol_data_read_cb(struct bufferevent *bev, void *ctx);
 void oris_protocol_data_connected_cb(struct oris_protocol* self);
 
@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <event2/event.h>
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/keyvalq_struct.h>
+
+#include "oris_log.h"
+#include "oris_util.h"
+#include "oris_replay.h"
+
+static void oris_replay_connection_free(oris_connection_t* connection)
+{
+	oris_replay_connection_t* rc = (oris_replay_connection_t*) connection;
+
+	if (rc->timer) {
+		event_free(rc->timer);
+	}
+	if (rc->pair[0]) {
+		bufferevent_free(rc->pair[0]);
+	}
+	if (rc->pair[1]) {
+		bufferevent_free(rc->pair[1]);
+	}
+	if (rc->uri) {
+		evhttp_uri_free(rc->uri);
+	}
+
+	oris_capture_reader_close(&rc->reader);
+	oris_free_and_null(rc->fn);
+	oris_connection_free(connection);
+}
+
+static void oris_replay_connection_write(const void* connection, const void* buf,
+	const size_t bufsize)
+{
+	/* nobody answers, the capture contains the responses already */
+	((oris_connection_t*) connection)->bytesOut += bufsize;
+	(void) buf;
+}
+
+static void oris_replay_read_cb(struct bufferevent* bev, void* arg)
+{
+	oris_connection_t* connection = arg;
+
+	if (connection->protocol->read_cb) {
+		connection->protocol->read_cb(bev, connection);
+	}
+}
+
+/* the next record of the replayed stream */
+static bool oris_replay_next(oris_replay_connection_t* self)
+{
+	while (oris_capture_reader_next(&self->reader, &self->record)) {
+		if (self->record.stream == self->stream && self->record.usec >= self->start) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void oris_replay_schedule(oris_replay_connection_t* self, uint64_t wait)
+{
+	struct timeval timeout;
+
+	timeout.tv_sec = (long) (wait / 1000000);
+	timeout.tv_usec = (long) (wait % 1000000);
+	event_add(self->timer, &timeout);
+}
+
+static void oris_replay_finished(oris_replay_connection_t* self)
+{
+	double secs = (double) (oris_monotonic_usec() - self->started) / 1e6;
+
+	oris_log_f(LOG_INFO, "connection '%s': replayed %lu records (%lu bytes) of %s in %.3f s (%.1f MB/s)",
+		self->base.name, self->records, (unsigned long) self->base.bytesIn, self->fn,
+		secs, secs > 0 ? (double) self->base.bytesIn / secs / 1e6 : 0.0);
+}
+
+/* writes the records which are due, at most a batch at a time so that the
+ * protocol keeps up */
+static void oris_replay_timer_cb(evutil_socket_t fd, short what, void* arg)
+{
+	oris_replay_connection_t* self = arg;
+	struct evbuffer* input = bufferevent_get_input(self->pair[0]);
+	uint64_t now = oris_monotonic_usec(), due;
+	size_t written = 0;
+
+	if (self->started == 0) {
+		oris_log_f(LOG_INFO, "connection '%s' replaying %s", self->base.name, self->fn);
+		self->started = now;
+		if (self->base.protocol->connected_cb) {
+			self->base.protocol->connected_cb(self->base.protocol);
+		}
+	}
+
+	while (written < ORIS_REPLAY_BATCH_SIZE &&
+			evbuffer_get_length(input) < ORIS_REPLAY_BATCH_SIZE) {
+		if (!self->has_record) {
+			if (!oris_replay_next(self)) {
+				oris_replay_finished(self);
+				return;
+			}
+			self->has_record = true;
+			if (self->records == 0) {
+				self->offset = self->record.usec;
+			}
+		}
+
+		if (self->speed > 0) {
+			due = self->started + (uint64_t) ((double) (self->record.usec - self->offset) /
+				self->speed);
+			if (due > now) {
+				oris_replay_schedule(self, due - now);
+				return;
+			}
+		}
+
+		bufferevent_write(self->pair[1], self->record.data, self->record.size);
+		self->base.bytesIn += self->record.size;
+		self->records++;
+		self->has_record = false;
+		written += self->record.size;
+	}
+
+	oris_replay_schedule(self, 0);
+
+	(void) fd;
+	(void) what;
+}
+
+static bool oris_replay_set_params(oris_replay_connection_t* self, struct evhttp_uri* uri)
+{
+	struct evkeyvalq params;
+	const char* query = evhttp_uri_get_query(uri);
+	const char* value;
+	char* end;
+	double start = 0;
+	int stream = 0;
+	bool retval = true;
+
+	if (evhttp_parse_query_str(query ? query : "", &params) != 0) {
+		oris_log_f(LOG_WARNING, "invalid parameters for replay connection");
+	}
+
+	self->speed = 1;
+	value = evhttp_find_header(&params, "speed");
+	if (value && strcmp(value, "max") == 0) {
+		self->speed = 0;
+	} else if (value) {
+		self->speed = strtod(value, &end);
+		if (*end != '\0' || !(self->speed > 0)) {
+			oris_log_f(LOG_ERR, "invalid speed %s, use a factor or max", value);
+			retval = false;
+		}
+	}
+
+	value = evhttp_find_header(&params, "start");
+	if (value) {
+		start = strtod(value, &end);
+		if (*end != '\0' || !(start >= 0)) {
+			oris_log_f(LOG_ERR, "invalid start %s, use seconds into the capture", value);
+			retval = false;
+		}
+	}
+	self->start = (uint64_t) (start * 1e6);
+
+	value = evhttp_find_header(&params, "stream");
+	if (value && (!oris_strtoint(value, &stream) || stream < 0)) {
+		oris_log_f(LOG_ERR, "invalid stream %s", value);
+		retval = false;
+	}
+	self->stream = (unsigned) stream;
+
+	evhttp_clear_headers(&params);
+
+	return retval;
+}
+
+/* data+replay://dir/file is relative, data+replay:///dir/file absolute */
+static char* oris_replay_file_name(const struct evhttp_uri* uri)
+{
+	const char* host = evhttp_uri_get_host(uri);
+	const char* path = evhttp_uri_get_path(uri);
+	char* retval;
+
+	host = host ? host : "";
+	path = path ? path : "";
+	retval = malloc(strlen(host) + strlen(path) + 1);
+	if (retval) {
+		strcpy(retval, host);
+		strcat(retval, path);
+	}
+
+	return retval;
+}
+
+oris_connection_t* oris_replay_connection_create(const char* name,
+		oris_protocol_t* protocol, struct evhttp_uri* uri,
+		oris_libevent_base_info_t* info)
+{
+	oris_replay_connection_t* retval;
+
+	if (!protocol) {
+		oris_log_f(LOG_DEBUG, "no protocol specified, connection will not be created");
+		return NULL;
+	}
+
+	retval = calloc(1, sizeof(*retval));
+	if (!retval) {
+		oris_log_f(LOG_ERR, "could not create connection '%s'", name);
+		protocol->destroy(protocol);
+		return NULL;
+	}
+
+	if (!oris_connection_init((oris_connection_t*) retval, name, protocol)) {
+		protocol->destroy(protocol);
+		free(retval);
+		return NULL;
+	}
+	retval->base.destroy = oris_replay_connection_free;
+	retval->base.write = oris_replay_connection_write;
+	retval->libevent_info = info;
+
+	retval->fn = oris_replay_file_name(uri);
+	if (!retval->fn || !oris_replay_set_params(retval, uri) ||
+			!oris_capture_reader_open(&retval->reader, retval->fn) ||
+			!oris_capture_reader_seek(&retval->reader, retval->start)) {
+		oris_log_f(LOG_ERR, "could not create replay connection '%s'", name);
+		oris_replay_connection_free((oris_connection_t*) retval);
+		return NULL;
+	}
+
+	retval->timer = evtimer_new(info->base, oris_replay_timer_cb, retval);
+	if (!retval->timer || bufferevent_pair_new(info->base,
+			BEV_OPT_CLOSE_ON_FREE | BEV_OPT_DEFER_CALLBACKS, retval->pair) != 0) {
+		oris_log_f(LOG_ERR, "could not create events for replay connection '%s'", name);
+		oris_replay_connection_free((oris_connection_t*) retval);
+		return NULL;
+	}
+
+	bufferevent_setcb(retval->pair[0], oris_replay_read_cb, NULL, NULL, retval);
+	bufferevent_enable(retval->pair[0], EV_READ | EV_WRITE);
+	bufferevent_enable(retval->pair[1], EV_READ | EV_WRITE);
+	retval->uri = uri;
+
+	/* start with the event loop */
+	event_active(retval->timer, EV_TIMEOUT, 0);
+
+	return (oris_connection_t*) retval;
+}
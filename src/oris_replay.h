@@ -0,0 +1,50 @@
+#ifndef __ORIS_REPLAY_H
+#define __ORIS_REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <event2/http.h>
+#include <event2/bufferevent.h>
+
+#include "oris_libevent.h"
+#include "oris_capture.h"
+#include "oris_connection.h"
+#include "oris_protocol.h"
+
+/* maximum number of bytes handed to the protocol before it gets a turn */
+#define ORIS_REPLAY_BATCH_SIZE (64 * 1024)
+
+/* a data connection fed from a capture (see --capture) instead of a socket,
+ * as configured by data+replay://file?speed=N. The protocol reads from one
+ * end of a bufferevent pair, the records are written into the other one at
+ * their captured pace times speed (speed=max: as fast as possible).
+ * Requests sent on the connection are discarded. */
+typedef struct oris_replay_connection {
+	oris_connection_t base;
+	struct evhttp_uri* uri;
+	oris_libevent_base_info_t* libevent_info;
+	struct bufferevent* pair[2];
+	struct event* timer;
+	oris_capture_reader_t reader;
+	char* fn;
+	/* replay parameters, speed 0 is as fast as possible */
+	double speed;
+	uint64_t start;
+	unsigned stream;
+	/* record read but not due yet */
+	oris_capture_record_t record;
+	bool has_record;
+	/* monotonic usec the replay started at and the capture time it started with */
+	uint64_t started;
+	uint64_t offset;
+	unsigned long records;
+} oris_replay_connection_t;
+
+/* create a connection replaying the capture named by the uri. uri is freed
+ * with the connection */
+oris_connection_t* oris_replay_connection_create(const char* name,
+		oris_protocol_t* protocol, struct evhttp_uri* uri,
+		oris_libevent_base_info_t* info);
+
+#endif /* __ORIS_REPLAY_H */
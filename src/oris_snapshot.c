@@ -0,0 +1,763 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define fsync _commit
+#define ftruncate _chsize
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#endif
+
+#include <sys/queue.h>
+#ifdef _WIN32
+#define STAILQ_ENTRY SIMPLEQ_ENTRY
+#define STAILQ_HEAD SIMPLEQ_HEAD
+#define STAILQ_FIRST SIMPLEQ_FIRST
+#define STAILQ_INIT SIMPLEQ_INIT
+#define STAILQ_EMPTY SIMPLEQ_EMPTY
+#define STAILQ_INSERT_TAIL SIMPLEQ_INSERT_TAIL
+#define STAILQ_REMOVE_HEAD(head, field) SIMPLEQ_REMOVE_HEAD(head, (head)->sqh_first, field)
+#endif
+
+#include <event2/event.h>
+#include <event2/util.h>
+
+#include "oris_snapshot.h"
+#include "oris_thread.h"
+#include "oris_util.h"
+#include "oris_log.h"
+
+#ifdef _WIN32
+#define NOTIFY_SOCKET_FAMILY AF_INET
+#else
+#define NOTIFY_SOCKET_FAMILY AF_UNIX
+#endif
+
+#define SNAPSHOT_TMP_SUFFIX ".tmp"
+#define WRITE_BUFFER_SIZE (64 * 1024)
+
+/* serialized table: the definition line followed by the table section */
+typedef struct oris_snapshot_image {
+	unsigned int refs;
+	size_t def_size;
+	size_t size;
+	char data[];
+} oris_snapshot_image_t;
+
+typedef struct oris_snapshot_cache_entry {
+	char* name;
+	unsigned int version;
+	oris_snapshot_image_t* image;
+} oris_snapshot_cache_entry_t;
+
+typedef enum { JOB_SNAPSHOT, JOB_APPEND, JOB_MOVE } oris_snapshot_job_type_t;
+
+typedef struct oris_snapshot_job {
+	oris_snapshot_job_type_t type;
+	char* fn;
+	/* snapshot: file to be removed afterwards, move: destination */
+	char* aux_fn;
+	oris_snapshot_image_t** images;
+	size_t image_count;
+	char* data;
+	size_t size;
+	bool success;
+	oris_snapshot_done_cb_t cb;
+	void* arg;
+	STAILQ_ENTRY(oris_snapshot_job) queue;
+} oris_snapshot_job_t;
+
+STAILQ_HEAD(oris_snapshot_job_list, oris_snapshot_job);
+
+static struct {
+	bool running;
+	bool stop;
+	oris_thread_t thread;
+	oris_mutex_t lock;
+	oris_cond_t cond;
+	/* signalled when the last pending job is done */
+	oris_cond_t idle;
+	bool busy;
+	struct oris_snapshot_job_list pending;
+	struct oris_snapshot_job_list done;
+	evutil_socket_t notify[2];
+	struct event* notify_event;
+	oris_fsync_policy_t fsync_policy;
+	/* writer thread only: file that records are appended to */
+	FILE* append_file;
+	char* append_fn;
+	/* event loop only: images of the last snapshot */
+	oris_snapshot_cache_entry_t* cache;
+	size_t cache_count;
+} writer;
+
+static char* strcat_dup(const char* a, const char* b)
+{
+	char* retval = malloc(strlen(a) + strlen(b) + 1);
+
+	if (retval) {
+		strcpy(retval, a);
+		strcat(retval, b);
+	}
+
+	return retval;
+}
+
+static void oris_snapshot_image_release(oris_snapshot_image_t* image)
+{
+	if (image && --image->refs == 0) {
+		free(image);
+	}
+}
+
+static oris_snapshot_image_t* oris_snapshot_image_create(oris_table_t* tbl)
+{
+	oris_snapshot_image_t* retval;
+	size_t size, name_len, def_size, section_size;
+	char *buf, *eol, *p;
+
+	buf = oris_table_serialize(tbl, &size);
+	if (!buf) {
+		return NULL;
+	}
+
+	eol = memchr(buf, '\n', size);
+	def_size = eol ? (size_t) (eol - buf) + 1 : size;
+	name_len = strlen(tbl->name);
+	/* [NAME]\n rows \n */
+	section_size = tbl->is_temporary ? 0 : name_len + 3 + (size - def_size) + 1;
+
+	retval = malloc(sizeof(*retval) + def_size + section_size);
+	if (retval) {
+		retval->refs = 1;
+		retval->def_size = def_size;
+		retval->size = def_size + section_size;
+
+		p = retval->data;
+		memcpy(p, buf, def_size);
+		p += def_size;
+		if (section_size > 0) {
+			*p++ = '[';
+			memcpy(p, tbl->name, name_len);
+			p += name_len;
+			*p++ = ']';
+			*p++ = '\n';
+			memcpy(p, buf + def_size, size - def_size);
+			p += size - def_size;
+			*p = '\n';
+		}
+	}
+
+	free(buf);
+
+	return retval;
+}
+
+static oris_snapshot_cache_entry_t* oris_snapshot_cache_find(const char* name,
+	size_t hint)
+{
+	size_t i;
+
+	if (hint < writer.cache_count && writer.cache[hint].name &&
+			strcmp(writer.cache[hint].name, name) == 0) {
+		return writer.cache + hint;
+	}
+
+	for (i = 0; i < writer.cache_count; i++) {
+		if (writer.cache[i].name && strcmp(writer.cache[i].name, name) == 0) {
+			return writer.cache + i;
+		}
+	}
+
+	return NULL;
+}
+
+static void oris_snapshot_cache_clear(oris_snapshot_cache_entry_t* cache, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		free(cache[i].name);
+		oris_snapshot_image_release(cache[i].image);
+	}
+
+	free(cache);
+}
+
+/* undo a partial view: drop the references taken for the job and the images
+ * created for it, images borrowed from the last snapshot stay there */
+static void oris_snapshot_view_abort(oris_snapshot_cache_entry_t* cache,
+	oris_snapshot_image_t** images, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		oris_snapshot_image_release(images[i]);
+		images[i] = NULL;
+		if (cache[i].name) {
+			free(cache[i].name);
+			oris_snapshot_image_release(cache[i].image);
+		}
+	}
+
+	free(cache);
+}
+
+/* take a copy-on-write view of the tables: only images of tables that changed
+ * since the last snapshot are rebuilt, all others are shared */
+static bool oris_snapshot_take_view(oris_table_list_t* tables,
+	oris_snapshot_image_t** images)
+{
+	oris_snapshot_cache_entry_t *cache, *entry;
+	oris_table_t* tbl;
+	size_t i;
+
+	cache = calloc(tables->count + 1, sizeof(*cache));
+	if (!cache) {
+		return false;
+	}
+
+	for (i = 0; i < tables->count; i++) {
+		tbl = tables->tables + i;
+		entry = oris_snapshot_cache_find(tbl->name, i);
+		if (entry && entry->version == tbl->version && entry->image) {
+			/* borrowed (no name yet), taken over once the view is complete */
+			cache[i].version = entry->version;
+			cache[i].image = entry->image;
+		} else {
+			cache[i].name = strdup(tbl->name);
+			cache[i].version = tbl->version;
+			cache[i].image = oris_snapshot_image_create(tbl);
+			if (!cache[i].name || !cache[i].image) {
+				free(cache[i].name);
+				oris_snapshot_image_release(cache[i].image);
+				oris_snapshot_view_abort(cache, images, i);
+				return false;
+			}
+		}
+
+		images[i] = cache[i].image;
+		images[i]->refs++;
+	}
+
+	for (i = 0; i < tables->count; i++) {
+		if (!cache[i].name) {
+			entry = oris_snapshot_cache_find(tables->tables[i].name, i);
+			cache[i].name = entry->name;
+			entry->name = NULL;
+			entry->image = NULL;
+		}
+	}
+
+	oris_snapshot_cache_clear(writer.cache, writer.cache_count);
+	writer.cache = cache;
+	writer.cache_count = tables->count;
+
+	return true;
+}
+
+static bool oris_snapshot_sync(FILE* f)
+{
+	if (fflush(f) != 0) {
+		return false;
+	}
+
+	return fsync(fileno(f)) == 0;
+}
+
+static void oris_snapshot_sync_dir(const char* fn)
+{
+#ifndef _WIN32
+	char* dir = strdup(fn);
+	char* p;
+	int fd;
+
+	if (!dir) {
+		return;
+	}
+
+	p = strrchr(dir, '/');
+	if (p) {
+		p[p == dir ? 1 : 0] = '\0';
+	} else {
+		strcpy(dir, ".");
+	}
+
+	fd = open(dir, O_RDONLY);
+	if (fd >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+
+	free(dir);
+#else
+	(void) fn;
+#endif
+}
+
+/* everything below up to the event callback runs on the writer thread */
+
+static bool oris_snapshot_write_file(oris_snapshot_job_t* job)
+{
+	char* tmp_fn;
+	FILE* f;
+	size_t i;
+	bool ok;
+
+	tmp_fn = strcat_dup(job->fn, SNAPSHOT_TMP_SUFFIX);
+	if (!tmp_fn) {
+		return false;
+	}
+
+	f = fopen(tmp_fn, "wb");
+	if (!f) {
+		free(tmp_fn);
+		return false;
+	}
+
+	setvbuf(f, NULL, _IOFBF, WRITE_BUFFER_SIZE);
+
+	ok = fputs("[Definition]\n", f) >= 0;
+	for (i = 0; ok && i < job->image_count; i++) {
+		ok = fwrite(job->images[i]->data, 1, job->images[i]->def_size, f) ==
+			job->images[i]->def_size;
+		job->size += job->images[i]->def_size;
+	}
+
+	ok = ok && fputc('\n', f) != EOF;
+	for (i = 0; ok && i < job->image_count; i++) {
+		ok = fwrite(job->images[i]->data + job->images[i]->def_size, 1,
+				job->images[i]->size - job->images[i]->def_size, f) ==
+			job->images[i]->size - job->images[i]->def_size;
+		job->size += job->images[i]->size - job->images[i]->def_size;
+	}
+
+	if (ok && writer.fsync_policy != ORIS_FSYNC_NONE) {
+		ok = oris_snapshot_sync(f);
+	}
+
+	ok = fclose(f) == 0 && ok;
+
+#ifdef _WIN32
+	if (ok) {
+		remove(job->fn);
+	}
+#endif
+	ok = ok && rename(tmp_fn, job->fn) == 0;
+	if (!ok) {
+		remove(tmp_fn);
+	} else if (writer.fsync_policy != ORIS_FSYNC_NONE) {
+		oris_snapshot_sync_dir(job->fn);
+	}
+
+	free(tmp_fn);
+
+	if (ok && job->aux_fn) {
+		remove(job->aux_fn);
+	}
+
+	return ok;
+}
+
+static void oris_snapshot_close_append_file(void)
+{
+	if (writer.append_file) {
+		fclose(writer.append_file);
+		writer.append_file = NULL;
+	}
+
+	oris_free_and_null(writer.append_fn);
+}
+
+static bool oris_snapshot_append_file(oris_snapshot_job_t* job)
+{
+	bool ok;
+
+	if (!writer.append_fn || strcmp(writer.append_fn, job->fn) != 0) {
+		oris_snapshot_close_append_file();
+		writer.append_file = fopen(job->fn, "ab");
+		if (!writer.append_file) {
+			return false;
+		}
+		writer.append_fn = strdup(job->fn);
+	}
+
+	ok = fwrite(job->data, 1, job->size, writer.append_file) == job->size &&
+		fflush(writer.append_file) == 0;
+
+	if (ok && writer.fsync_policy == ORIS_FSYNC_ALWAYS) {
+		ok = oris_snapshot_sync(writer.append_file);
+	}
+
+	if (!ok) {
+		oris_snapshot_close_append_file();
+	}
+
+	return ok;
+}
+
+/* append fn to an existing aux_fn and remove it, aux_fn is truncated to its
+ * former size if that fails */
+static bool oris_snapshot_concat_file(oris_snapshot_job_t* job)
+{
+	char buf[8192];
+	FILE *in, *out;
+	long start = -1;
+	size_t n;
+	bool ok;
+
+	in = fopen(job->fn, "rb");
+	if (!in) {
+		return errno == ENOENT;
+	}
+
+	out = fopen(job->aux_fn, "ab");
+	if (!out) {
+		fclose(in);
+		return false;
+	}
+
+	ok = fseek(out, 0, SEEK_END) == 0 && (start = ftell(out)) >= 0;
+	while (ok && (n = fread(buf, 1, sizeof(buf), in)) > 0) {
+		ok = fwrite(buf, 1, n, out) == n;
+	}
+	ok = ok && !ferror(in) && fflush(out) == 0;
+
+	if (ok && writer.fsync_policy == ORIS_FSYNC_ALWAYS) {
+		ok = oris_snapshot_sync(out);
+	}
+
+	if (!ok && start >= 0) {
+		fflush(out);
+		if (ftruncate(fileno(out), start) != 0) {
+			oris_log_f(LOG_ERR, "could not truncate %s after a failed append",
+				job->aux_fn);
+		}
+	}
+
+	ok = fclose(out) == 0 && ok;
+	fclose(in);
+
+	return ok && remove(job->fn) == 0;
+}
+
+static bool oris_snapshot_move_file(oris_snapshot_job_t* job)
+{
+	FILE* f;
+
+	if (writer.append_fn && (strcmp(writer.append_fn, job->fn) == 0 ||
+			strcmp(writer.append_fn, job->aux_fn) == 0)) {
+		oris_snapshot_close_append_file();
+	}
+
+	/* the destination is still there if the snapshot that should have made
+	 * it obsolete failed, its content must be kept */
+	f = fopen(job->aux_fn, "rb");
+	if (f) {
+		fclose(f);
+		return oris_snapshot_concat_file(job);
+	}
+
+	return rename(job->fn, job->aux_fn) == 0 || errno == ENOENT;
+}
+
+static void oris_snapshot_run_job(oris_snapshot_job_t* job)
+{
+	switch (job->type) {
+		case JOB_SNAPSHOT:
+			job->success = oris_snapshot_write_file(job);
+			break;
+		case JOB_APPEND:
+			job->success = oris_snapshot_append_file(job);
+			break;
+		case JOB_MOVE:
+			job->success = oris_snapshot_move_file(job);
+			break;
+	}
+}
+
+static oris_thread_result_t ORIS_THREAD_CALL oris_snapshot_writer(void* arg)
+{
+	oris_snapshot_job_t* job;
+	char c = 0;
+
+	oris_mutex_lock(&writer.lock);
+	for (;;) {
+		while (STAILQ_EMPTY(&writer.pending) && !writer.stop) {
+			oris_cond_wait(&writer.cond, &writer.lock);
+		}
+
+		if (STAILQ_EMPTY(&writer.pending)) {
+			break;
+		}
+
+		job = STAILQ_FIRST(&writer.pending);
+		STAILQ_REMOVE_HEAD(&writer.pending, queue);
+		writer.busy = true;
+		oris_mutex_unlock(&writer.lock);
+
+		oris_snapshot_run_job(job);
+
+		oris_mutex_lock(&writer.lock);
+		STAILQ_INSERT_TAIL(&writer.done, job, queue);
+		writer.busy = false;
+		if (STAILQ_EMPTY(&writer.pending)) {
+			oris_cond_broadcast(&writer.idle);
+		}
+		if (!writer.stop) {
+			send(writer.notify[1], &c, sizeof(c), 0);
+		}
+	}
+	oris_mutex_unlock(&writer.lock);
+
+	oris_snapshot_close_append_file();
+
+	(void) arg;
+	return 0;
+}
+
+/* event loop side */
+
+static void oris_snapshot_job_free(oris_snapshot_job_t* job)
+{
+	size_t i;
+
+	for (i = 0; i < job->image_count; i++) {
+		oris_snapshot_image_release(job->images[i]);
+	}
+
+	free(job->images);
+	free(job->data);
+	free(job->fn);
+	free(job->aux_fn);
+	free(job);
+}
+
+static void oris_snapshot_process_done(bool notify)
+{
+	oris_snapshot_job_t* job;
+
+	oris_mutex_lock(&writer.lock);
+	while (!STAILQ_EMPTY(&writer.done)) {
+		job = STAILQ_FIRST(&writer.done);
+		STAILQ_REMOVE_HEAD(&writer.done, queue);
+		oris_mutex_unlock(&writer.lock);
+
+		if (!job->success) {
+			oris_log_f(LOG_ERR, "background write to %s failed", job->fn);
+		} else if (job->type == JOB_SNAPSHOT) {
+			oris_log_f(LOG_DEBUG, "snapshot %s written (%lu bytes)", job->fn,
+				(unsigned long) job->size);
+		}
+
+		if (notify && job->cb) {
+			job->cb(job->fn, job->success, job->size, job->arg);
+		}
+
+		oris_snapshot_job_free(job);
+		oris_mutex_lock(&writer.lock);
+	}
+	oris_mutex_unlock(&writer.lock);
+}
+
+static void oris_snapshot_notify_cb(evutil_socket_t fd, short what, void* arg)
+{
+	char buf[64];
+
+	while (recv(fd, buf, sizeof(buf), 0) > 0) ;
+
+	oris_snapshot_process_done(true);
+
+	(void) what;
+	(void) arg;
+}
+
+static bool oris_snapshot_enqueue(oris_snapshot_job_t* job)
+{
+	if (!writer.running) {
+		oris_snapshot_job_free(job);
+		return false;
+	}
+
+	oris_mutex_lock(&writer.lock);
+	STAILQ_INSERT_TAIL(&writer.pending, job, queue);
+	oris_cond_signal(&writer.cond);
+	oris_mutex_unlock(&writer.lock);
+
+	return true;
+}
+
+bool oris_snapshot_init(struct event_base* base, oris_fsync_policy_t policy)
+{
+	memset(&writer, 0, sizeof(writer));
+	STAILQ_INIT(&writer.pending);
+	STAILQ_INIT(&writer.done);
+	writer.fsync_policy = policy;
+
+	if (evutil_socketpair(NOTIFY_SOCKET_FAMILY, SOCK_STREAM, 0, writer.notify) != 0) {
+		oris_log_f(LOG_ERR, "could not create notification socket for snapshot writer");
+		return false;
+	}
+
+	evutil_make_socket_nonblocking(writer.notify[0]);
+	evutil_make_socket_nonblocking(writer.notify[1]);
+
+	writer.notify_event = event_new(base, writer.notify[0], EV_READ | EV_PERSIST,
+		oris_snapshot_notify_cb, NULL);
+	if (!writer.notify_event || event_add(writer.notify_event, NULL) != 0) {
+		oris_log_f(LOG_ERR, "could not create notification event for snapshot writer");
+		return false;
+	}
+
+	oris_mutex_init(&writer.lock);
+	oris_cond_init(&writer.cond);
+	oris_cond_init(&writer.idle);
+
+	writer.running = oris_thread_create(&writer.thread, oris_snapshot_writer, NULL);
+	if (!writer.running) {
+		oris_log_f(LOG_ERR, "could not start snapshot writer thread");
+	}
+
+	return writer.running;
+}
+
+void oris_snapshot_wait(void)
+{
+	if (!writer.running) {
+		return;
+	}
+
+	oris_mutex_lock(&writer.lock);
+	while (!STAILQ_EMPTY(&writer.pending) || writer.busy) {
+		oris_cond_wait(&writer.idle, &writer.lock);
+	}
+	oris_mutex_unlock(&writer.lock);
+
+	oris_snapshot_process_done(true);
+}
+
+void oris_snapshot_finalize(void)
+{
+	/* report what is still queued, e.g. a dump requested by a client */
+	oris_snapshot_wait();
+
+	if (writer.running) {
+		oris_mutex_lock(&writer.lock);
+		writer.stop = true;
+		oris_cond_signal(&writer.cond);
+		oris_mutex_unlock(&writer.lock);
+
+		oris_thread_join(writer.thread);
+		writer.running = false;
+
+		/* jobs queued by the callbacks above, the writer is gone now */
+		oris_snapshot_process_done(false);
+
+		oris_cond_destroy(&writer.idle);
+		oris_cond_destroy(&writer.cond);
+		oris_mutex_destroy(&writer.lock);
+	}
+
+	if (writer.notify_event) {
+		event_free(writer.notify_event);
+		writer.notify_event = NULL;
+		evutil_closesocket(writer.notify[0]);
+		evutil_closesocket(writer.notify[1]);
+	}
+
+	oris_snapshot_cache_clear(writer.cache, writer.cache_count);
+	writer.cache = NULL;
+	writer.cache_count = 0;
+}
+
+bool oris_snapshot_parse_fsync_policy(const char* s, oris_fsync_policy_t* policy)
+{
+	if (strcmp(s, "none") == 0) {
+		*policy = ORIS_FSYNC_NONE;
+	} else if (strcmp(s, "snapshot") == 0) {
+		*policy = ORIS_FSYNC_SNAPSHOT;
+	} else if (strcmp(s, "always") == 0) {
+		*policy = ORIS_FSYNC_ALWAYS;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+bool oris_snapshot_write_tables(oris_table_list_t* tables, const char* fn,
+	const char* obsolete_fn, oris_snapshot_done_cb_t cb, void* arg)
+{
+	oris_snapshot_job_t* job = calloc(1, sizeof(*job));
+
+	if (!job) {
+		return false;
+	}
+
+	job->type = JOB_SNAPSHOT;
+	job->cb = cb;
+	job->arg = arg;
+	job->fn = strdup(fn);
+	job->aux_fn = obsolete_fn ? strdup(obsolete_fn) : NULL;
+	job->images = calloc(tables->count + 1, sizeof(*job->images));
+
+	if (!job->fn || (obsolete_fn && !job->aux_fn) || !job->images ||
+			!oris_snapshot_take_view(tables, job->images)) {
+		oris_snapshot_job_free(job);
+		return false;
+	}
+	job->image_count = tables->count;
+
+	return oris_snapshot_enqueue(job);
+}
+
+bool oris_snapshot_append(const char* fn, char* data, size_t size)
+{
+	oris_snapshot_job_t* job = calloc(1, sizeof(*job));
+
+	if (!job) {
+		free(data);
+		return false;
+	}
+
+	job->type = JOB_APPEND;
+	job->fn = strdup(fn);
+	job->data = data;
+	job->size = size;
+
+	if (!job->fn) {
+		oris_snapshot_job_free(job);
+		return false;
+	}
+
+	return oris_snapshot_enqueue(job);
+}
+
+bool oris_snapshot_move(const char* from, const char* to)
+{
+	oris_snapshot_job_t* job = calloc(1, sizeof(*job));
+
+	if (!job) {
+		return false;
+	}
+
+	job->type = JOB_MOVE;
+	job->fn = strdup(from);
+	job->aux_fn = strdup(to);
+
+	if (!job->fn || !job->aux_fn) {
+		oris_snapshot_job_free(job);
+		return false;
+	}
+
+	return oris_snapshot_enqueue(job);
+}
@@ -0,0 +1,50 @@
+#ifndef __ORIS_SNAPSHOT_H
+#define __ORIS_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <event2/event.h>
+
+#include "oris_table.h"
+
+/* background writer for table snapshots and journal records
+ *
+ * The event loop serializes the tables into per-table images which are cached
+ * until the table changes, so taking a snapshot only copies modified tables.
+ * A dedicated thread does the actual (buffered) I/O, writes snapshots to a
+ * temporary file and renames it atomically. Completion is reported back on
+ * the event loop. */
+
+typedef enum {
+	ORIS_FSYNC_NONE,     /* leave flushing to the operating system */
+	ORIS_FSYNC_SNAPSHOT, /* sync snapshots before they replace the old one */
+	ORIS_FSYNC_ALWAYS    /* sync snapshots and every appended record */
+} oris_fsync_policy_t;
+
+/* called on the event loop when a snapshot was written (or failed) */
+typedef void (*oris_snapshot_done_cb_t)(const char* fn, bool success,
+	size_t size, void* arg);
+
+bool oris_snapshot_init(struct event_base* base, oris_fsync_policy_t policy);
+void oris_snapshot_finalize(void);
+
+/* block until all queued jobs are written and run their callbacks (which
+ * may queue further jobs) */
+void oris_snapshot_wait(void);
+
+bool oris_snapshot_parse_fsync_policy(const char* s, oris_fsync_policy_t* policy);
+
+/* write all tables to fn in the dump file format; obsolete_fn (may be NULL)
+ * is removed once the snapshot is in place */
+bool oris_snapshot_write_tables(oris_table_list_t* tables, const char* fn,
+	const char* obsolete_fn, oris_snapshot_done_cb_t cb, void* arg);
+
+/* append data to fn (takes ownership of data) */
+bool oris_snapshot_append(const char* fn, char* data, size_t size);
+
+/* rename a file after all previously queued jobs are done. If to exists, the
+ * content of from is appended to it instead. */
+bool oris_snapshot_move(const char* from, const char* to);
+
+#endif /* __ORIS_SNAPSHOT_H */
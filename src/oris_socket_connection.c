@@ -17,6 +17,9 @@
 #include "oris_connection.h"
 #include "oris_socket_connection.h"
 #include "oris_protocol.h"
+#include "oris_metrics.h"
+#include "oris_protocol_data.h"
+#include "oris_replay.h"
 
 #define MAX_LINE_SIZE 4096
 
@@ -73,6 +76,27 @@ static void oris_connection_read_cb(struct bufferevent *bev, void *ptr)
 	}
 }
 
+static void oris_connection_count_in(struct evbuffer* buffer,
+	const struct evbuffer_cb_info* info, void* arg)
+{
+	((oris_connection_t*) arg)->bytesIn += info->n_added;
+	(void) buffer;
+}
+
+static void oris_connection_count_out(struct evbuffer* buffer,
+	const struct evbuffer_cb_info* info, void* arg)
+{
+	((oris_connection_t*) arg)->bytesOut += info->n_deleted;
+	(void) buffer;
+}
+
+/* account the traffic of the bufferevent to the connection */
+static void oris_connection_count_bytes(struct bufferevent* bev, oris_connection_t* connection)
+{
+	evbuffer_add_cb(bufferevent_get_input(bev), oris_connection_count_in, connection);
+	evbuffer_add_cb(bufferevent_get_output(bev), oris_connection_count_out, connection);
+}
+
 static void oris_create_client_socket(oris_socket_connection_t* connection)
 {
 	if (connection->bufev) {
@@ -85,6 +109,7 @@ static void oris_create_client_socket(oris_socket_connection_t* connection)
 
 	bufferevent_setcb(connection->bufev, oris_connection_read_cb, NULL,
 			oris_connection_event_cb, connection);
+	oris_connection_count_bytes(connection->bufev, (oris_connection_t*) connection);
 	bufferevent_enable(connection->bufev, EV_READ | EV_WRITE);
 	bufferevent_socket_connect_hostname(connection->bufev,
 		connection->libevent_info->dns_base, AF_UNSPEC,
@@ -299,6 +324,7 @@ static void oris_server_connection_do_accept(evutil_socket_t listener, short eve
 		bufferevent_setcb(bev, ((oris_connection_t*) connection)->protocol->read_cb,
 				NULL, oris_server_socket_event_cb, connection);
 		bufferevent_setwatermark(bev, EV_READ, 0, MAX_LINE_SIZE);
+		oris_connection_count_bytes(bev, (oris_connection_t*) connection);
 		bufferevent_enable(bev, EV_READ | EV_WRITE);
 		if (((oris_connection_t*) connection)->protocol->connected_cb) {
 		/*	((oris_connection_t*) connection)->protocol->connected_cb(((oris_connection_t*) connection)->protocol);*/
@@ -336,7 +362,19 @@ oris_connection_t* oris_create_connection_from_uri(struct evhttp_uri* uri,
 			retval->protocol = protocol;
 		}
 	} else if (strcmp(scheme, "data") == 0) {
+		oris_protocol_data_set_params(protocol, uri);
 		retval = (oris_connection_t*) oris_socket_connection_create(connection_name, protocol, uri, data);
+	} else if (strcmp(scheme, "data+replay") == 0) {
+		/* frees the protocol on failure */
+		oris_protocol_data_set_params(protocol, uri);
+		retval = oris_replay_connection_create(connection_name, protocol, uri, data);
+	} else if (strcmp(scheme, "metrics") == 0) {
+		retval = oris_metrics_connection_create(connection_name, uri, data);
+		if (retval) {
+			retval->protocol = protocol;
+		} else {
+			protocol->destroy(protocol);
+		}
 	}
 
 	return retval;
@@ -0,0 +1,340 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "zlib.h"
+
+#include "oris_storage.h"
+#include "oris_snapshot.h"
+#include "oris_util.h"
+#include "oris_log.h"
+
+#define JOURNAL_SUFFIX ".journal"
+#define PREV_JOURNAL_SUFFIX ".journal.prev"
+#define SNAPSHOT_TMP_SUFFIX ".tmp"
+
+/* record header: payload length and crc32 of the payload (big endian) */
+#define RECORD_HEADER_SIZE 8
+
+/* compact the journal into a new snapshot after that many records/bytes */
+#define COMPACT_RECORDS 1024
+#define COMPACT_BYTES (8 * 1024 * 1024)
+
+static void put_u32(unsigned char* p, uint32_t v)
+{
+	p[0] = (unsigned char) (v >> 24);
+	p[1] = (unsigned char) (v >> 16);
+	p[2] = (unsigned char) (v >> 8);
+	p[3] = (unsigned char) v;
+}
+
+static uint32_t get_u32(const unsigned char* p)
+{
+	return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+		((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+static char* strcat_dup(const char* a, const char* b)
+{
+	char* retval = malloc(strlen(a) + strlen(b) + 1);
+
+	if (retval) {
+		strcpy(retval, a);
+		strcat(retval, b);
+	}
+
+	return retval;
+}
+
+static bool file_exists(const char* fn)
+{
+	FILE* f = fopen(fn, "r");
+
+	if (f) {
+		fclose(f);
+	}
+
+	return f != NULL;
+}
+
+/* all tables are in the snapshot (or the journal) as they are now */
+static void oris_storage_mark_stored(oris_storage_t* storage)
+{
+	size_t i;
+
+	for (i = 0; i < storage->tables->count; i++) {
+		storage->tables->tables[i].stored_version = storage->tables->tables[i].version;
+	}
+}
+
+bool oris_storage_init(oris_storage_t* storage, oris_table_list_t* tables,
+	const char* fn, bool journaled)
+{
+	memset(storage, 0, sizeof(*storage));
+
+	storage->tables = tables;
+	storage->fn = strdup(fn);
+	storage->journaled = journaled;
+	if (!storage->fn) {
+		return false;
+	}
+
+	if (journaled) {
+		storage->journal_fn = strcat_dup(fn, JOURNAL_SUFFIX);
+		storage->prev_journal_fn = strcat_dup(fn, PREV_JOURNAL_SUFFIX);
+		if (!storage->journal_fn || !storage->prev_journal_fn) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void oris_storage_finalize(oris_storage_t* storage)
+{
+	/* let a running snapshot complete, its callback writes the changes made
+	 * meanwhile */
+	while (storage->snapshot_pending) {
+		oris_snapshot_wait();
+	}
+
+	if (storage->records > 0 || storage->dirty) {
+		oris_storage_compact(storage);
+		while (storage->snapshot_pending) {
+			oris_snapshot_wait();
+		}
+	}
+
+	oris_free_and_null(storage->fn);
+	oris_free_and_null(storage->journal_fn);
+	oris_free_and_null(storage->prev_journal_fn);
+}
+
+static size_t oris_storage_replay_journal(oris_storage_t* storage,
+	const char* fn, bool* clean)
+{
+	unsigned char header[RECORD_HEADER_SIZE];
+	char* payload;
+	uint32_t size;
+	size_t retval = 0;
+	FILE* f;
+
+	f = fopen(fn, "rb");
+	if (!f) {
+		return 0;
+	}
+
+	while (fread(header, sizeof(header), 1, f) == 1) {
+		size = get_u32(header);
+		payload = malloc(size + 1);
+		if (!payload) {
+			*clean = false;
+			break;
+		}
+
+		if (fread(payload, 1, size, f) != size ||
+				crc32(0L, (const Bytef*) payload, size) != get_u32(header + 4)) {
+			/* torn write at the end of the journal (or garbage) */
+			oris_log_f(LOG_WARNING, "discarding incomplete journal record %d in %s",
+				(int) retval + 1, fn);
+			free(payload);
+			*clean = false;
+			break;
+		}
+
+		payload[size] = '\0';
+		if (!oris_tables_restore_table(storage->tables, payload, size)) {
+			oris_log_f(LOG_WARNING, "invalid journal record %d in %s",
+				(int) retval + 1, fn);
+		}
+		free(payload);
+		retval++;
+	}
+
+	if (!feof(f)) {
+		*clean = false;
+	}
+
+	fclose(f);
+
+	oris_log_f(LOG_INFO, "replayed %d journal records from %s", (int) retval, fn);
+
+	return retval;
+}
+
+void oris_storage_restore(oris_storage_t* storage)
+{
+	char* tmp_fn;
+	size_t n;
+	bool clean = true, retval;
+
+	if (!storage->journaled) {
+		return;
+	}
+
+	if (file_exists(storage->fn)) {
+		oris_tables_load_from_file(storage->tables, storage->fn);
+	}
+
+	/* a journal left over by an interrupted compaction comes first */
+	n = oris_storage_replay_journal(storage, storage->prev_journal_fn, &clean);
+	n += oris_storage_replay_journal(storage, storage->journal_fn, &clean);
+
+	oris_storage_mark_stored(storage);
+
+	if (n == 0 && clean) {
+		return;
+	}
+
+	/* fold replayed records into the snapshot (also drops a damaged tail). This
+	 * happens before the event loop runs, so there is no need to defer it. */
+	tmp_fn = strcat_dup(storage->fn, SNAPSHOT_TMP_SUFFIX);
+	retval = tmp_fn && oris_tables_dump_to_file(storage->tables, tmp_fn);
+#ifdef _WIN32
+	if (retval) {
+		remove(storage->fn);
+	}
+#endif
+	retval = retval && rename(tmp_fn, storage->fn) == 0;
+	free(tmp_fn);
+
+	if (retval) {
+		remove(storage->prev_journal_fn);
+		remove(storage->journal_fn);
+	} else {
+		oris_log_f(LOG_ERR, "could not compact journal into %s: %s", storage->fn,
+			strerror(errno));
+	}
+}
+
+static void oris_storage_snapshot_done(const char* fn, bool success, size_t size,
+	void* arg)
+{
+	oris_storage_t* storage = arg;
+
+	storage->snapshot_pending = false;
+	if (!success) {
+		/* the journal is kept, try again on the next save */
+		oris_log_f(LOG_ERR, "could not store data tables in %s", fn);
+		storage->dirty = true;
+		return;
+	}
+
+	oris_log_f(LOG_DEBUG, "stored data tables in %s (%lu bytes)", fn,
+		(unsigned long) size);
+
+	if (storage->dirty) {
+		oris_storage_compact(storage);
+	}
+}
+
+static bool oris_storage_append(oris_storage_t* storage, oris_table_t* tbl)
+{
+	char *payload, *record;
+	size_t size;
+
+	payload = oris_table_serialize(tbl, &size);
+	if (!payload) {
+		oris_log_f(LOG_ERR, "could not serialize table %s", tbl->name);
+		return false;
+	}
+
+	record = malloc(RECORD_HEADER_SIZE + size);
+	if (!record) {
+		free(payload);
+		return false;
+	}
+
+	put_u32((unsigned char*) record, (uint32_t) size);
+	put_u32((unsigned char*) record + 4,
+		(uint32_t) crc32(0L, (const Bytef*) payload, (uInt) size));
+	memcpy(record + RECORD_HEADER_SIZE, payload, size);
+	free(payload);
+
+	if (!oris_snapshot_append(storage->journal_fn, record, RECORD_HEADER_SIZE + size)) {
+		oris_log_f(LOG_ERR, "could not append table %s to journal %s",
+			tbl->name, storage->journal_fn);
+		return false;
+	}
+
+	storage->records++;
+	storage->bytes += RECORD_HEADER_SIZE + size;
+
+	return true;
+}
+
+bool oris_storage_save(oris_storage_t* storage)
+{
+	oris_table_t* tbl;
+	size_t i;
+	bool retval = true;
+
+	if (!storage->journaled) {
+		return oris_storage_compact(storage);
+	}
+
+	for (i = 0; i < storage->tables->count; i++) {
+		tbl = storage->tables->tables + i;
+		if (tbl->is_temporary || tbl->version == tbl->stored_version) {
+			continue;
+		}
+
+		if (oris_storage_append(storage, tbl)) {
+			tbl->stored_version = tbl->version;
+		} else {
+			retval = false;
+		}
+	}
+
+	if (!retval) {
+		return false;
+	}
+
+	if (!storage->snapshot_pending && (storage->dirty ||
+			storage->records >= COMPACT_RECORDS || storage->bytes >= COMPACT_BYTES)) {
+		return oris_storage_compact(storage);
+	}
+
+	return true;
+}
+
+bool oris_storage_compact(oris_storage_t* storage)
+{
+	/* coalesce: write again once the pending snapshot is done */
+	if (storage->snapshot_pending) {
+		storage->dirty = true;
+		return true;
+	}
+
+	storage->dirty = false;
+
+	if (storage->journaled) {
+		oris_log_f(LOG_DEBUG, "compacting %d journal records into %s",
+			(int) storage->records, storage->fn);
+
+		/* records appended from now on go to a fresh journal, the current one
+		 * is kept until the snapshot containing its records is in place. It
+		 * is appended to the previous one if that is still there because its
+		 * snapshot failed. */
+		if (!oris_snapshot_move(storage->journal_fn, storage->prev_journal_fn)) {
+			return false;
+		}
+
+		storage->records = 0;
+		storage->bytes = 0;
+	}
+
+	storage->snapshot_pending = oris_snapshot_write_tables(storage->tables,
+		storage->fn, storage->prev_journal_fn, oris_storage_snapshot_done, storage);
+	if (storage->snapshot_pending) {
+		oris_storage_mark_stored(storage);
+	}
+
+	return storage->snapshot_pending;
+}
@@ -0,0 +1,41 @@
+#ifndef __ORIS_STORAGE_H
+#define __ORIS_STORAGE_H
+
+#include <stdbool.h>
+
+#include "oris_table.h"
+
+/* persistence of the data tables: either a full dump of all tables on every
+ * change or a snapshot file plus an append-only journal of completed tables.
+ * All disk I/O is done by the background snapshot writer. */
+typedef struct oris_storage {
+	oris_table_list_t* tables;
+	char* fn;
+	char* journal_fn;
+	/* journal being compacted into the current snapshot */
+	char* prev_journal_fn;
+	bool journaled;
+	/* records/bytes appended since the last compaction */
+	size_t records;
+	size_t bytes;
+	/* a snapshot is queued or being written */
+	bool snapshot_pending;
+	/* tables changed while the snapshot was pending or the last one failed */
+	bool dirty;
+} oris_storage_t;
+
+bool oris_storage_init(oris_storage_t* storage, oris_table_list_t* tables,
+	const char* fn, bool journaled);
+void oris_storage_finalize(oris_storage_t* storage);
+
+/* load snapshot and replay the journal(s) (journaled storage only) */
+void oris_storage_restore(oris_storage_t* storage);
+
+/* persist all tables changed since the last save, i.e. the received table as
+ * well as those created or modified by automation */
+bool oris_storage_save(oris_storage_t* storage);
+
+/* write a new snapshot and start over with an empty journal */
+bool oris_storage_compact(oris_storage_t* storage);
+
+#endif /* __ORIS_STORAGE_H */
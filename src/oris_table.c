@@ -3,6 +3,8 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
 #include <errno.h>
@@ -20,57 +22,111 @@
 
 #define DUMP_DELIM ';'
 
-bool oris_table_add_row(oris_table_t* tbl, const char* s, char delim)
+/* rebuild the arenas of a table modified in place once more than half of
+ * them and at least that many bytes are no longer used */
+#define COMPACT_MIN_WASTED 4096
+
+static bool oris_table_grow_field_names(oris_table_t* tbl, int field_count)
 {
-	char *buf, *ptr;
 	int i;
 
-	if (!oris_safe_realloc((void**) &(tbl->rows), tbl->row_count + 1, sizeof(*(tbl->rows)))) {
+	if (tbl->fields.field_count >= field_count) {
+		return true;
+	}
+
+	if (!oris_safe_realloc((void**) &tbl->fields.fields, field_count,
+			sizeof(*tbl->fields.fields))) {
+		return false;
+	}
+
+	for (i = tbl->fields.field_count; i < field_count; i++) {
+		tbl->fields.fields[i] = NULL;
+	}
+
+	tbl->fields.field_count = field_count;
+
+	return true;
+}
+
+static bool oris_table_reserve_rows(oris_table_t* tbl, int count)
+{
+	int capacity;
+
+	if (count <= tbl->row_capacity) {
+		return true;
+	}
+
+	capacity = tbl->row_capacity ? tbl->row_capacity : 16;
+	while (capacity < count) {
+		capacity *= 2;
+	}
+
+	if (!oris_safe_realloc((void**) &(tbl->rows), capacity, sizeof(*(tbl->rows)))) {
 		return false;
 	}
 
-	buf = strdup(s);
-	if (buf == NULL) {
+	tbl->row_capacity = capacity;
+
+	return true;
+}
+
+bool oris_table_add_row_n(oris_table_t* tbl, const char* s, size_t len, char delim)
+{
+	oris_table_row_t* row;
+	size_t data, offsets, *offset;
+	char *buf, *end;
+	int field_count = 1;
+	const char* ptr;
+
+	if (!oris_table_reserve_rows(tbl, tbl->row_count + 1)) {
 		return false;
 	}
 
-	tbl->rows[tbl->row_count].field_count = 1;
-	for (ptr = buf; *ptr; ptr++) {
+	for (ptr = s; ptr < s + len; ptr++) {
 		if (*ptr == delim) {
-			tbl->rows[tbl->row_count].field_count++;
-			*ptr = '\0';
+			field_count++;
 		}
 	}
 
-	ptr = buf;
-	tbl->rows[tbl->row_count].fields = calloc(tbl->rows[tbl->row_count].field_count,
-			sizeof(*tbl->rows[tbl->row_count].fields));
-	for (i = 0; i < tbl->rows[tbl->row_count].field_count; i++) {
-		tbl->rows[tbl->row_count].fields[i] = strdup(ptr);
-		ptr += strlen(ptr) + 1;
+	data = oris_arena_alloc(&tbl->data, len + 1);
+	offsets = oris_arena_alloc(&tbl->offsets, field_count * sizeof(size_t));
+	if (data == ORIS_ARENA_INVALID || offsets == ORIS_ARENA_INVALID) {
+		return false;
 	}
 
-	free(buf);
-
-	if (tbl->fields.field_count < tbl->rows[tbl->row_count].field_count) {
-		if (!oris_safe_realloc((void**) &tbl->fields.fields,
-					tbl->rows[tbl->row_count].field_count,
-					sizeof(*tbl->fields.fields))) {
-			return false;
-		}
+	/* copy the line at once and split it in place */
+	buf = oris_arena_at(&tbl->data, data);
+	memcpy(buf, s, len);
+	buf[len] = '\0';
 
-		for (i = tbl->fields.field_count; i < tbl->rows[tbl->row_count].field_count; i++) {
-			tbl->fields.fields[i] = NULL;
+	offset = (size_t*) oris_arena_at(&tbl->offsets, offsets);
+	*offset++ = data;
+	for (end = buf + len; buf < end; buf++) {
+		if (*buf == delim) {
+			*buf = '\0';
+			*offset++ = data + (buf - oris_arena_at(&tbl->data, data)) + 1;
 		}
+	}
 
-		tbl->fields.field_count = tbl->rows[tbl->row_count].field_count;
+	if (!oris_table_grow_field_names(tbl, field_count)) {
+		return false;
 	}
 
+	row = &tbl->rows[tbl->row_count];
+	row->first = offsets / sizeof(size_t);
+	row->field_count = field_count;
+
 	tbl->row_count++;
+	tbl->version++;
 
 	return true;
 }
 
+bool oris_table_add_row(oris_table_t* tbl, const char* s, char delim)
+{
+	return oris_table_add_row_n(tbl, s, strlen(s), delim);
+}
+
 
 void oris_table_init(oris_table_t* tbl)
 {
@@ -83,57 +139,56 @@ void oris_table_init(oris_table_t* tbl)
 		tbl->fields.field_count = 0;
 		tbl->fields.fields = NULL;
 		tbl->is_temporary = false;
+		oris_arena_init(&tbl->data);
+		oris_arena_init(&tbl->offsets);
 	}
 }
 
-static void oris_table_clear_row(oris_table_row_t* row)
+static void oris_table_clear_fields(oris_table_fields_t* fields)
 {
 	int i;
 
-	for (i = 0; i< row->field_count; i++) {
-		oris_free_and_null(row->fields[i]);
+	for (i = 0; i< fields->field_count; i++) {
+		oris_free_and_null(fields->fields[i]);
 	}
 
-	row->field_count = 0;
-	oris_free_and_null(row->fields);
+	fields->field_count = 0;
+	oris_free_and_null(fields->fields);
 }
 
 void oris_table_clear(oris_table_t* tbl)
 {
-	int i;
+	oris_arena_reset(&tbl->data);
+	oris_arena_reset(&tbl->offsets);
 
-	for (i = 0; i < tbl->row_count; i++) {
-		oris_free_and_null(tbl->rows[i].fields);
-		tbl->rows[i].field_count = 0;
-	}
-
-	oris_table_clear_row(&tbl->fields);
+	oris_table_clear_fields(&tbl->fields);
+	tbl->wasted = 0;
 	tbl->row_count = 0;
 	tbl->current_row = -1;
+	tbl->version++;
 }
 
 void oris_table_finalize(oris_table_t* tbl)
 {
+	int i;
+
 	if (tbl) {
 		oris_table_clear(tbl);
 
 		free(tbl->name);
 		free(tbl->rows);
+		oris_arena_finalize(&tbl->data);
+		oris_arena_finalize(&tbl->offsets);
+
+		for (i = 0; i < tbl->lookup_count; i++) {
+			free(tbl->lookups[i].slots);
+		}
+		oris_free_and_null(tbl->lookups);
+		tbl->lookup_count = 0;
 
 		tbl->name = NULL;
 		tbl->rows = NULL;
-	}
-}
-
-static void oris_table_copy_row(oris_table_row_t* src, oris_table_row_t* dst)
-{
-	int i;
-
-	dst->field_count = src->field_count;
-	dst->fields = calloc(src->field_count, sizeof(*dst->fields));
-
-	for (i = 0; i < src->field_count; i++) {
-		dst->fields[i] = src->fields[i] ? strdup(src->fields[i]) : NULL;
+		tbl->row_capacity = 0;
 	}
 }
 
@@ -146,13 +201,27 @@ void oris_table_copy_to(oris_table_t* src, oris_table_t* dst)
 	}
 
 	oris_table_clear(dst);
-	oris_table_copy_row(&src->fields, &dst->fields);
 
-	dst->row_count = src->row_count;
-	dst->rows = calloc(dst->row_count, sizeof(*dst->rows));
-	for (i = 0; i < dst->row_count; i++) {
-		oris_table_copy_row(src->rows + i, dst->rows + i);
+	/* offsets stay valid, so the arenas and rows are copied as a whole */
+	if (!oris_table_grow_field_names(dst, src->fields.field_count) ||
+			!oris_table_reserve_rows(dst, src->row_count) ||
+			!oris_arena_copy(&src->data, &dst->data) ||
+			!oris_arena_copy(&src->offsets, &dst->offsets)) {
+		oris_log_f(LOG_ERR, "could not copy table %s to %s", src->name, dst->name);
+		oris_table_clear(dst);
+		return;
+	}
+
+	for (i = 0; i < src->fields.field_count; i++) {
+		dst->fields.fields[i] = src->fields.fields[i] ? strdup(src->fields.fields[i]) : NULL;
 	}
+
+	if (src->row_count > 0) {
+		memcpy(dst->rows, src->rows, src->row_count * sizeof(*src->rows));
+	}
+	dst->row_count = src->row_count;
+	dst->wasted = src->wasted;
+	dst->version++;
 }
 
 int oris_table_add_field(oris_table_t* tbl, const char* field_name)
@@ -162,6 +231,7 @@ int oris_table_add_field(oris_table_t* tbl, const char* field_name)
 	}
 
 	tbl->fields.fields[tbl->fields.field_count - 1] = strdup(field_name);
+	tbl->version++;
 	return tbl->fields.field_count;
 }
 
@@ -212,7 +282,7 @@ const char* oris_table_get_field_by_index(oris_table_t* tbl, const int index)
 		return NULL;
 	}
 
-	return tbl->rows[tbl->current_row].fields[index - 1];
+	return oris_table_row_field(tbl, row, index - 1);
 }
 
 const char* oris_table_get_field(oris_table_t* tbl, const char* field)
@@ -239,7 +309,7 @@ int* oris_table_get_field_widths(oris_table_t* tbl)
 
 	for (i = 0; i < tbl->row_count; i++) {
 		for (j = 0; j < tbl->rows[i].field_count; j++) {
-			l = (int) mbstowcs(NULL, tbl->rows[i].fields[j], 0);
+			l = (int) mbstowcs(NULL, oris_table_row_field(tbl, &tbl->rows[i], j), 0);
 			if (l > retval[j]) {
 				retval[j] = l;
 			}
@@ -249,33 +319,112 @@ int* oris_table_get_field_widths(oris_table_t* tbl)
 	return retval;
 }
 
+/* copy the values still referenced by the rows into new arenas */
+static bool oris_table_compact(oris_table_t* tbl)
+{
+	oris_arena_t data, offsets;
+	oris_table_row_t* row;
+	size_t data_size = 0, offsets_size = 0, first, *offset;
+	int i, j;
+
+	for (i = 0; i < tbl->row_count; i++) {
+		offsets_size += tbl->rows[i].field_count * sizeof(size_t);
+		for (j = 0; j < tbl->rows[i].field_count; j++) {
+			data_size += strlen(oris_table_row_field(tbl, &tbl->rows[i], j)) + 1;
+		}
+	}
+
+	oris_arena_init(&data);
+	oris_arena_init(&offsets);
+	if (!oris_arena_reserve(&data, data_size) ||
+			!oris_arena_reserve(&offsets, offsets_size)) {
+		oris_arena_finalize(&data);
+		oris_arena_finalize(&offsets);
+		return false;
+	}
+
+	for (i = 0; i < tbl->row_count; i++) {
+		row = &tbl->rows[i];
+		first = oris_arena_alloc(&offsets, row->field_count * sizeof(size_t));
+		offset = (size_t*) oris_arena_at(&offsets, first);
+		for (j = 0; j < row->field_count; j++) {
+			offset[j] = oris_arena_strdup(&data, oris_table_row_field(tbl, row, j));
+		}
+		row->first = first / sizeof(size_t);
+	}
+
+	oris_arena_finalize(&tbl->data);
+	oris_arena_finalize(&tbl->offsets);
+	tbl->data = data;
+	tbl->offsets = offsets;
+	tbl->wasted = 0;
+
+	return true;
+}
+
 void oris_table_set_field(oris_table_t* tbl, int index, const char* value)
 {
 	oris_table_row_t* row;
+	size_t offsets, data, empty, len, old_len = 0, *offset;
+	char* old;
 	int i;
 
-	oris_table_check_and_reset_cursor(tbl);
+	if (!oris_table_check_and_reset_cursor(tbl)) {
+		return;
+	}
 	row = &(tbl->rows[tbl->current_row]);
 
 	if (index > tbl->fields.field_count || index < 1) {
 		return;
 	}
 
-	if (index > row->field_count) {
-		if (!oris_safe_realloc((void**) row->fields, index, sizeof(*row->fields))) {
+	len = strlen(value);
+	if (index <= row->field_count) {
+		old = oris_table_row_field(tbl, row, index - 1);
+		old_len = strlen(old);
+		if (len <= old_len) {
+			memcpy(old, value, len + 1);
+			tbl->wasted += old_len - len;
+			tbl->version++;
+			return;
+		}
+	}
+
+	/* a longer value is appended, the old one is reclaimed by compaction */
+	data = oris_arena_strdup(&tbl->data, value);
+	if (data == ORIS_ARENA_INVALID) {
+		return;
+	}
+
+	if (index <= row->field_count) {
+		tbl->wasted += old_len + 1;
+	} else {
+		/* move the row's offsets to the end of the arena to make room */
+		empty = oris_arena_strdup(&tbl->data, "");
+		offsets = oris_arena_alloc(&tbl->offsets, index * sizeof(size_t));
+		if (empty == ORIS_ARENA_INVALID || offsets == ORIS_ARENA_INVALID) {
 			return;
 		}
 
+		offset = (size_t*) oris_arena_at(&tbl->offsets, offsets);
+		memcpy(offset, (size_t*) tbl->offsets.data + row->first,
+			row->field_count * sizeof(size_t));
 		for (i = row->field_count; i < index - 1; i++) {
-			row->fields[i] = strdup("");
+			offset[i] = empty;
 		}
 
+		tbl->wasted += row->field_count * sizeof(size_t);
+		row->first = offsets / sizeof(size_t);
 		row->field_count = index;
-	} else {
-		oris_free_and_null(row->fields[index - 1]);
 	}
 
-	row->fields[index - 1] = strdup(value);
+	((size_t*) tbl->offsets.data)[row->first + index - 1] = data;
+	tbl->version++;
+
+	if (tbl->wasted >= COMPACT_MIN_WASTED &&
+			tbl->wasted * 2 > tbl->data.size + tbl->offsets.size) {
+		oris_table_compact(tbl);
+	}
 }
 
 /* table list functions */
@@ -283,6 +432,8 @@ void oris_tables_init(oris_table_list_t* list)
 {
 	list->count = 0;
 	list->tables = NULL;
+	list->index = NULL;
+	list->index_size = 0;
 }
 
 void oris_tables_finalize(oris_table_list_t* list)
@@ -295,51 +446,229 @@ void oris_tables_finalize(oris_table_list_t* list)
 
 	list->count = 0;
 	oris_free_and_null(list->tables);
+	oris_free_and_null(list->index);
+	list->index_size = 0;
 }
 
-oris_table_t* oris_get_or_create_table(oris_table_list_t* tbl_list,
-	const char * name, bool create)
+/* FNV-1a over the lower case name (or field value) */
+static size_t oris_tables_hash(const char* name)
 {
-	size_t i, inspos;
-	static size_t pos_cache = 0;
+	const unsigned char* s;
+	uint32_t h = 2166136261u;
 
-	if (name == NULL) {
+	for (s = (const unsigned char*) name; *s; s++) {
+		h = (h ^ (uint32_t) tolower(*s)) * 16777619u;
+	}
+
+	return (size_t) h;
+}
+
+static oris_table_lookup_t* oris_table_get_lookup(oris_table_t* tbl, int field)
+{
+	int i;
+
+	for (i = 0; i < tbl->lookup_count; i++) {
+		if (tbl->lookups[i].field == field) {
+			return &tbl->lookups[i];
+		}
+	}
+
+	if (!oris_safe_realloc((void**) &tbl->lookups, tbl->lookup_count + 1,
+			sizeof(*tbl->lookups))) {
 		return NULL;
 	}
 
-	if (pos_cache < tbl_list->count && strcasecmp(tbl_list->tables[pos_cache].name, name) == 0) {
-		return &(tbl_list->tables[pos_cache]);
+	memset(&tbl->lookups[tbl->lookup_count], 0, sizeof(*tbl->lookups));
+	tbl->lookups[tbl->lookup_count].field = field;
+
+	return &tbl->lookups[tbl->lookup_count++];
+}
+
+/* rows are inserted in order, so the first of equal values is found first */
+static bool oris_table_build_lookup(oris_table_t* tbl, oris_table_lookup_t* lookup)
+{
+	oris_table_row_t* row;
+	size_t slot, size = 16;
+	int i;
+
+	while (size < (size_t) tbl->row_count * 2) {
+		size *= 2;
+	}
+
+	if (size != lookup->size) {
+		free(lookup->slots);
+		lookup->slots = malloc(size * sizeof(*lookup->slots));
+		lookup->size = lookup->slots ? size : 0;
+		if (!lookup->slots) {
+			return false;
+		}
 	}
 
-	for (i = 0; i < tbl_list->count; i++) {
-		if (strcasecmp(tbl_list->tables[i].name, name) == 0) {
-			pos_cache = i;
-			return &(tbl_list->tables[i]);
+	memset(lookup->slots, 0, size * sizeof(*lookup->slots));
+	for (i = 0; i < tbl->row_count; i++) {
+		row = &tbl->rows[i];
+		if (lookup->field > row->field_count) {
+			continue;
+		}
+
+		slot = oris_tables_hash(oris_table_row_field(tbl, row, lookup->field - 1)) & (size - 1);
+		while (lookup->slots[slot]) {
+			slot = (slot + 1) & (size - 1);
 		}
+		lookup->slots[slot] = i + 1;
 	}
 
-	/* nothing found, create new table */
-	if (create && oris_safe_realloc((void**) &(tbl_list->tables), tbl_list->count + 1, sizeof(*(tbl_list->tables)))) {
+	lookup->version = tbl->version;
 
-		/* find correct position in table list and shift array if */
-		if (tbl_list->count > 0) {
-			inspos = tbl_list->count - 1;
+	return true;
+}
 
-			while (inspos > 0 && strcmp(tbl_list->tables[inspos].name, name) > 0) {
-				tbl_list->tables[i] = tbl_list->tables[i - 1];
-				inspos--;
+int oris_table_find_row(oris_table_t* tbl, int field, const char* value)
+{
+	oris_table_lookup_t* lookup;
+	oris_table_row_t* row;
+	size_t slot;
+	int i;
+
+	if (!tbl || field < 1 || tbl->row_count == 0) {
+		return -1;
+	}
+
+	lookup = oris_table_get_lookup(tbl, field);
+	if (lookup && (lookup->version != tbl->version || !lookup->slots) &&
+			!oris_table_build_lookup(tbl, lookup)) {
+		lookup = NULL;
+	}
+
+	if (!lookup) {
+		/* out of memory, scan the rows */
+		for (i = 0; i < tbl->row_count; i++) {
+			row = &tbl->rows[i];
+			if (field <= row->field_count &&
+					strcasecmp(oris_table_row_field(tbl, row, field - 1), value) == 0) {
+				return i;
 			}
 		}
+		return -1;
+	}
+
+	slot = oris_tables_hash(value) & (lookup->size - 1);
+	while (lookup->slots[slot]) {
+		row = &tbl->rows[lookup->slots[slot] - 1];
+		if (strcasecmp(oris_table_row_field(tbl, row, field - 1), value) == 0) {
+			return lookup->slots[slot] - 1;
+		}
+		slot = (slot + 1) & (lookup->size - 1);
+	}
 
-		tbl_list->count++;
-		oris_table_init(&(tbl_list->tables[i]));
-		tbl_list->tables[i].name = strdup(name);
+	return -1;
+}
 
-		pos_cache = i;
-		return &(tbl_list->tables[i]);
-	} else {
+/* (re)builds the index after the positions in the table array changed, the
+ * index is kept at most half full */
+static bool oris_tables_rebuild_index(oris_table_list_t* list)
+{
+	size_t i, slot, size;
+
+	size = list->index_size ? list->index_size : 16;
+	while (size < list->count * 2) {
+		size *= 2;
+	}
+
+	if (size != list->index_size) {
+		if (oris_safe_realloc((void**) &list->index, size, sizeof(*list->index))) {
+			list->index_size = size;
+		} else if (list->count >= list->index_size) {
+			return false;
+		}
+	}
+
+	memset(list->index, 0, list->index_size * sizeof(*list->index));
+	for (i = 0; i < list->count; i++) {
+		slot = oris_tables_hash(list->tables[i].name) & (list->index_size - 1);
+		while (list->index[slot]) {
+			slot = (slot + 1) & (list->index_size - 1);
+		}
+		list->index[slot] = i + 1;
+	}
+
+	return true;
+}
+
+static oris_table_t* oris_tables_lookup(oris_table_list_t* list, const char* name)
+{
+	size_t slot;
+	oris_table_t* tbl;
+
+	if (list->index_size == 0) {
 		return NULL;
 	}
+
+	slot = oris_tables_hash(name) & (list->index_size - 1);
+	while (list->index[slot]) {
+		tbl = &list->tables[list->index[slot] - 1];
+		if (strcasecmp(tbl->name, name) == 0) {
+			return tbl;
+		}
+		slot = (slot + 1) & (list->index_size - 1);
+	}
+
+	return NULL;
+}
+
+oris_table_t* oris_get_or_create_table(oris_table_list_t* tbl_list,
+	const char * name, bool create)
+{
+	size_t lo, hi, mid;
+	oris_table_t* tbl;
+	char* tbl_name;
+
+	if (name == NULL) {
+		return NULL;
+	}
+
+	tbl = oris_tables_lookup(tbl_list, name);
+	if (tbl || !create) {
+		return tbl;
+	}
+
+	/* nothing found, create new table at its sorted position */
+	tbl_name = strdup(name);
+	if (!tbl_name || !oris_safe_realloc((void**) &(tbl_list->tables),
+			tbl_list->count + 1, sizeof(*(tbl_list->tables)))) {
+		free(tbl_name);
+		return NULL;
+	}
+
+	lo = 0;
+	hi = tbl_list->count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (strcmp(tbl_list->tables[mid].name, name) > 0) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+
+	memmove(&tbl_list->tables[lo + 1], &tbl_list->tables[lo],
+		(tbl_list->count - lo) * sizeof(*tbl_list->tables));
+	tbl_list->count++;
+
+	tbl = &tbl_list->tables[lo];
+	oris_table_init(tbl);
+	tbl->name = tbl_name;
+
+	if (!oris_tables_rebuild_index(tbl_list)) {
+		oris_log_f(LOG_ERR, "could not index table %s", name);
+		free(tbl_name);
+		tbl_list->count--;
+		memmove(&tbl_list->tables[lo], &tbl_list->tables[lo + 1],
+			(tbl_list->count - lo) * sizeof(*tbl_list->tables));
+		return NULL;
+	}
+
+	return tbl;
 }
 
 bool oris_tables_dump_to_file(oris_table_list_t* tables, const char* fname)
@@ -347,7 +676,7 @@ bool oris_tables_dump_to_file(oris_table_list_t* tables, const char* fname)
 	int j, col;
 	size_t i;
 	FILE* f;
-	oris_table_row_t row;
+	oris_table_row_t* row;
 
 	f = fopen(fname, "w");
 	if (!f) {
@@ -379,12 +708,12 @@ bool oris_tables_dump_to_file(oris_table_list_t* tables, const char* fname)
 
 		fprintf(f, "[%s]\n", tables->tables[i].name);
 		for (j = 0; j < tables->tables[i].row_count; j++) {
-			row = tables->tables[i].rows[j];
-			for (col = 0; col < row.field_count; col++) {
+			row = &tables->tables[i].rows[j];
+			for (col = 0; col < row->field_count; col++) {
 				if (col) {
 					fputc(';', f);
 				}
-				fputs(row.fields[col], f);
+				fputs(oris_table_row_field(&tables->tables[i], row, col), f);
 			}
 			fputs("\n", f);
 		}
@@ -507,7 +836,7 @@ static void oris_table_add_fields_from_definition(oris_table_t* tbl,
 	tbl->fields.fields = calloc(tbl->fields.field_count, sizeof(*tbl->fields.fields));
 
 	for (i = 1; i < def->field_count; i++) {
-		tbl->fields.fields[i - 1] = strdup(def->fields[i]);
+		tbl->fields.fields[i - 1] = strdup(oris_table_row_field(def_tbl, def, i));
 	}
 }
 
@@ -544,6 +873,10 @@ void oris_tables_load_from_file(oris_table_list_t* tables, const char* fname)
 	}
 
 	fclose(f);
+
+	/* name is not allocated */
+	def_tbl.name = NULL;
+	oris_table_finalize(&def_tbl);
 }
 
 
@@ -567,3 +900,110 @@ const char* oris_tables_get_field(oris_table_list_t* list, const char* name,
 
 	return (tbl ? oris_table_get_field(tbl, field) : NULL);
 }
+
+static bool oris_serialize_append(char** buf, size_t* size, size_t* capacity,
+	const char* s, size_t n)
+{
+	while (*capacity < *size + n + 1) {
+		*capacity = *capacity ? *capacity * 2 : 256;
+		if (!oris_safe_realloc((void**) buf, *capacity, sizeof(**buf))) {
+			return false;
+		}
+	}
+
+	memcpy(*buf + *size, s, n);
+	*size += n;
+	(*buf)[*size] = '\0';
+
+	return true;
+}
+
+char* oris_table_serialize(oris_table_t* tbl, size_t* size)
+{
+	char *buf = NULL, num[16], delim = DUMP_DELIM, eol = '\n';
+	size_t capacity = 0;
+	const char* s;
+	int i, j;
+	bool ok;
+
+	*size = 0;
+	ok = oris_serialize_append(&buf, size, &capacity, tbl->name, strlen(tbl->name)) &&
+		oris_serialize_append(&buf, size, &capacity, "=", 1);
+
+	for (i = 0; ok && i < tbl->fields.field_count; i++) {
+		if (i > 0) {
+			ok = oris_serialize_append(&buf, size, &capacity, &delim, 1);
+		}
+		s = tbl->fields.fields[i];
+		if (!s) {
+			snprintf(num, sizeof(num), "%d", i + 1);
+			s = num;
+		}
+		ok = ok && oris_serialize_append(&buf, size, &capacity, s, strlen(s));
+	}
+	ok = ok && oris_serialize_append(&buf, size, &capacity, &eol, 1);
+
+	for (i = 0; ok && i < tbl->row_count; i++) {
+		for (j = 0; ok && j < tbl->rows[i].field_count; j++) {
+			if (j > 0) {
+				ok = oris_serialize_append(&buf, size, &capacity, &delim, 1);
+			}
+			s = oris_table_row_field(tbl, &tbl->rows[i], j);
+			ok = ok && oris_serialize_append(&buf, size, &capacity, s, strlen(s));
+		}
+		ok = ok && oris_serialize_append(&buf, size, &capacity, &eol, 1);
+	}
+
+	if (!ok) {
+		oris_free_and_null(buf);
+		*size = 0;
+	}
+
+	return buf;
+}
+
+oris_table_t* oris_tables_restore_table(oris_table_list_t* tables, char* buf, size_t size)
+{
+	oris_table_t def_tbl;
+	oris_table_t* tbl;
+	char *line, *eol, *end = buf + size;
+	const char* name;
+
+	eol = memchr(buf, '\n', size);
+	if (!eol) {
+		return NULL;
+	}
+
+	/* the definition line is read like a row of the [Definition] section */
+	*eol = '\0';
+	line = strchr(buf, '=');
+	if (!line) {
+		return NULL;
+	}
+	*line = DUMP_DELIM;
+
+	oris_table_init(&def_tbl);
+	oris_table_add_row(&def_tbl, buf, DUMP_DELIM);
+	name = oris_table_get_field_by_index(&def_tbl, 1);
+
+	tbl = name && *name ? oris_get_or_create_table(tables, name, true) : NULL;
+	if (tbl) {
+		oris_table_clear(tbl);
+		oris_table_add_fields_from_definition(tbl, &def_tbl);
+
+		for (line = eol + 1; line < end; line = eol + 1) {
+			eol = memchr(line, '\n', end - line);
+			if (!eol) {
+				break;
+			}
+			*eol = '\0';
+			oris_table_add_row(tbl, line, DUMP_DELIM);
+		}
+
+		tbl->state = COMPLETE;
+	}
+
+	oris_table_finalize(&def_tbl);
+
+	return tbl;
+}
@@ -4,41 +4,88 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include "oris_arena.h"
+
 #define ORIS_TABLE_ITEM_SEPERATOR '|'
 #define ORIS_FOR_EACH_TBL_ROW(tbl) \
 	for ((tbl)->current_row = 0; (tbl)->current_row < (tbl)->row_count; \
 		(tbl)->current_row++)
 
-/* a row within a table */
+/* a row within a table: first is the index of the row's first field offset
+ * in the table's offset arena, the fields itself are kept in the data arena */
 typedef struct oris_table_row {
-	char** fields;
+	size_t first;
 	int field_count;
 } oris_table_row_t;
 
+/* field names of a table (NULL for unnamed fields) */
+typedef struct oris_table_fields {
+	char** fields;
+	int field_count;
+} oris_table_fields_t;
+
+/* value of the i-th (zero based) field of a row */
+#define oris_table_row_field(tbl, row, i) oris_arena_at(&(tbl)->data, \
+	((size_t*) (tbl)->offsets.data)[(row)->first + (i)])
+
 
 typedef enum { RECEIVING, COMPLETE } oris_table_recv_state;
 
+struct oris_histogram;
+
+/* hash index over the case folded values of a field (1-based), each slot
+ * holds the row + 1 (0 = empty). It is valid while the table's version is
+ * unchanged and rebuilt on the next lookup otherwise. */
+typedef struct oris_table_lookup {
+	int field;
+	unsigned int version;
+	size_t size;
+	int* slots;
+} oris_table_lookup_t;
+
 /* a single named table with an index to the current (active) row */
 typedef struct oris_table {
 	char* name;
 	int current_row;
 	int row_count;
+	int row_capacity;
 	oris_table_recv_state state;
 	oris_table_row_t* rows;
-	oris_table_row_t fields;
+	oris_table_fields_t fields;
+	/* field values and their offsets, released on clear */
+	oris_arena_t data;
+	oris_arena_t offsets;
+	/* bytes of both arenas no longer referenced by a row */
+	size_t wasted;
 	bool is_temporary;
+	/* incremented on every modification of the table content */
+	unsigned int version;
+	/* version last written to the storage */
+	unsigned int stored_version;
+	/* number of times the table was received completely */
+	unsigned long updates;
+	/* latency histogram of the table (owned by the application), looked up
+	 * when the table is received completely for the first time */
+	struct oris_histogram* latency;
+	/* lookup indexes, built on demand */
+	oris_table_lookup_t* lookups;
+	int lookup_count;
 } oris_table_t;
 
 
-/* list of tables */
+/* list of tables, sorted by name. index is an open addressing hash table over
+ * the case-folded names, each slot holds the array position + 1 (0 = empty) */
 typedef struct oris_table_list {
 	size_t count;
 	oris_table_t* tables;
+	size_t* index;
+	size_t index_size;
 } oris_table_list_t;
 
 
 /* table row functions */
 bool oris_table_add_row(oris_table_t* table, const char* s, char delim);
+bool oris_table_add_row_n(oris_table_t* table, const char* s, size_t len, char delim);
 
 
 /* table functions */
@@ -55,6 +102,9 @@ const char* oris_table_get_field_by_index(oris_table_t* tbl, const int index);
 int* oris_table_get_field_widths(oris_table_t* tbl);
 void oris_table_set_field(oris_table_t* tbl, int index, const char* value);
 
+/* first row whose field (1-based) equals value ignoring case, -1 if none */
+int oris_table_find_row(oris_table_t* tbl, int field, const char* value);
+
 /* table list functions */
 void oris_tables_init(oris_table_list_t* list);
 void oris_tables_finalize(oris_table_list_t* list);
@@ -65,6 +115,11 @@ oris_table_t* oris_get_or_create_table(oris_table_list_t* tbl_list,
 bool oris_tables_dump_to_file(oris_table_list_t* tables, const char* fname);
 void oris_tables_load_from_file(oris_table_list_t* tables, const char* fname);
 
+/* single table (de)serialization: the definition line (NAME=field;...)
+ * followed by one line per row, as used for journal records */
+char* oris_table_serialize(oris_table_t* tbl, size_t* size);
+oris_table_t* oris_tables_restore_table(oris_table_list_t* tables, char* buf, size_t size);
+
 #define oris_get_table(tbls, name) oris_get_or_create_table(tbls, name, false)
 
 /* misc/shortcut functions */
@@ -0,0 +1,75 @@
+#ifndef __ORIS_THREAD_H
+#define __ORIS_THREAD_H
+
+/* minimal portability layer for the few background threads of the gateway.
+ * the atomics are full barriers and return the previous value (add) */
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef HANDLE oris_thread_t;
+typedef DWORD oris_thread_result_t;
+typedef CRITICAL_SECTION oris_mutex_t;
+typedef CONDITION_VARIABLE oris_cond_t;
+
+#define ORIS_THREAD_CALL WINAPI
+
+#define oris_thread_create(t, fn, arg) \
+	((*(t) = CreateThread(NULL, 0, (fn), (arg), 0, NULL)) != NULL)
+#define oris_thread_join(t) \
+	(WaitForSingleObject((t), INFINITE), CloseHandle(t))
+
+#define oris_mutex_init(m) InitializeCriticalSection(m)
+#define oris_mutex_destroy(m) DeleteCriticalSection(m)
+#define oris_mutex_lock(m) EnterCriticalSection(m)
+#define oris_mutex_unlock(m) LeaveCriticalSection(m)
+
+#define oris_cond_init(c) InitializeConditionVariable(c)
+#define oris_cond_destroy(c) ((void) (c))
+#define oris_cond_wait(c, m) SleepConditionVariableCS((c), (m), INFINITE)
+#define oris_cond_signal(c) WakeConditionVariable(c)
+#define oris_cond_broadcast(c) WakeAllConditionVariable(c)
+
+typedef volatile LONG oris_atomic_t;
+
+#define oris_atomic_load(p) InterlockedCompareExchange((p), 0, 0)
+#define oris_atomic_store(p, v) ((void) InterlockedExchange((p), (v)))
+#define oris_atomic_add(p, v) InterlockedExchangeAdd((p), (v))
+#define oris_atomic_cas(p, expected, desired) \
+	(InterlockedCompareExchange((p), (desired), (expected)) == (expected))
+
+#else
+#include <pthread.h>
+
+typedef pthread_t oris_thread_t;
+typedef void* oris_thread_result_t;
+typedef pthread_mutex_t oris_mutex_t;
+typedef pthread_cond_t oris_cond_t;
+
+#define ORIS_THREAD_CALL
+
+#define oris_thread_create(t, fn, arg) (pthread_create((t), NULL, (fn), (arg)) == 0)
+#define oris_thread_join(t) pthread_join((t), NULL)
+
+#define oris_mutex_init(m) pthread_mutex_init((m), NULL)
+#define oris_mutex_destroy(m) pthread_mutex_destroy(m)
+#define oris_mutex_lock(m) pthread_mutex_lock(m)
+#define oris_mutex_unlock(m) pthread_mutex_unlock(m)
+
+#define oris_cond_init(c) pthread_cond_init((c), NULL)
+#define oris_cond_destroy(c) pthread_cond_destroy(c)
+#define oris_cond_wait(c, m) pthread_cond_wait((c), (m))
+#define oris_cond_signal(c) pthread_cond_signal(c)
+#define oris_cond_broadcast(c) pthread_cond_broadcast(c)
+
+typedef long oris_atomic_t;
+
+#define oris_atomic_load(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define oris_atomic_store(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define oris_atomic_add(p, v) __atomic_fetch_add((p), (v), __ATOMIC_SEQ_CST)
+#define oris_atomic_cas(p, expected, desired) \
+	__sync_bool_compare_and_swap((p), (expected), (desired))
+
+#endif
+
+#endif /* __ORIS_THREAD_H */
@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "oris_libevent.h"
+
+#include "oris_util.h"
+#include "oris_log.h"
+#include "oris_automation.h"
+#include "oris_configuration.h"
+#include "oris_timer.h"
+
+/* all timer events sharing an interval. Ticks are scheduled relative to the
+ * start time on the monotonic clock, so the callback latency does not add up. */
+typedef struct {
+	unsigned int interval;
+	uint64_t start;
+	uint64_t ticks;
+	struct event* ev;
+	size_t count;
+	const oris_automation_action_t** actions;
+} oris_timer_group_t;
+
+static oris_timer_group_t* groups = NULL;
+static size_t group_count = 0;
+static oris_application_info_t* timer_info = NULL;
+
+static void oris_timer_schedule(oris_timer_group_t* group, uint64_t now)
+{
+	uint64_t period = (uint64_t) group->interval * 1000;
+	uint64_t due = group->start + (group->ticks + 1) * period;
+	uint64_t missed;
+	struct timeval timeout;
+
+	if (due <= now) {
+		/* overrun: skip the missed ticks instead of firing them in a burst */
+		missed = (now - group->start) / period - group->ticks;
+		oris_log_f(LOG_WARNING, "timer with period %u ms skipped %lu tick(s)",
+			group->interval, (unsigned long) missed);
+		group->ticks += missed;
+		due = group->start + (group->ticks + 1) * period;
+	}
+
+	timeout.tv_sec = (long) ((due - now) / 1000000);
+	timeout.tv_usec = (long) ((due - now) % 1000000);
+	event_add(group->ev, &timeout);
+}
+
+static void oris_timer_callback(evutil_socket_t fd, short what, void* arg)
+{
+	oris_timer_group_t* group = (oris_timer_group_t*) arg;
+	uint64_t now = oris_monotonic_usec();
+	size_t i;
+
+	(void) fd;
+	(void) what;
+
+	group->ticks++;
+	oris_log_f(LOG_DEBUG, "triggering events with period %u ms, %lu us late",
+		group->interval, (unsigned long) (now - group->start -
+			group->ticks * group->interval * (uint64_t) 1000));
+
+	for (i = 0; i < group->count; i++) {
+		oris_automation_run(&group->actions[i]->program, timer_info);
+	}
+
+	oris_timer_schedule(group, oris_monotonic_usec());
+}
+
+static oris_timer_group_t* oris_timer_get_group(unsigned int interval)
+{
+	oris_timer_group_t* tmp;
+	size_t i;
+
+	for (i = 0; i < group_count; i++) {
+		if (groups[i].interval == interval) {
+			return &groups[i];
+		}
+	}
+
+	tmp = realloc(groups, (group_count + 1) * sizeof(*groups));
+	if (!tmp) {
+		return NULL;
+	}
+
+	groups = tmp;
+	memset(&groups[group_count], 0, sizeof(*groups));
+	groups[group_count].interval = interval;
+
+	return &groups[group_count++];
+}
+
+static bool oris_timer_add_action(const oris_automation_action_t* action)
+{
+	oris_timer_group_t* group = oris_timer_get_group(action->event.interval);
+	const oris_automation_action_t** tmp;
+
+	if (!group) {
+		return false;
+	}
+
+	tmp = realloc(group->actions, (group->count + 1) * sizeof(*tmp));
+	if (!tmp) {
+		return false;
+	}
+
+	tmp[group->count++] = action;
+	group->actions = tmp;
+
+	return true;
+}
+
+bool oris_timers_init(oris_application_info_t* info)
+{
+	const oris_automation_action_t* action;
+	uint64_t now;
+	size_t i;
+
+	timer_info = info;
+
+	for (i = 0; i < oris_get_automation_event_count(); i++) {
+		action = oris_get_automation_event(i);
+		if (action->event.type == EVT_TIMER && !oris_timer_add_action(action)) {
+			oris_logs(LOG_ERR, "could not register timer event");
+			return false;
+		}
+	}
+
+	now = oris_monotonic_usec();
+	for (i = 0; i < group_count; i++) {
+		groups[i].ev = event_new(info->libevent_info.base, -1, 0,
+			oris_timer_callback, &groups[i]);
+		if (!groups[i].ev) {
+			oris_logs(LOG_ERR, "could not create timer");
+			return false;
+		}
+
+		groups[i].start = now;
+		oris_timer_schedule(&groups[i], now);
+		oris_log_f(LOG_DEBUG, "timer with period %u ms for %lu event(s)",
+			groups[i].interval, (unsigned long) groups[i].count);
+	}
+
+	return true;
+}
+
+void oris_timers_finalize(void)
+{
+	size_t i;
+
+	for (i = 0; i < group_count; i++) {
+		if (groups[i].ev) {
+			event_free(groups[i].ev);
+		}
+		free(groups[i].actions);
+	}
+
+	oris_free_and_null(groups);
+	group_count = 0;
+	timer_info = NULL;
+}
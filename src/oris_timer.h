@@ -0,0 +1,13 @@
+#ifndef __ORIS_TIMER_H
+#define __ORIS_TIMER_H
+
+#include <stdbool.h>
+
+#include "oris_app_info.h"
+
+/* register one libevent timer per distinct interval of the configured timer
+ * events. Nothing is scheduled if there are no timer events. */
+bool oris_timers_init(oris_application_info_t* info);
+void oris_timers_finalize(void);
+
+#endif /* __ORIS_TIMER_H */
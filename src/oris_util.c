@@ -4,7 +4,15 @@
 #include <errno.h>
 #include <ctype.h>
 #include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
 
+#include <event2/http.h>
+
+#include "oris_log.h"
 #include "oris_util.h"
 
 const oris_error_t ORIS_SUCCESS = 0;
@@ -63,6 +71,23 @@ bool oris_strtoint(const char* s, int* v)
 	}
 }
 
+int oris_get_int_param(struct evkeyvalq* params, const char* key, int def, int max)
+{
+	const char* value = evhttp_find_header(params, key);
+	int v;
+
+	if (!value) {
+		return def;
+	}
+
+	if (!oris_strtoint(value, &v) || v < 1 || v > max) {
+		oris_log_f(LOG_WARNING, "invalid value %s for %s, using %d", value, key, def);
+		return def;
+	}
+
+	return v;
+}
+
 char* oris_ltrim(char* s)
 {
 	while (*s && isblank(*s)) {
@@ -108,3 +133,37 @@ void oris_buf_to_hex(const unsigned char* raw, size_t size, char* const s)
 
 	s[size * 2] = 0;
 }
+
+uint64_t oris_hash64(const void* data, size_t size)
+{
+	const unsigned char* p = (const unsigned char*) data;
+	uint64_t h = 14695981039346656037ULL;
+
+	while (size-- > 0) {
+		h = (h ^ *p++) * 1099511628211ULL;
+	}
+
+	return h;
+}
+
+uint64_t oris_monotonic_usec(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+
+	if (freq.QuadPart == 0) {
+		QueryPerformanceFrequency(&freq);
+	}
+	QueryPerformanceCounter(&now);
+
+	return (uint64_t) (now.QuadPart / freq.QuadPart) * 1000000 +
+		(uint64_t) (now.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+#endif
+}
@@ -3,6 +3,9 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+struct evkeyvalq;
 
 #ifdef _WIN32
 #define strcasecmp _stricmp
@@ -28,10 +31,20 @@ size_t oris_safe_strlen(const char* s);
 
 bool oris_strtoint(const char* s, int* v);
 
+/* value of key in the (URI query) parameters within 1..max. def if it is
+ * missing or invalid, the latter with a warning */
+int oris_get_int_param(struct evkeyvalq* params, const char* key, int def, int max);
+
 char* oris_ltrim(char* s);
 char* oris_rtrim(char* s);
 char* oris_upper_str(char* s);
 
 void oris_buf_to_hex(const unsigned char* raw, size_t size, char* const s);
 
+/* 64 bit FNV-1a hash */
+uint64_t oris_hash64(const void* data, size_t size);
+
+/* microseconds from a monotonic clock (arbitrary origin) */
+uint64_t oris_monotonic_usec(void);
+
 #endif /* __ORIS_UTIL_H */
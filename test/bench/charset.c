@@ -0,0 +1,255 @@
+/* feed line transcoding benchmark
+ *
+ * Converts the lines of a feed from ISO-8859-1 to UTF-8 the way the data
+ * protocol does (pure ASCII lines are used as they are, others converted into
+ * a reused scratch buffer) and with strdup_iso8859_to_utf8, the allocating two
+ * pass conversion used before. The file holds the raw feed, lines are
+ * delimited by STX/ETX or newlines. Without a file a few typical lines are
+ * used.
+ *
+ * build with make bench in src/, run ../test/bench/charset [file [rounds]] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oris_charset.h"
+#include "oris_util.h"
+#include "oris_log.h"
+
+#define LINE_DELIM_START 0x02
+#define LINE_DELIM_END   0x03
+
+#define DEFAULT_BYTES (256 * 1024 * 1024)
+
+typedef struct {
+	char** lines;
+	size_t* lens;
+	size_t count;
+	size_t bytes;
+	size_t ascii;
+} line_set_t;
+
+static const char* sample_lines[] = {
+	"VRD0|M1x A|1|Men's Single Sculls|V|03.06.2026|09:30|M|1-2 FA|2|V|A|2000|1|6",
+	"STL1|1|101|1|GER|Germany|GER|||||||||||||||||||||M\xfcller|J\xf6rg||1999|4711|12|1",
+	"LOG1|M1x A|101|1|500|1:42.31|1|0.00",
+	"STT0|M1x A|1|3",
+	"ATH1|4711|GER-4711|M\xfcller|J\xf6rg|1999|12|||M1x A",
+	"TOD!|09:31:12",
+	"STA0|M1x A|1|500|0.00|1:42.31|2:05.80|2:09.14"
+};
+
+static volatile size_t sink;
+
+/* the former conversion, kept as reference */
+static char* strdup_iso8859_to_utf8(const char* line)
+{
+	const unsigned char* c;
+	unsigned char* out;
+	char* retval;
+	size_t size = 0;
+
+	for (c = (const unsigned char*) line; *c; c++, size++) {
+		if (*c >= 128) {
+			size++;
+		}
+	}
+
+	retval = malloc(size + 1);
+	if (!retval) {
+		return NULL;
+	}
+
+	c = (const unsigned char*) line;
+	out = (unsigned char*) retval;
+	while (*c) {
+		if (*c < 128) {
+			*out++ = *c++;
+		} else {
+			*out++ = 0xc2 + (*c > 0xbf);
+			*out++ = 0x80 + (*c++ & 0x3f);
+		}
+	}
+	*out = 0;
+
+	return retval;
+}
+
+static bool add_line(line_set_t* set, const char* s, size_t len)
+{
+	if (len == 0) {
+		return true;
+	}
+
+	if (!oris_safe_realloc((void**) &set->lines, set->count + 1, sizeof(*set->lines)) ||
+			!oris_safe_realloc((void**) &set->lens, set->count + 1, sizeof(*set->lens))) {
+		return false;
+	}
+
+	set->lines[set->count] = strndup(s, len);
+	if (!set->lines[set->count]) {
+		return false;
+	}
+	set->lens[set->count] = len;
+	set->count++;
+	set->bytes += len;
+	if (oris_is_ascii(s, len)) {
+		set->ascii++;
+	}
+
+	return true;
+}
+
+static bool read_lines(line_set_t* set, const char* fn)
+{
+	FILE* f;
+	char* buf;
+	long fsize;
+	size_t size, start, i;
+
+	f = fopen(fn, "rb");
+	if (!f) {
+		perror(fn);
+		return false;
+	}
+
+	if (fseek(f, 0, SEEK_END) != 0 || (fsize = ftell(f)) < 0 ||
+			fseek(f, 0, SEEK_SET) != 0) {
+		perror(fn);
+		fclose(f);
+		return false;
+	}
+
+	buf = malloc((size_t) fsize + 1);
+	if (!buf) {
+		fclose(f);
+		return false;
+	}
+
+	size = fread(buf, 1, (size_t) fsize, f);
+	fclose(f);
+
+	for (start = 0, i = 0; i < size; i++) {
+		if (buf[i] == LINE_DELIM_START || buf[i] == LINE_DELIM_END ||
+				buf[i] == '\n' || buf[i] == '\r') {
+			if (!add_line(set, buf + start, i - start)) {
+				free(buf);
+				return false;
+			}
+			start = i + 1;
+		}
+	}
+
+	if (!add_line(set, buf + start, size - start)) {
+		free(buf);
+		return false;
+	}
+
+	free(buf);
+
+	return true;
+}
+
+static double bench_current(line_set_t* set, size_t rounds)
+{
+	uint64_t start;
+	char* scratch = NULL;
+	size_t capacity = 0, r, i, len;
+	const char* s;
+
+	start = oris_monotonic_usec();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < set->count; i++) {
+			s = set->lines[i];
+			len = set->lens[i];
+			if (!oris_is_ascii(s, len)) {
+				if (2 * len + 1 > capacity) {
+					capacity = 2 * len + 1;
+					if (!oris_safe_realloc((void**) &scratch, capacity, 1)) {
+						return 0.0;
+					}
+				}
+				len = oris_iso8859_to_utf8(s, len, scratch);
+				s = scratch;
+			}
+			sink += (unsigned char) s[len / 2] + len;
+		}
+	}
+
+	free(scratch);
+
+	return (double) (oris_monotonic_usec() - start);
+}
+
+static double bench_reference(line_set_t* set, size_t rounds)
+{
+	uint64_t start;
+	size_t r, i;
+	char* s;
+
+	start = oris_monotonic_usec();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < set->count; i++) {
+			s = strdup_iso8859_to_utf8(set->lines[i]);
+			if (!s) {
+				return 0.0;
+			}
+			sink += (unsigned char) s[set->lens[i] / 2];
+			free(s);
+		}
+	}
+
+	return (double) (oris_monotonic_usec() - start);
+}
+
+static void print_result(const char* name, line_set_t* set, size_t rounds,
+	double usec)
+{
+	double lines = (double) set->count * rounds;
+
+	printf("%-24s %10.1f ns/line %10.1f MB/s\n", name, usec * 1000.0 / lines,
+		(double) set->bytes * rounds / usec);
+}
+
+int main(int argc, char** argv)
+{
+	line_set_t set = { 0 };
+	size_t rounds, i;
+
+	oris_init_log(NULL, LOG_ERR);
+
+	if (argc > 1) {
+		if (!read_lines(&set, argv[1])) {
+			return EXIT_FAILURE;
+		}
+	} else {
+		for (i = 0; i < sizeof(sample_lines) / sizeof(*sample_lines); i++) {
+			if (!add_line(&set, sample_lines[i], strlen(sample_lines[i]))) {
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	if (set.count == 0) {
+		fprintf(stderr, "no lines in %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	rounds = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_BYTES / set.bytes + 1;
+
+	printf("%zu lines, %zu bytes, %zu pure ASCII, %zu rounds\n", set.count,
+		set.bytes, set.ascii, rounds);
+	print_result("oris_iso8859_to_utf8", &set, rounds, bench_current(&set, rounds));
+	print_result("strdup_iso8859_to_utf8", &set, rounds, bench_reference(&set, rounds));
+
+	for (i = 0; i < set.count; i++) {
+		free(set.lines[i]);
+	}
+	free(set.lines);
+	free(set.lens);
+
+	oris_finalize_log();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+/* table lookup benchmark
+ *
+ * Creates lists of 10, 100 and 1000 tables named like the ones a regatta day
+ * leaves behind (VER, VRD, STL, ... plus one STA_<event>_<comp> copy per
+ * race) and times oris_get_table for all of them in random order and in
+ * lower case, so the case-folding path is measured as well. For comparison
+ * the same names are looked up by a linear strcasecmp scan as done before the
+ * tables were indexed. The cost per lookup of oris_get_table should stay flat
+ * while the scan grows with the number of tables.
+ *
+ * build with make bench in src/, run ../test/bench/tables [lookups] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <strings.h>
+
+#include "oris_table.h"
+#include "oris_util.h"
+#include "oris_log.h"
+
+#define DEFAULT_LOOKUPS 2000000
+
+static const char* fixed_names[] = {
+	"VER", "VRD", "STL", "STA", "RNR", "LOG", "STT", "TOD", "ATH", "CMD"
+};
+
+static volatile size_t sink;
+
+static oris_table_t* linear_lookup(oris_table_list_t* list, const char* name)
+{
+	size_t i;
+
+	for (i = 0; i < list->count; i++) {
+		if (strcasecmp(list->tables[i].name, name) == 0) {
+			return &list->tables[i];
+		}
+	}
+
+	return NULL;
+}
+
+static char** create_tables(oris_table_list_t* list, size_t count)
+{
+	char** names;
+	char name[32];
+	size_t i, j;
+
+	names = calloc(count, sizeof(*names));
+	if (!names) {
+		return NULL;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (i < sizeof(fixed_names) / sizeof(*fixed_names)) {
+			snprintf(name, sizeof(name), "%s", fixed_names[i]);
+		} else {
+			snprintf(name, sizeof(name), "STA_LG2026_%zu", i);
+		}
+		if (!oris_get_or_create_table(list, name, true)) {
+			return NULL;
+		}
+		/* look up in lower case, the tables are created upper case */
+		for (j = 0; name[j]; j++) {
+			name[j] = tolower((unsigned char) name[j]);
+		}
+		names[i] = strdup(name);
+		if (!names[i]) {
+			return NULL;
+		}
+	}
+
+	/* shuffle the lookup order */
+	srand(4711);
+	for (i = count - 1; i > 0; i--) {
+		char* tmp;
+
+		j = (size_t) rand() % (i + 1);
+		tmp = names[i];
+		names[i] = names[j];
+		names[j] = tmp;
+	}
+
+	return names;
+}
+
+static double bench(oris_table_list_t* list, char** names, size_t count,
+	size_t lookups, bool linear)
+{
+	uint64_t start;
+	size_t i;
+	oris_table_t* tbl;
+
+	start = oris_monotonic_usec();
+	for (i = 0; i < lookups; i++) {
+		tbl = linear ? linear_lookup(list, names[i % count])
+			: oris_get_table(list, names[i % count]);
+		sink += (size_t) tbl;
+	}
+
+	return (double) (oris_monotonic_usec() - start) * 1000.0 / lookups;
+}
+
+int main(int argc, char** argv)
+{
+	static const size_t counts[] = { 10, 100, 1000 };
+	oris_table_list_t list;
+	char** names;
+	size_t lookups, i, j;
+
+	lookups = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_LOOKUPS;
+	if (lookups == 0) {
+		fprintf(stderr, "usage: %s [lookups]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	oris_init_log(NULL, LOG_ERR);
+
+	printf("%8s %16s %16s\n", "tables", "oris_get_table", "linear scan");
+	for (i = 0; i < sizeof(counts) / sizeof(*counts); i++) {
+		oris_tables_init(&list);
+		names = create_tables(&list, counts[i]);
+		if (!names) {
+			fprintf(stderr, "could not create %zu tables\n", counts[i]);
+			return EXIT_FAILURE;
+		}
+
+		printf("%8zu %13.1f ns %13.1f ns\n", counts[i],
+			bench(&list, names, counts[i], lookups, false),
+			bench(&list, names, counts[i], lookups / 10 + 1, true));
+
+		for (j = 0; j < counts[i]; j++) {
+			free(names[j]);
+		}
+		free(names);
+		oris_tables_finalize(&list);
+	}
+
+	oris_finalize_log();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,335 @@
+/* template rendering benchmark
+ *
+ * Loads the templates of a configuration (the rowing one by default), fills
+ * VER, VRD and STL with rows like the load generator sends and renders the
+ * competition template once per VRD row and the startlist template for the
+ * whole STL table, as the rowing automation does. The compiled render plans
+ * are compared with a renderer emitting keys and values with
+ * evbuffer_add_printf as the template walker did before the plans. Both
+ * evaluate the same compiled expressions, the tree walking interpreter is
+ * gone, so the difference is the cost of producing the JSON.
+ *
+ * build with make bench in src/, run from there
+ * ../test/bench/templates [config [rows [rounds]]] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <event2/buffer.h>
+
+#include "oris_app_info.h"
+#include "oris_automation.h"
+#include "oris_configuration.h"
+#include "oris_program.h"
+#include "oris_table.h"
+#include "oris_util.h"
+#include "oris_log.h"
+#include "oris_interpret_tools.h"
+
+#define DEFAULT_CONFIG "../config/automation.rowing.conf"
+#define DEFAULT_ROWS 1000
+#define DEFAULT_ROUNDS 200
+
+#define MAX_ROW 1024
+
+#define EVENT_ID "LG2026"
+#define DISTANCE 2000
+
+typedef void (*render_fn_t)(struct evbuffer* buf, oris_table_t* tbl,
+	const oris_template_t* tmpl, char** keys);
+
+/* the keys of a template without quotes and comma */
+static char** template_keys(const oris_template_t* tmpl)
+{
+	char** keys;
+	size_t i, skip;
+
+	keys = calloc(tmpl->count, sizeof(*keys));
+	if (!keys) {
+		return NULL;
+	}
+
+	for (i = 0; i < tmpl->count; i++) {
+		skip = i > 0 ? 2 : 1;
+		keys[i] = strndup(tmpl->fields[i].fragment + skip,
+			tmpl->fields[i].fragment_len - skip - 2);
+		if (!keys[i]) {
+			return NULL;
+		}
+	}
+
+	return keys;
+}
+
+/* the former output functions, kept as reference */
+static void printf_add_escaped_json_str_to_buffer(struct evbuffer* target,
+	oris_parse_expr_t* expr)
+{
+	char *s, *p;
+
+	p = s = strdup((char*) expr->value.as_string->chars);
+	while (s && *p) {
+		if (*p == '"') { *p = '\''; }
+		p++;
+	}
+
+	evbuffer_add_printf(target, "\"%s\"", s);
+	free(s);
+}
+
+static void printf_add_expr_to_buf(struct evbuffer* target, oris_parse_expr_t* expr)
+{
+	if (expr && expr->type == ET_INT) {
+		evbuffer_add_printf(target, "%d", expr->value.as_int);
+	} else if (expr && expr->type == ET_STRING) {
+		printf_add_escaped_json_str_to_buffer(target, expr);
+	} else {
+		evbuffer_add_printf(target, "null");
+	}
+}
+
+static void printf_template(struct evbuffer* target, const oris_template_t* tmpl,
+	char** keys, bool with_v_prefix)
+{
+	size_t i;
+	oris_parse_expr_t* v;
+
+	if (with_v_prefix) {
+		evbuffer_add_printf(target, "{\"v\":{");
+	}
+
+	for (i = 0; i < tmpl->count; i++) {
+		if (i > 0) {
+			evbuffer_add_printf(target, ",");
+		}
+		evbuffer_add_printf(target, "\"%s\":", keys[i]);
+
+		v = oris_expr_eval(&tmpl->fields[i].value);
+		printf_add_expr_to_buf(target, v);
+		oris_free_expr_value(v);
+	}
+
+	if (with_v_prefix) {
+		evbuffer_add_printf(target, "}}");
+	}
+}
+
+/* competition: one body per row */
+static void render_rows_plan(struct evbuffer* buf, oris_table_t* tbl,
+	const oris_template_t* tmpl, char** keys)
+{
+	(void) keys;
+	ORIS_FOR_EACH_TBL_ROW(tbl) {
+		oris_parse_template(buf, tmpl, true);
+	}
+}
+
+static void render_rows_printf(struct evbuffer* buf, oris_table_t* tbl,
+	const oris_template_t* tmpl, char** keys)
+{
+	ORIS_FOR_EACH_TBL_ROW(tbl) {
+		printf_template(buf, tmpl, keys, true);
+	}
+}
+
+/* startlist: one body for the whole table */
+static void render_table_plan(struct evbuffer* buf, oris_table_t* tbl,
+	const oris_template_t* tmpl, char** keys)
+{
+	(void) keys;
+	oris_parse_foreach_template(buf, tbl, tmpl);
+}
+
+static void render_table_printf(struct evbuffer* buf, oris_table_t* tbl,
+	const oris_template_t* tmpl, char** keys)
+{
+	int l = tbl->current_row;
+
+	ORIS_FOR_EACH_TBL_ROW(tbl) {
+		evbuffer_add_printf(buf, tbl->current_row > 0 ? ",{" : "{");
+		printf_template(buf, tmpl, keys, false);
+		evbuffer_add_printf(buf, "}");
+	}
+
+	tbl->current_row = l;
+}
+
+static bool fill_tables(oris_table_list_t* tables, int rows)
+{
+	oris_table_t *ver, *vrd, *stl;
+	char row[MAX_ROW];
+	int i, j, n, id;
+
+	ver = oris_get_or_create_table(tables, "VER", true);
+	vrd = oris_get_or_create_table(tables, "VRD", true);
+	stl = oris_get_or_create_table(tables, "STL", true);
+	if (!ver || !vrd || !stl) {
+		return false;
+	}
+
+	snprintf(row, sizeof(row), "%s|Load Test Regatta|Loadgen Lake|Testville|"
+		"01.06.2026|03.06.2026|rowing", EVENT_ID);
+	if (!oris_table_add_row(ver, row, ORIS_TABLE_ITEM_SEPERATOR)) {
+		return false;
+	}
+
+	for (i = 0; i < rows; i++) {
+		id = i + 1;
+		snprintf(row, sizeof(row), "%d|%d|%s|Heat %d||01.06.2026|%02d:%02d|%s|1-3->F|%d|V|%d|%d|%d|%d",
+			id, id, id % 2 ? "M1x" : "W2-", id, 9 + id / 6 % 10, id * 10 % 60,
+			id % 2 ? "M" : "W", 0, id, DISTANCE, id, 6);
+		if (!oris_table_add_row(vrd, row, ORIS_TABLE_ITEM_SEPERATOR)) {
+			return false;
+		}
+
+		n = snprintf(row, sizeof(row), "%d|%d|%d||Crew \"%d\"|Club %d|GER", id, id,
+			i % 6 + 1, id, id);
+		/* the athletes start at field 28 */
+		for (j = 8; j < 28; j++) {
+			row[n++] = '|';
+		}
+		snprintf(row + n, sizeof(row) - (size_t) n, "|Rower%d|Alex||%d|%d|%d|1",
+			id, 1990 + i % 20, id, id);
+		if (!oris_table_add_row(stl, row, ORIS_TABLE_ITEM_SEPERATOR)) {
+			return false;
+		}
+	}
+
+	vrd->state = stl->state = ver->state = COMPLETE;
+
+	return true;
+}
+
+static double bench(render_fn_t render, struct evbuffer* buf, oris_table_t* tbl,
+	const oris_template_t* tmpl, char** keys, int rounds)
+{
+	uint64_t start;
+	int r;
+
+	start = oris_monotonic_usec();
+	for (r = 0; r < rounds; r++) {
+		render(buf, tbl, tmpl, keys);
+		evbuffer_drain(buf, evbuffer_get_length(buf));
+	}
+
+	return (double) tbl->row_count * rounds * 1000000.0 /
+		(double) (oris_monotonic_usec() - start);
+}
+
+/* both renderers have to produce the same output */
+static bool same_output(render_fn_t a, render_fn_t b, oris_table_t* tbl,
+	const oris_template_t* tmpl, char** keys)
+{
+	struct evbuffer *ba, *bb;
+	size_t len;
+	bool retval;
+
+	ba = evbuffer_new();
+	bb = evbuffer_new();
+	if (!ba || !bb) {
+		return false;
+	}
+
+	a(ba, tbl, tmpl, keys);
+	b(bb, tbl, tmpl, keys);
+
+	len = evbuffer_get_length(ba);
+	retval = len == evbuffer_get_length(bb) &&
+		memcmp(evbuffer_pullup(ba, -1), evbuffer_pullup(bb, -1), len) == 0;
+
+	evbuffer_free(ba);
+	evbuffer_free(bb);
+
+	return retval;
+}
+
+static bool run(oris_table_list_t* tables, const char* tmpl_name,
+	const char* tbl_name, render_fn_t plan, render_fn_t reference, int rounds)
+{
+	const oris_template_t* tmpl;
+	oris_table_t* tbl;
+	struct evbuffer* buf;
+	char** keys;
+	size_t i;
+
+	tmpl = oris_program_get_template(tmpl_name);
+	tbl = oris_get_table(tables, tbl_name);
+	if (!tmpl || !tbl) {
+		fprintf(stderr, "no template %s or table %s\n", tmpl_name, tbl_name);
+		return false;
+	}
+
+	keys = template_keys(tmpl);
+	buf = evbuffer_new();
+	if (!keys || !buf) {
+		return false;
+	}
+
+	if (!same_output(plan, reference, tbl, tmpl, keys)) {
+		fprintf(stderr, "%s: output of the renderers differs\n", tmpl_name);
+	}
+
+	printf("%-12s %10.0f rows/s %10.0f rows/s\n", tmpl_name,
+		bench(plan, buf, tbl, tmpl, keys, rounds),
+		bench(reference, buf, tbl, tmpl, keys, rounds));
+
+	evbuffer_free(buf);
+	for (i = 0; i < tmpl->count; i++) {
+		free(keys[i]);
+	}
+	free(keys);
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	oris_application_info_t info;
+	int rows, rounds, retval;
+
+	rows = argc > 2 ? atoi(argv[2]) : DEFAULT_ROWS;
+	rounds = argc > 3 ? atoi(argv[3]) : DEFAULT_ROUNDS;
+	if (rows <= 0 || rounds <= 0) {
+		fprintf(stderr, "usage: %s [config [rows [rounds]]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	memset(&info, 0, sizeof(info));
+	info.argc = argc;
+	info.argv = argv;
+	info.fsync_policy = ORIS_FSYNC_NONE;
+	info.log_level = LOG_ERR;
+	oris_init_log(NULL, info.log_level);
+	oris_tables_init(&info.data_tables);
+
+	if (!oris_app_info_init(&info)) {
+		fprintf(stderr, "could not init application\n");
+		return EXIT_FAILURE;
+	}
+
+	oris_automation_init(&info);
+	oris_interpreter_init(&info.data_tables);
+	oris_configuration_init();
+
+	oris_add_config_file(argc > 1 ? argv[1] : DEFAULT_CONFIG);
+	if (!oris_load_configuration(&info) || !fill_tables(&info.data_tables, rows)) {
+		fprintf(stderr, "could not load configuration or fill tables\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%d rows, %d rounds\n%-12s %17s %17s\n", rows, rounds, "template",
+		"plan", "printf");
+	retval = run(&info.data_tables, "competition", "VRD", render_rows_plan,
+			render_rows_printf, rounds) &&
+		run(&info.data_tables, "startlist", "STL", render_table_plan,
+			render_table_printf, rounds) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	oris_configuration_finalize();
+	oris_interpreter_finalize();
+	oris_automation_finalize();
+	oris_app_info_finalize(&info);
+	oris_finalize_log();
+
+	return retval;
+}
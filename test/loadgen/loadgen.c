@@ -0,0 +1,721 @@
+/* load generator for the gateway
+ *
+ * A TCP server speaking the STX/ETX framed data feed protocol like the OVR
+ * system does. It synthesizes the traffic of a regatta: the event (VER) and
+ * the competitions (VRD) at the start of each round, then for each race its
+ * start list (STL), its state changes (STT) and the log entries (LOG) of
+ * every boat at every split. Requests
+ * (?VER, ?VRD, ?STL, ?STA, ?RNR, ?ATH) are answered with a header line
+ * followed by the rows, other requests with an empty reply. Lines are sent
+ * at the given rate (or as fast as the clients read) and the achieved rate
+ * is reported periodically.
+ *
+ * build with make loadgen in src/, then point a data connection to it,
+ * e.g. data://localhost:9000 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <event2/event.h>
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/listener.h>
+#include <event2/util.h>
+
+#define LINE_DELIM_START 0x02
+#define LINE_DELIM_END   0x03
+
+#define DEFAULT_PORT 9000
+#define DEFAULT_RACES 10
+#define DEFAULT_BOATS 6
+#define DEFAULT_SPLITS 4
+#define DEFAULT_RATE 1000
+
+#define MAX_LINE 4096
+
+/* the generator waits while a client has that many bytes not sent yet */
+#define BACKLOG_LIMIT (1024 * 1024)
+
+/* lines are generated every tick, at most a second of them at once */
+#define TICK_USEC 1000
+
+#define EVENT_ID "LG2026"
+#define DISTANCE 2000
+
+typedef enum {
+	PHASE_VER,
+	PHASE_VRD,
+	PHASE_STL,
+	PHASE_STARTLIST,
+	PHASE_START,
+	PHASE_LOG,
+	PHASE_FINISHED,
+	PHASE_OFFICIAL
+} loadgen_phase_t;
+
+typedef struct loadgen_client {
+	struct bufferevent* bev;
+	struct loadgen_client* next;
+} loadgen_client_t;
+
+typedef struct loadgen {
+	struct event_base* base;
+	struct evconnlistener* listener;
+	struct event* tick;
+	struct event* sigint;
+	loadgen_client_t* clients;
+	int client_count;
+
+	/* configuration */
+	int races;
+	int boats;
+	int splits;
+	double rate;
+	int duration;
+	int interval;
+
+	/* position in the generated traffic and the state of every race */
+	loadgen_phase_t phase;
+	int race;
+	int split;
+	int boat;
+	int* states;
+
+	/* lines that may be sent before the next tick */
+	double credit;
+	uint64_t last_tick;
+
+	/* totals and their values at the last report */
+	uint64_t started;
+	uint64_t lines;
+	uint64_t bytes;
+	unsigned long requests;
+	unsigned long throttled;
+	uint64_t last_report;
+	uint64_t report_lines;
+	uint64_t report_bytes;
+	unsigned long report_throttled;
+} loadgen_t;
+
+/* rows of a table answering a request, race is taken from the request */
+typedef struct {
+	const char* name;
+	int (*count)(const loadgen_t* self);
+	int (*row)(const loadgen_t* self, int race, int i, char* buf, size_t size);
+} loadgen_table_t;
+
+static uint64_t monotonic_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+static int bib(const loadgen_t* self, int race, int boat)
+{
+	(void) self;
+	return race * 100 + boat;
+}
+
+/* gap of a boat to the leader, empty for the leader */
+static void format_delta(int boat, char* buf, size_t size)
+{
+	if (boat == 0) {
+		buf[0] = '\0';
+	} else {
+		snprintf(buf, size, "+%d.%02d", boat * 3 / 2, boat * 50 % 100);
+	}
+}
+
+/* time of a boat at a split as m:ss.cc */
+static int format_time(const loadgen_t* self, int split, int boat, char* buf, size_t size)
+{
+	unsigned long cs = (unsigned long) split * 42000 / (unsigned long) self->splits +
+		(unsigned long) boat * 150;
+
+	return snprintf(buf, size, "%lu:%02lu.%02lu", cs / 6000, cs / 100 % 60, cs % 100);
+}
+
+static int vrd_count(const loadgen_t* self)
+{
+	return self->races;
+}
+
+static int vrd_row(const loadgen_t* self, int race, int i, char* buf, size_t size)
+{
+	int id = i + 1;
+
+	(void) race;
+	return snprintf(buf, size, "%d|%d|%s|Heat %d||01.06.2026|%02d:%02d|%s|1-3->F|%d|V|%d|%d|%d|%d",
+		id, id, id % 2 ? "M1x" : "W2-", id, 9 + id / 6 % 10, id * 10 % 60,
+		id % 2 ? "M" : "W", self->states[i], id, DISTANCE, id, self->boats);
+}
+
+static int stl_count(const loadgen_t* self)
+{
+	return self->boats;
+}
+
+static int stl_row(const loadgen_t* self, int race, int i, char* buf, size_t size)
+{
+	int n, j, id = bib(self, race, i + 1);
+
+	n = snprintf(buf, size, "%d|%d|%d||Crew %d|Club %d|GER", id, id, i + 1, id, id);
+	/* the athletes start at field 28 */
+	for (j = 8; j < 28 && n > 0 && (size_t) n < size; j++) {
+		buf[n++] = '|';
+	}
+
+	return n > 0 && (size_t) n < size ? n + snprintf(buf + n, size - (size_t) n,
+		"|Rower%d|Alex||%d|%d|%d|1", id, 1990 + i, id, id) : -1;
+}
+
+static int sta_count(const loadgen_t* self)
+{
+	return self->splits + 1;
+}
+
+static int sta_row(const loadgen_t* self, int race, int i, char* buf, size_t size)
+{
+	(void) race;
+	if (i == 0) {
+		return snprintf(buf, size, "S|0");
+	}
+
+	return snprintf(buf, size, "%d|%d", i, i * DISTANCE / self->splits);
+}
+
+static int rnr_row(const loadgen_t* self, int race, int i, char* buf, size_t size)
+{
+	char t[32], d[32];
+
+	format_time(self, self->splits, i, t, sizeof(t));
+	format_delta(i, d, sizeof(d));
+
+	return snprintf(buf, size, "%d|%d|%d|%d|%s|%s", i + 1, bib(self, race, i + 1),
+		i + 1, self->splits, t, d);
+}
+
+static int ath_count(const loadgen_t* self)
+{
+	return self->races * self->boats;
+}
+
+static int ath_row(const loadgen_t* self, int race, int i, char* buf, size_t size)
+{
+	int id = bib(self, i / self->boats + 1, i % self->boats + 1);
+
+	(void) race;
+	return snprintf(buf, size, "%d|X%d|Rower%d|Alex|%d|%d|GER|Berlin|C%d|%d",
+		id, id, id, 1990 + i % 20, id, id, i / self->boats + 1);
+}
+
+static int ver_count(const loadgen_t* self)
+{
+	(void) self;
+	return 1;
+}
+
+static int ver_row(const loadgen_t* self, int race, int i, char* buf, size_t size)
+{
+	(void) self;
+	(void) race;
+	(void) i;
+	return snprintf(buf, size, "%s|Load Test Regatta|Loadgen Lake|Testville|"
+		"01.06.2026|03.06.2026|rowing", EVENT_ID);
+}
+
+static const loadgen_table_t TABLES[] = {
+	{ "VER", ver_count, ver_row },
+	{ "VRD", vrd_count, vrd_row },
+	{ "STL", stl_count, stl_row },
+	{ "STA", sta_count, sta_row },
+	{ "RNR", stl_count, rnr_row },
+	{ "ATH", ath_count, ath_row }
+};
+
+static const loadgen_table_t* const VER_TABLE = &TABLES[0];
+static const loadgen_table_t* const VRD_TABLE = &TABLES[1];
+static const loadgen_table_t* const STL_TABLE = &TABLES[2];
+
+/* frame a line into the buffer, false if it does not fit */
+static bool frame(char* buf, size_t size, int len)
+{
+	if (len < 0 || (size_t) len + 2 > size) {
+		return false;
+	}
+
+	memmove(buf + 1, buf, (size_t) len);
+	buf[0] = LINE_DELIM_START;
+	buf[len + 1] = LINE_DELIM_END;
+
+	return true;
+}
+
+/* a row of a table as NAME1|... or NAME0|... for the last one */
+static int table_line(const loadgen_t* self, const loadgen_table_t* table, int race,
+	int i, char* buf, size_t size)
+{
+	int n = snprintf(buf, size, "%s%c|", table->name, i + 1 < table->count(self) ? '1' : '0');
+	int m;
+
+	if (n < 0 || (size_t) n >= size) {
+		return -1;
+	}
+
+	m = table->row(self, race, i, buf + n, size - (size_t) n);
+
+	return m < 0 || (size_t) (n + m) >= size ? -1 : n + m;
+}
+
+/* the next line of the generated traffic */
+static int next_line(loadgen_t* self, char* buf, size_t size)
+{
+	char t[32], d[32];
+	int n = -1, race = self->race + 1, id;
+
+	switch (self->phase) {
+		case PHASE_VER:
+			n = table_line(self, VER_TABLE, 0, 0, buf, size);
+			self->phase = PHASE_VRD;
+			break;
+		case PHASE_VRD:
+			n = table_line(self, VRD_TABLE, 0, self->race, buf, size);
+			if (++self->race == self->races) {
+				self->race = 0;
+				self->boat = 0;
+				self->phase = PHASE_STL;
+			}
+			break;
+		case PHASE_STL:
+			n = table_line(self, STL_TABLE, race, self->boat, buf, size);
+			if (++self->boat == self->boats) {
+				self->boat = 0;
+				self->phase = PHASE_STARTLIST;
+			}
+			break;
+		case PHASE_STARTLIST:
+		case PHASE_START:
+		case PHASE_FINISHED:
+		case PHASE_OFFICIAL:
+			/* the states used by the feed: startlist, started, finished, official */
+			self->states[self->race] = self->phase == PHASE_STARTLIST ? 0 :
+				self->phase == PHASE_START ? 1 : self->phase == PHASE_FINISHED ? 4 : 3;
+			n = snprintf(buf, size, "STT0|%d|%d|%d", race, race, self->states[self->race]);
+			if (self->phase == PHASE_START) {
+				self->phase = PHASE_LOG;
+				self->split = 1;
+				self->boat = 0;
+			} else if (self->phase == PHASE_OFFICIAL) {
+				self->phase = PHASE_STL;
+				if (++self->race == self->races) {
+					self->race = 0;
+					self->phase = PHASE_VER;
+				}
+			} else {
+				self->phase++;
+			}
+			break;
+		case PHASE_LOG:
+			id = bib(self, race, self->boat + 1);
+			format_time(self, self->split, self->boat, t, sizeof(t));
+			format_delta(self->boat, d, sizeof(d));
+			n = snprintf(buf, size, "LOG0|%d|%d|%d|y|%d|%s|%d|%s", race, race, id,
+				self->split, t, self->boat + 1, d);
+			if (++self->boat == self->boats) {
+				self->boat = 0;
+				if (++self->split > self->splits) {
+					self->phase = PHASE_FINISHED;
+				}
+			}
+			break;
+	}
+
+	return n >= 0 && (size_t) n < size ? n : -1;
+}
+
+static void send_line(struct bufferevent* bev, char* buf, int len)
+{
+	if (frame(buf, MAX_LINE, len)) {
+		bufferevent_write(bev, buf, (size_t) len + 2);
+	}
+}
+
+/* answer ?NAME|args with NAME!|args|count and the rows of the table */
+static void answer(loadgen_t* self, struct bufferevent* bev, char* request, size_t len)
+{
+	const loadgen_table_t* table = NULL;
+	char buf[MAX_LINE];
+	const char* args;
+	size_t name_len, i;
+	int n, count = 0, race = 1;
+
+	request[len] = '\0';
+	name_len = strcspn(request + 1, "|");
+	args = request + 1 + name_len;
+
+	for (i = 0; i < sizeof(TABLES) / sizeof(*TABLES); i++) {
+		if (strlen(TABLES[i].name) == name_len &&
+				strncmp(TABLES[i].name, request + 1, name_len) == 0) {
+			table = &TABLES[i];
+			count = table->count(self);
+		}
+	}
+
+	if (*args == '|') {
+		race = atoi(args + 1);
+		race = race < 1 || race > self->races ? 1 : race;
+	}
+
+	self->requests++;
+	n = snprintf(buf, sizeof(buf), "%.*s!%s|%d", (int) name_len, request + 1, args, count);
+	send_line(bev, buf, n);
+
+	for (n = 0; n < count; n++) {
+		send_line(bev, buf, table_line(self, table, race, n, buf, sizeof(buf)));
+	}
+}
+
+static void read_cb(struct bufferevent* bev, void* arg)
+{
+	loadgen_t* self = arg;
+	struct evbuffer* input = bufferevent_get_input(bev);
+	struct evbuffer_ptr end;
+	char delim = LINE_DELIM_END;
+	char buf[MAX_LINE];
+	size_t len;
+
+	for (;;) {
+		end = evbuffer_search(input, &delim, 1, NULL);
+		if (end.pos == -1) {
+			/* garbage without end */
+			if (evbuffer_get_length(input) > MAX_LINE) {
+				evbuffer_drain(input, evbuffer_get_length(input));
+			}
+			break;
+		}
+
+		len = (size_t) end.pos < sizeof(buf) ? (size_t) end.pos : sizeof(buf) - 1;
+		evbuffer_remove(input, buf, len);
+		evbuffer_drain(input, (size_t) end.pos - len + 1);
+
+		if (len > 1 && buf[0] == LINE_DELIM_START && buf[1] == '?') {
+			answer(self, bev, buf + 1, len - 1);
+		}
+	}
+}
+
+static void count_cb(struct evbuffer* buffer, const struct evbuffer_cb_info* info,
+	void* arg)
+{
+	((loadgen_t*) arg)->bytes += info->n_deleted;
+	(void) buffer;
+}
+
+static void remove_client(loadgen_t* self, struct bufferevent* bev)
+{
+	loadgen_client_t** p = &self->clients;
+	loadgen_client_t* client;
+
+	while (*p && (*p)->bev != bev) {
+		p = &(*p)->next;
+	}
+
+	if (*p) {
+		client = *p;
+		*p = client->next;
+		bufferevent_free(client->bev);
+		free(client);
+		self->client_count--;
+		printf("client disconnected, %d left\n", self->client_count);
+	}
+}
+
+static void event_cb(struct bufferevent* bev, short events, void* arg)
+{
+	if (events & (BEV_EVENT_EOF | BEV_EVENT_ERROR)) {
+		remove_client(arg, bev);
+	}
+}
+
+static void accept_cb(struct evconnlistener* listener, evutil_socket_t fd,
+	struct sockaddr* addr, int socklen, void* arg)
+{
+	loadgen_t* self = arg;
+	loadgen_client_t* client = calloc(1, sizeof(*client));
+
+	if (!client) {
+		evutil_closesocket(fd);
+		return;
+	}
+
+	client->bev = bufferevent_socket_new(self->base, fd, BEV_OPT_CLOSE_ON_FREE);
+	if (!client->bev) {
+		evutil_closesocket(fd);
+		free(client);
+		return;
+	}
+
+	bufferevent_setcb(client->bev, read_cb, NULL, event_cb, self);
+	evbuffer_add_cb(bufferevent_get_output(client->bev), count_cb, self);
+	bufferevent_enable(client->bev, EV_READ | EV_WRITE);
+
+	client->next = self->clients;
+	self->clients = client;
+	self->client_count++;
+	printf("client connected, %d total\n", self->client_count);
+
+	(void) listener;
+	(void) addr;
+	(void) socklen;
+}
+
+static bool backlogged(const loadgen_t* self)
+{
+	const loadgen_client_t* client;
+
+	for (client = self->clients; client; client = client->next) {
+		if (evbuffer_get_length(bufferevent_get_output(client->bev)) >= BACKLOG_LIMIT) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void report(loadgen_t* self, uint64_t now)
+{
+	double secs = (double) (now - self->last_report) / 1e6;
+
+	printf("%8.1f s %10.0f lines/s %8.2f MB/s %8lu requests %3d clients%s\n",
+		(double) (now - self->started) / 1e6,
+		(double) (self->lines - self->report_lines) / secs,
+		(double) (self->bytes - self->report_bytes) / secs / 1e6,
+		self->requests, self->client_count,
+		self->throttled > self->report_throttled ? "  (clients behind)" : "");
+	fflush(stdout);
+
+	self->last_report = now;
+	self->report_lines = self->lines;
+	self->report_bytes = self->bytes;
+	self->report_throttled = self->throttled;
+}
+
+/* generate the lines due since the last tick and broadcast them */
+static void tick_cb(evutil_socket_t fd, short what, void* arg)
+{
+	loadgen_t* self = arg;
+	loadgen_client_t* client;
+	char buf[MAX_LINE];
+	uint64_t now = monotonic_usec();
+	double limit = self->rate > 0 ? self->rate : 1e9;
+	int len;
+
+	self->credit += self->rate > 0 ? self->rate * (double) (now - self->last_tick) / 1e6 : limit;
+	self->credit = self->credit > limit ? limit : self->credit;
+	self->last_tick = now;
+
+	/* lines are only generated for connected clients which keep up */
+	if (!self->clients) {
+		self->credit = 0;
+	}
+
+	while (self->credit >= 1) {
+		if (backlogged(self)) {
+			self->throttled++;
+			self->credit = 0;
+			break;
+		}
+
+		len = next_line(self, buf, sizeof(buf));
+		if (frame(buf, sizeof(buf), len)) {
+			for (client = self->clients; client; client = client->next) {
+				bufferevent_write(client->bev, buf, (size_t) len + 2);
+			}
+		}
+		self->lines++;
+		self->credit--;
+	}
+
+	if (now - self->last_report >= (uint64_t) self->interval * 1000000) {
+		report(self, now);
+	}
+
+	if (self->duration > 0 && now - self->started >= (uint64_t) self->duration * 1000000) {
+		event_base_loopbreak(self->base);
+	}
+
+	(void) fd;
+	(void) what;
+}
+
+static void sigint_cb(evutil_socket_t fd, short what, void* arg)
+{
+	event_base_loopbreak(((loadgen_t*) arg)->base);
+
+	(void) fd;
+	(void) what;
+}
+
+static int usage(const char* name)
+{
+	printf("usage %s [options]\n\n", name);
+	printf("options: \n\t-p, --port=port\t - port to listen on (%d)\n", DEFAULT_PORT);
+	printf("\t-r, --races=n\t - number of races (%d)\n", DEFAULT_RACES);
+	printf("\t-b, --boats=n\t - boats per race (%d)\n", DEFAULT_BOATS);
+	printf("\t-s, --splits=n\t - splits per race (%d)\n", DEFAULT_SPLITS);
+	printf("\t-l, --rate=lines\t - lines per second, 0 for as fast as possible (%d)\n",
+		DEFAULT_RATE);
+	printf("\t-d, --duration=secs\t - stop after that many seconds (run until interrupted)\n");
+	printf("\t-i, --interval=secs\t - report interval (1)\n");
+	printf("\t-h, --help   \t - print this help\n");
+
+	return EXIT_FAILURE;
+}
+
+static bool parse_int(const char* s, int min, int* v)
+{
+	char* end;
+	long l = strtol(s, &end, 10);
+
+	if (*end != '\0' || l < min || l > 1000000) {
+		fprintf(stderr, "invalid value %s\n", s);
+		return false;
+	}
+
+	*v = (int) l;
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	static struct option long_opts[] = {
+		{ "port", required_argument, NULL, 'p' },
+		{ "races", required_argument, NULL, 'r' },
+		{ "boats", required_argument, NULL, 'b' },
+		{ "splits", required_argument, NULL, 's' },
+		{ "rate", required_argument, NULL, 'l' },
+		{ "duration", required_argument, NULL, 'd' },
+		{ "interval", required_argument, NULL, 'i' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	static loadgen_t self;
+	struct sockaddr_in addr;
+	struct timeval tick = { 0, TICK_USEC };
+	int opt_code, port = DEFAULT_PORT, rate = DEFAULT_RATE;
+	bool ok = true;
+	uint64_t now;
+
+	self.races = DEFAULT_RACES;
+	self.boats = DEFAULT_BOATS;
+	self.splits = DEFAULT_SPLITS;
+	self.interval = 1;
+
+	while ((opt_code = getopt_long(argc, argv, "p:r:b:s:l:d:i:h?", long_opts, NULL)) != -1) {
+		switch (opt_code) {
+			case 'p':
+				ok = parse_int(optarg, 1, &port) && port < 65536 && ok;
+				break;
+			case 'r':
+				ok = parse_int(optarg, 1, &self.races) && ok;
+				break;
+			case 'b':
+				ok = parse_int(optarg, 1, &self.boats) && self.boats < 100 && ok;
+				break;
+			case 's':
+				ok = parse_int(optarg, 1, &self.splits) && ok;
+				break;
+			case 'l':
+				ok = parse_int(optarg, 0, &rate) && ok;
+				break;
+			case 'd':
+				ok = parse_int(optarg, 0, &self.duration) && ok;
+				break;
+			case 'i':
+				ok = parse_int(optarg, 1, &self.interval) && ok;
+				break;
+			default:
+				ok = false;
+				break;
+		}
+	}
+
+	if (!ok || optind < argc) {
+		return usage(argv[0]);
+	}
+
+	self.rate = rate;
+	self.states = calloc((size_t) self.races, sizeof(*self.states));
+	self.base = event_base_new();
+	if (!self.states || !self.base) {
+		fprintf(stderr, "could not initialize\n");
+		return EXIT_FAILURE;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons((unsigned short) port);
+
+	self.listener = evconnlistener_new_bind(self.base, accept_cb, &self,
+		LEV_OPT_REUSEABLE | LEV_OPT_CLOSE_ON_FREE, 16,
+		(struct sockaddr*) &addr, sizeof(addr));
+	if (!self.listener) {
+		perror("listen");
+		return EXIT_FAILURE;
+	}
+
+	/* clients going away must not kill the generator */
+	signal(SIGPIPE, SIG_IGN);
+
+	self.tick = event_new(self.base, -1, EV_PERSIST, tick_cb, &self);
+	self.sigint = evsignal_new(self.base, SIGINT, sigint_cb, &self);
+	event_add(self.tick, &tick);
+	event_add(self.sigint, NULL);
+
+	printf("listening on port %d: %d races, %d boats, %d splits, ", port,
+		self.races, self.boats, self.splits);
+	if (rate > 0) {
+		printf("%d lines/s\n", rate);
+	} else {
+		printf("as fast as possible\n");
+	}
+
+	self.started = monotonic_usec();
+	self.last_tick = self.started;
+	self.last_report = self.started;
+
+	event_base_dispatch(self.base);
+
+	now = monotonic_usec();
+	printf("%lu lines in %.1f s: %.0f lines/s, %.2f MB/s, %lu requests answered, "
+		"clients behind %lu times\n",
+		(unsigned long) self.lines, (double) (now - self.started) / 1e6,
+		(double) self.lines * 1e6 / (double) (now - self.started),
+		(double) self.bytes / (double) (now - self.started),
+		self.requests, self.throttled);
+
+	while (self.clients) {
+		remove_client(&self, self.clients->bev);
+	}
+	event_free(self.tick);
+	event_free(self.sigint);
+	evconnlistener_free(self.listener);
+	event_base_free(self.base);
+	free(self.states);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+/* journaled storage test
+ *
+ * Fails two snapshots in a row (the temporary snapshot file is blocked by a
+ * directory), each after a compaction moved the journal aside, and restores
+ * the tables as after a crash. The records of both journals have to survive.
+ *
+ * build and run with make test in src/ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <event2/event.h>
+
+#include "oris_storage.h"
+#include "oris_snapshot.h"
+#include "oris_table.h"
+#include "oris_util.h"
+#include "oris_log.h"
+
+static char* path(const char* dir, const char* name)
+{
+	static char buf[256];
+
+	snprintf(buf, sizeof(buf), "%s/%s", dir, name);
+
+	return buf;
+}
+
+static bool add_table(oris_storage_t* storage, const char* name, const char* row)
+{
+	oris_table_t* tbl = oris_get_or_create_table(storage->tables, name, true);
+
+	return tbl && oris_table_add_row(tbl, row, ORIS_TABLE_ITEM_SEPERATOR) &&
+		oris_storage_save(storage);
+}
+
+static bool check_field(oris_table_list_t* tables, const char* name,
+	const char* expected)
+{
+	const char* value = oris_tables_get_field_by_number(tables, name, 1);
+
+	if (!value || strcmp(value, expected) != 0) {
+		fprintf(stderr, "table %s: expected %s, got %s\n", name, expected,
+			value ? value : "(none)");
+		return false;
+	}
+
+	return true;
+}
+
+int main(void)
+{
+	char dir[] = "/tmp/oris-storage-XXXXXX";
+	struct event_base* base;
+	oris_table_list_t tables, restored;
+	oris_storage_t storage;
+	bool ok;
+
+	oris_init_log(NULL, LOG_CRIT);
+
+	base = event_base_new();
+	if (!base || !mkdtemp(dir) || !oris_snapshot_init(base, ORIS_FSYNC_NONE)) {
+		fprintf(stderr, "could not set up test\n");
+		return EXIT_FAILURE;
+	}
+
+	oris_tables_init(&tables);
+	ok = oris_storage_init(&storage, &tables, path(dir, "data"), true) &&
+		mkdir(path(dir, "data.tmp"), 0700) == 0;
+
+	/* first snapshot fails, its journal is kept as .journal.prev */
+	ok = ok && add_table(&storage, "A", "first") && oris_storage_compact(&storage);
+	oris_snapshot_wait();
+
+	/* the second compaction must not replace .journal.prev */
+	ok = ok && add_table(&storage, "B", "second") && oris_storage_compact(&storage);
+	oris_snapshot_wait();
+
+	/* crash: the storage is not finalized */
+	oris_snapshot_finalize();
+	free(storage.fn);
+	free(storage.journal_fn);
+	free(storage.prev_journal_fn);
+	rmdir(path(dir, "data.tmp"));
+
+	oris_tables_init(&restored);
+	ok = ok && oris_snapshot_init(base, ORIS_FSYNC_NONE) &&
+		oris_storage_init(&storage, &restored, path(dir, "data"), true);
+	if (ok) {
+		oris_storage_restore(&storage);
+		ok = check_field(&restored, "A", "first") &&
+			check_field(&restored, "B", "second");
+	}
+
+	oris_storage_finalize(&storage);
+	oris_snapshot_finalize();
+	oris_tables_finalize(&restored);
+	oris_tables_finalize(&tables);
+
+	remove(path(dir, "data"));
+	remove(path(dir, "data.journal"));
+	remove(path(dir, "data.journal.prev"));
+	rmdir(dir);
+
+	event_base_free(base);
+	oris_finalize_log();
+
+	printf("%s\n", ok ? "ok" : "FAILED");
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}